@@ -0,0 +1,488 @@
+/*
+ * Dusty Mabe - 2014
+ * Adapt.cc - Implementation of adaptive repartitioning.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "Adapt.h"
+#include "Dir.h"
+#include "Tile.h"
+#include "Net.h"
+#include "Nuca.h"
+#include "Coop.h"
+#include "params.h"
+#include "Delay.h"
+
+// Global NETWORK is defined in simulator.cc
+extern Net *NETWORK;
+
+// Global L2 placement policy state is defined in simulator.cc
+extern Nuca *NUCA;
+
+// Global cooperative spilling state is defined in simulator.cc
+extern Coop *COOP;
+
+// The tile (and its cycle) whose access is currently being simulated
+extern ulong CURRENTTILE;
+extern ulong CURRENTCYCLE;
+
+// Can partitions serve misses for each other?
+extern int PARTSHARING;
+
+// Which policy to use and how long an epoch is (in accesses)
+extern ulong ADAPT;
+extern ulong EPOCHLEN;
+
+Adapt::Adapt(Dir *d, Tile **t, int s) {
+
+    int i, j, k, n;
+    ulong hops;
+
+    dir        = d;
+    tiles      = t;
+    policy     = ADAPT;
+    partscheme = s;
+    count      = 0;
+
+    epochs = repartitions = 0;
+    flushlines = flushdirty = flushcycles = 0;
+    memset(schemeepochs,   0, sizeof(schemeepochs));
+    memset(schemeaccesses, 0, sizeof(schemeaccesses));
+    memset(schemecycles,   0, sizeof(schemecycles));
+
+    hilldir  = 1;
+    hillprev = 0;
+    hillbase = 0.0;
+    hillhold = 0;
+
+    logsize   = 1024;
+    logscheme = new int[logsize];
+    logaat    = new float[logsize];
+
+    // The sizes to choose from are the powers of 2 the layout rule
+    // can make, plus the size we started with.
+    nschemes = 0;
+    for (i=1; i <= NPROCS && nschemes < ADAPTMAXSCHEMES; i++) {
+        if (((i & (i - 1)) && i != partscheme) || !dir->validScheme(i))
+            continue;
+        schemes[nschemes] = i;
+
+        // Average hops between two different tiles of a partition
+        hops = n = 0;
+        for (j=0; j < NPROCS; j++) {
+            for (k=0; k < NPROCS; k++) {
+                if (j != k && dir->ruleTilePart(i, j) == dir->ruleTilePart(i, k)) {
+                    hops += NETWORK->calcTileToTileHops(j, k);
+                    n++;
+                }
+            }
+        }
+        avghops[nschemes] = n ? ((double)hops / (double)n) : 0.0;
+        nschemes++;
+    }
+    assert(schemeIndex(partscheme) >= 0);
+
+    dir->trackColdMisses();
+    snapshot(&last);
+}
+
+Adapt::~Adapt() {
+    delete [] logscheme;
+    delete [] logaat;
+}
+
+/*
+ * Adapt::snapshot
+ *     - Add up the counters of all the tiles.
+ */
+void Adapt::snapshot(EpochStats *s) {
+    int i;
+    memset(s, 0, sizeof(EpochStats));
+    for (i=0; i < NPROCS; i++) {
+        s->cycles     += tiles[i]->cycle;
+        s->accesses   += tiles[i]->accesses;
+        s->l2accesses += tiles[i]->l2accesses;
+        s->locxfer    += tiles[i]->locxfer;
+        s->locdelay   += tiles[i]->locdelay;
+        s->ctocxfer   += tiles[i]->ctocxfer;
+        s->ctocdelay  += tiles[i]->ctocdelay;
+        s->ptopxfer   += tiles[i]->ptopxfer;
+        s->ptopdelay  += tiles[i]->ptopdelay;
+        s->memxfer    += tiles[i]->memxfer;
+        s->memdelay   += tiles[i]->memcycles + tiles[i]->memhopscycles;
+    }
+    s->coldxfer = dir->coldmisses;
+}
+
+/*
+ * Adapt::diff
+ *     - What happened between the start of the epoch and cur.
+ */
+void Adapt::diff(EpochStats *cur, EpochStats *e) {
+    e->cycles     = cur->cycles     - last.cycles;
+    e->accesses   = cur->accesses   - last.accesses;
+    e->l2accesses = cur->l2accesses - last.l2accesses;
+    e->locxfer    = cur->locxfer    - last.locxfer;
+    e->locdelay   = cur->locdelay   - last.locdelay;
+    e->ctocxfer   = cur->ctocxfer   - last.ctocxfer;
+    e->ctocdelay  = cur->ctocdelay  - last.ctocdelay;
+    e->ptopxfer   = cur->ptopxfer   - last.ptopxfer;
+    e->ptopdelay  = cur->ptopdelay  - last.ptopdelay;
+    e->memxfer    = cur->memxfer    - last.memxfer;
+    e->memdelay   = cur->memdelay   - last.memdelay;
+    e->coldxfer   = cur->coldxfer   - last.coldxfer;
+}
+
+/*
+ * Adapt::schemeIndex
+ *     - Index of partition size s in schemes (-1 if not there).
+ */
+int Adapt::schemeIndex(int s) {
+    int i;
+    for (i=0; i < nschemes; i++)
+        if (schemes[i] == s)
+            return i;
+    return -1;
+}
+
+/*
+ * Adapt::account
+ *     - Charge an epoch to the current partition size.
+ */
+void Adapt::account(EpochStats *e) {
+    int k = schemeIndex(partscheme);
+    schemeepochs[k]++;
+    schemeaccesses[k] += e->accesses;
+    schemecycles[k]   += e->cycles;
+}
+
+/*
+ * Adapt::l2Cost
+ *     - Model the average cost of an L2 access with partitions of
+ *       s tiles, using the epoch e that ran with partscheme tiles
+ *       per partition:
+ *
+ *       - An L2 access goes to the local slice 1/s of the time and
+ *         to another slice of the partition otherwise, which costs
+ *         a request and a data reply over the partition's average
+ *         hop count.
+ *       - Cold misses happen whatever the size. The other misses
+ *         follow the square root rule: they scale with
+ *         1/sqrt(capacity) and the capacity grows with s.
+ *       - With partition sharing the fraction of those misses served
+ *         by another partition scales with the number of tiles
+ *         outside the partition.
+ *       - Misses cost what they cost during the epoch.
+ */
+double Adapt::l2Cost(EpochStats *e, int s) {
+
+    double n     = (double)e->l2accesses;
+    double cold  = (double)MIN(e->coldxfer, e->memxfer) / n;
+    double warm0 = (double)(e->ptopxfer + e->memxfer) / n - cold;
+    double ptop0 = (warm0 > 0.0) ? ((double)e->ptopxfer / n / warm0) : 0.0;
+    double hops  = avghops[schemeIndex(s)];
+    double tloc, tctoc, tptop, tmem, warm, ptop;
+
+    tloc  = e->locxfer ? ((double)e->locdelay / (double)e->locxfer) :
+                         (double)(L1ATIME + L2ATIME);
+    tctoc = tloc + HOPDELAY(hops) + DATAHOPDELAY(hops);
+    tmem  = e->memxfer ? ((double)e->memdelay / (double)e->memxfer) :
+                         (double)(tloc + MEMATIME);
+    hops  = avghops[nschemes - 1]; // Whole chip
+    tptop = e->ptopxfer ? ((double)e->ptopdelay / (double)e->ptopxfer) :
+                          (tloc + 2*HOPDELAY(hops) + DATAHOPDELAY(hops));
+
+    warm = warm0 * sqrt((double)partscheme / (double)s);
+    if (cold + warm > 1.0)
+        warm = 1.0 - cold;
+
+    ptop = 0.0;
+    if (PARTSHARING && partscheme < NPROCS)
+        ptop = ptop0 * (double)(NPROCS - s) / (double)(NPROCS - partscheme);
+
+    return (1.0 - cold - warm) * (tloc / s + tctoc * (s - 1) / s) +
+           cold * tmem + warm * (ptop * tptop + (1.0 - ptop) * tmem);
+}
+
+/*
+ * Adapt::predictAAT
+ *     - Predict the average access time of epoch e had it run with
+ *       partitions of s tiles. Only the L2 part of the access time
+ *       changes; using the model for both sizes cancels out most of
+ *       its bias.
+ */
+double Adapt::predictAAT(EpochStats *e, int s) {
+    double aat = (double)e->cycles / (double)e->accesses;
+    if (e->l2accesses == 0)
+        return aat;
+    return aat + (l2Cost(e, s) - l2Cost(e, partscheme)) *
+                 (double)e->l2accesses / (double)e->accesses;
+}
+
+/*
+ * Adapt::switchCost
+ *     - Estimate the cycles one tile loses to a repartition: the
+ *       stall for the flush plus refilling the lines it would have
+ *       hit on (at most the L2 hits of an epoch).
+ */
+double Adapt::switchCost(EpochStats *e) {
+
+    int i;
+    ulong valid, dirty;
+    double cost = 0.0;
+    double hits = (double)(e->locxfer + e->ctocxfer) / NPROCS;
+    double tloc = e->locxfer ? ((double)e->locdelay / (double)e->locxfer) :
+                               (double)(L1ATIME + L2ATIME);
+    double tmem = e->memxfer ? ((double)e->memdelay / (double)e->memxfer) :
+                               (double)(tloc + MEMATIME);
+
+    for (i=0; i < NPROCS; i++) {
+        tiles[i]->countL2Lines(&valid, &dirty);
+        cost += REPARTTIME + valid*FLUSHLINETIME + dirty*DATAFLITS;
+        cost += ((valid < hits) ? valid : hits) * (tmem - tloc);
+    }
+
+    return cost / NPROCS;
+}
+
+/*
+ * Adapt::pickModel
+ *     - Cost model policy. Switch to the size with the lowest
+ *       predicted AAT if the cycles it saves each tile over the next
+ *       ADAPTHORIZON epochs pay for the switch.
+ */
+int Adapt::pickModel(EpochStats *e) {
+
+    int i, best = partscheme;
+    double aat  = (double)e->cycles / (double)e->accesses;
+    double bestaat = aat;
+    double p, gain;
+
+    for (i=0; i < nschemes; i++) {
+        p = predictAAT(e, schemes[i]);
+        if (p < bestaat) {
+            bestaat = p;
+            best    = schemes[i];
+        }
+    }
+
+    if (best == partscheme)
+        return partscheme;
+
+    gain = (aat - bestaat) * ((double)e->accesses / NPROCS) * ADAPTHORIZON;
+    if (gain <= switchCost(e))
+        return partscheme;
+
+    return best;
+}
+
+/*
+ * Adapt::pickHill
+ *     - Hill climbing policy. Every ADAPTHOLD epochs probe the next
+ *       size up (or down) for an epoch. Keep going that way while
+ *       the measured AAT improves; once it doesn't, go back to the
+ *       last good size and probe the other way next time.
+ */
+int Adapt::pickHill(EpochStats *e) {
+
+    double aat = (double)e->cycles / (double)e->accesses;
+    int k = schemeIndex(partscheme);
+    int back;
+
+    // We were probing. Was it better?
+    if (hillprev) {
+        if (aat < hillbase && k + hilldir >= 0 && k + hilldir < nschemes) {
+            hillprev = partscheme;
+            hillbase = aat;
+            return schemes[k + hilldir];
+        }
+        back     = (aat < hillbase) ? partscheme : hillprev;
+        hillprev = 0;
+        hilldir  = -hilldir;
+        hillhold = ADAPTHOLD;
+        return back;
+    }
+
+    if (hillhold > 0) {
+        hillhold--;
+        return partscheme;
+    }
+
+    // Start a probe. Turn around at the ends.
+    if (k + hilldir < 0 || k + hilldir >= nschemes)
+        hilldir = -hilldir;
+    if (k + hilldir < 0 || k + hilldir >= nschemes)
+        return partscheme; // Only one size to choose from
+
+    hillprev = partscheme;
+    hillbase = aat;
+    return schemes[k + hilldir];
+}
+
+/*
+ * Adapt::repartition
+ *     - Flush every L2 slice, regroup the tiles into partitions of
+ *       s tiles and charge each tile for the time its flush took.
+ */
+void Adapt::repartition(int s) {
+
+    int i, partid;
+    ulong valid, dirty, stall;
+
+    for (i=0; i < NPROCS; i++) {
+        CURRENTTILE     = i;
+        CURRENTCYCLE    = tiles[i]->cycle;
+        CURRENTDELAY    = 0;
+        CURRENTMEMDELAY = 0;
+
+        tiles[i]->flush(dir, &valid, &dirty);
+
+        stall = REPARTTIME + valid*FLUSHLINETIME + dirty*DATAFLITS;
+        tiles[i]->cycle += stall;
+        flushcycles += stall;
+        flushlines  += valid;
+        flushdirty  += dirty;
+    }
+    CURRENTDELAY    = 0;
+    CURRENTMEMDELAY = 0;
+
+    for (i=0; i < NPROCS; i++)
+        tiles[i]->flushL1();
+
+    // The page tables are per partition too
+    NUCA->clear();
+
+    dir->repartition(s);
+    for (i=0; i < NPROCS; i++) {
+        partid = dir->mapTileToPart(i);
+        tiles[i]->setPartition(partid, dir->partsize[partid],
+                               dir->parttiles[partid]);
+    }
+
+    // So are the spilling neighbours and utilization counters
+    COOP->rebuild();
+
+    partscheme = s;
+    repartitions++;
+}
+
+/*
+ * Adapt::access
+ *     - Called after every access. At the end of an epoch let the
+ *       policy pick the partition size for the next one.
+ *
+ * Returns 1 if the tiles were repartitioned (and their cycles
+ * changed).
+ */
+int Adapt::access() {
+
+    EpochStats cur, e;
+    int next;
+
+    if (++count < EPOCHLEN)
+        return 0;
+    count = 0;
+
+    snapshot(&cur);
+    diff(&cur, &e);
+    last = cur;
+
+    account(&e);
+
+    // Keep a log of the epochs
+    if (epochs == logsize) {
+        int   * s = new int[2 * logsize];
+        float * a = new float[2 * logsize];
+        memcpy(s, logscheme, logsize * sizeof(int));
+        memcpy(a, logaat,    logsize * sizeof(float));
+        delete [] logscheme;
+        delete [] logaat;
+        logscheme = s;
+        logaat    = a;
+        logsize  *= 2;
+    }
+    logscheme[epochs] = partscheme;
+    logaat[epochs]    = (float)e.cycles / (float)e.accesses;
+    epochs++;
+
+    if (policy == ADAPTMODEL)
+        next = pickModel(&e);
+    else
+        next = pickHill(&e);
+
+    if (next == partscheme)
+        return 0;
+
+    repartition(next);
+    return 1;
+}
+
+/*
+ * Adapt::finish
+ *     - Called when the trace has run out (and the tiles have
+ *       drained). The partial epoch at the end of the trace is
+ *       charged to the size in use.
+ */
+void Adapt::finish() {
+
+    EpochStats cur, e;
+    int k;
+
+    if (!count)
+        return;
+
+    snapshot(&cur);
+    diff(&cur, &e);
+    k = schemeIndex(partscheme);
+    schemeaccesses[k] += e.accesses;
+    schemecycles[k]   += e.cycles;
+    last  = cur;
+    count = 0;
+}
+
+/*
+ * Adapt::PrintStats
+ *     - Print how long was spent at each partition size and what
+ *       the switches cost.
+ */
+void Adapt::PrintStats(int tabular) {
+
+    ulong i;
+    int k;
+
+    if (tabular) {
+        printf("%15s%15s%15s%15s\n",
+               "adaptscheme", "epochs", "accesses", "AAT");
+    } else {
+        printf("===== Adaptive repartitioning (%s policy) =========\n",
+               (policy == ADAPTMODEL) ? "model" : "hill");
+        for (i=0; i < epochs; i++)
+            printf("Epoch %lu: %d tiles per partition, AAT %f\n",
+                   i, logscheme[i], logaat[i]);
+    }
+
+    for (k=0; k < nschemes; k++) {
+        if (tabular)
+            printf("%15d%15lu%15lu%15f\n", schemes[k], schemeepochs[k],
+                   schemeaccesses[k],
+                   schemeaccesses[k] ? ((float)schemecycles[k] / (float)schemeaccesses[k]) : 0.0);
+        else
+            printf("%d tiles per partition: %lu epochs, %lu accesses, AAT %f\n",
+                   schemes[k], schemeepochs[k], schemeaccesses[k],
+                   schemeaccesses[k] ? ((float)schemecycles[k] / (float)schemeaccesses[k]) : 0.0);
+    }
+
+    if (tabular) {
+        printf("%15s%15s%15s%15s%15s\n", "epochs", "repartitions",
+               "flushlines", "flushdirty", "flushcycles");
+        printf("%15lu%15lu%15lu%15lu%15lu\n", epochs, repartitions,
+               flushlines, flushdirty, flushcycles);
+    } else {
+        printf("Repartitions %lu, lines flushed %lu (%lu dirty), "
+               "flush stall cycles %lu\n",
+               repartitions, flushlines, flushdirty, flushcycles);
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ * Dusty Mabe - 2014
+ * Adapt.h - Header file for adaptive repartitioning. The tiles start
+ *           out in partitions of the size given on the command line
+ *           and at the end of every epoch a policy looks at what the
+ *           tiles did during the epoch and may regroup them into
+ *           partitions of a different size.
+ *
+ *           Regrouping changes the home tile of every block and the
+ *           meaning of the directory's sharer vectors, so every L2
+ *           slice is flushed first (dirty lines go back to memory and
+ *           L1 copies are invalidated). The tiles pay for the switch
+ *           in stall cycles and then again in the misses that refill
+ *           their caches.
+ */
+#ifndef ADAPT_H
+#define ADAPT_H
+
+#include "types.h"
+#include "params.h"
+
+class Dir;  // Forward Declaration
+class Tile; // Forward Declaration
+
+// Repartitioning policies (selected with adapt=<policy>)
+enum {
+    ADAPTOFF = 0, // Partitions never change
+    ADAPTMODEL,   // Switch to the size a cost model predicts is fastest
+    ADAPTHILL,    // Hill climb on the measured AAT of each epoch
+};
+
+// What the tiles did during an epoch (summed over all tiles)
+struct EpochStats {
+    ulong cycles;
+    ulong accesses;
+    ulong l2accesses;
+    ulong locxfer,  locdelay;
+    ulong ctocxfer, ctocdelay;
+    ulong ptopxfer, ptopdelay;
+    ulong memxfer,  memdelay; // Memory cycles including the hops
+    ulong coldxfer;           // Memory reads of never before read blocks
+};
+
+class Adapt {
+private:
+    Dir  *  dir;
+    Tile ** tiles;
+    ulong   policy;
+    int     partscheme;   // Current tiles per partition
+    ulong   count;        // Accesses so far this epoch
+    EpochStats last;      // Counters at the start of the epoch
+
+    // Partition sizes the layout rule can make and the average hop
+    // count between two tiles of the same partition for each
+    int     nschemes;
+    int     schemes[ADAPTMAXSCHEMES];
+    double  avghops[ADAPTMAXSCHEMES];
+
+    // Hill climbing state
+    int     hilldir;      // +1 to try bigger partitions, -1 smaller
+    int     hillprev;     // Size we came from while probing (0 if not)
+    double  hillbase;     // AAT of the epoch at hillprev
+    ulong   hillhold;     // Epochs left before the next probe
+
+    // Epoch log (partition size and AAT of every epoch)
+    ulong   logsize;
+    int   * logscheme;
+    float * logaat;
+
+    void   snapshot(EpochStats *s);
+    void   diff(EpochStats *cur, EpochStats *e);
+    int    schemeIndex(int s);
+    void   account(EpochStats *e);
+    double l2Cost(EpochStats *e, int s);
+    double predictAAT(EpochStats *e, int s);
+    double switchCost(EpochStats *e);
+    int    pickModel(EpochStats *e);
+    int    pickHill(EpochStats *e);
+    void   repartition(int s);
+
+public:
+    // Counters
+    ulong epochs;
+    ulong repartitions;
+    ulong flushlines;     // Valid L2 lines flushed
+    ulong flushdirty;     // Dirty L2 lines written back by flushes
+    ulong flushcycles;    // Stall cycles charged for flushes (all tiles)
+    ulong schemeepochs[ADAPTMAXSCHEMES];   // Epochs run at each size
+    ulong schemeaccesses[ADAPTMAXSCHEMES]; // Accesses run at each size
+    ulong schemecycles[ADAPTMAXSCHEMES];   // Cycles spent at each size
+
+    Adapt(Dir *d, Tile **t, int partscheme);
+    ~Adapt();
+
+    int  access();
+    void finish();
+    void PrintStats(int tabular);
+};
+
+#endif
@@ -8,57 +8,68 @@
 #include "BitVector.h"
 #include "params.h"
 
-BitVector::BitVector(int value) {
+BitVector::BitVector(ulong value) {
 
-    // Set the bitvector equal to the value
-    vector = value;
+    int i;
+
+    // Set the bitvector equal to the value. The value
+    // only covers the first word.
+    for (i=0; i < BVWORDS; i++)
+        vector[i] = 0;
+    vector[0] = value;
 
     // For us the bitvectors will all be size NPROCS 
     size   = NPROCS;
 }
 
-int BitVector::getVector() {
-    return vector;
+/*
+ * BitVector::getVector
+ *     - Return the first word of the vector (the whole vector
+ *       if NPROCS fits in a word).
+ */
+ulong BitVector::getVector() {
+    return vector[0];
 }
 
 int BitVector::getFirstSetBit() {
     int i;
     for(i=0; i < size; i++) {
-        if (vector & (1 << i))
+        if (getBit(i))
             return i;
     }
+    return -1;
 }
 
 int BitVector::getNumSetBits() {
     int i;
     int count = 0;
-    for(i=0; i < size; i++) {
-        if (vector & (1 << i))
-            count++;
-    }
+    for(i=0; i < BVWORDS; i++)
+        count += __builtin_popcountl(vector[i]);
     return count;
 }
 
 void BitVector::setBit(int bit) {
-    vector |= (1 << bit);
+    vector[bit / BVWORDBITS] |= (1UL << (bit % BVWORDBITS));
 }
 
 void BitVector::clearBit(int bit) {
-    vector &= ~(1 << bit);
+    vector[bit / BVWORDBITS] &= ~(1UL << (bit % BVWORDBITS));
 }
 
 int BitVector::getBit(int bit) {
-    return ((vector & (1 << bit)) ? 1 : 0);
+    return ((vector[bit / BVWORDBITS] & (1UL << (bit % BVWORDBITS))) ? 1 : 0);
 }
 
 void BitVector::clearAllBits() {
-    vector = 0;
+    int i;
+    for (i=0; i < BVWORDS; i++)
+        vector[i] = 0;
 }
 
 int BitVector::getNthSetBit(int n) {
     int i;
     for(i=0; i < size; i++) {
-        if (vector & (1 << i))
+        if (getBit(i))
             n--;
         if (n == 0)
             return i;
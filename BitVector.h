@@ -5,22 +5,28 @@
 #ifndef BV_H
 #define BV_H
 
+#include "types.h"
 #include "params.h"
 
+// The bitvectors hold one bit per tile. Use as many words as it
+// takes to cover NPROCS bits.
+#define BVWORDBITS (8 * sizeof(ulong))
+#define BVWORDS    ((int)((NPROCS + BVWORDBITS - 1) / BVWORDBITS))
+
 class BitVector {
     private:
-        int vector;
+        ulong vector[BVWORDS];
         
     public:
         int size;
-        BitVector(int value);
+        BitVector(ulong value);
         ~BitVector() {};
 
         int getFirstSetBit();
         int getNumSetBits();
         int getBit(int bit);
         int getNthSetBit(int n);
-        int getVector();
+        ulong getVector();
 
         void clearAllBits();
         void setBit(int bit);
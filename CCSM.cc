@@ -1,6 +1,7 @@
 /*
  * Dusty Mabe - 2014
- * CCSM.cc - Implementation of a MESI Cache Coherence State Machine (CCSM).
+ * CCSM.cc - Implementation of a MESI (or MOESI/MESIF) Cache Coherence
+ *           State Machine (CCSM).
  */
 
 #include <assert.h>
@@ -10,15 +11,29 @@
 #include "Tile.h"
 #include "Dir.h"
 #include "Net.h"
+#include "Coop.h"
 
 // Global NETWORK is defined in simulator.cc
 extern Net *NETWORK;
 
+// Global cooperative spilling state is defined in simulator.cc
+extern Coop *COOP;
+
+// Which coherence protocol to use (PROTOMESI, PROTOMOESI or PROTOMESIF)
+extern ulong PROTOCOL;
+
+// How the L1s and L2s relate (HIERINCL, HIERNINE or HIEREXCL)
+extern ulong HIERARCHY;
+
+// Whether L2 evictions are reported to the directory (0 or 1)
+extern ulong EVICTNOTIFY;
+
 enum{
     STATEM = 0,
     STATEE,
     STATES,
     STATEI,
+    STATEO,  // MOESI only
 };
 
 CCSM::CCSM(Tile * t, Cache *c, CacheLine *l) {
@@ -37,53 +52,194 @@ CCSM::CCSM(Tile * t, Cache *c, CacheLine *l) {
 void CCSM::setState(int s) {
 
     // If we are going to the invalid state there
-    // are a few things to do. 
-    if (state != STATEI && s == STATEI) {
+    // are a few things to do. Coherence always has to
+    // reach the L1 copies.
+    if (state != STATEI && s == STATEI)
+        invalidate(1);
+
+    state = s; // Set the new state
+}
+
+/*
+ * CCSM::invalidate
+ *     - Housekeeping for a line that is leaving the L2. If backinv
+ *       is set the L1 copies go too.
+ */
+void CCSM::invalidate(int backinv) {
 
-        assert(line->isValid()); // line should be valid
+    assert(line->isValid()); // line should be valid
 
-        // Since L1 and L2 are inclusive and we are invalidating 
-        // out of L2 (only have CCSM in L2) then broadcast 
-        // invalidation to L1s in all Tiles in the partition. 
-        tile->broadcastToPartition(
-            L1INV,
+    // We are invalidating out of L2 (only have CCSM in L2) so
+    // send invalidations to the L1s that may have copies (or to
+    // all Tiles in the partition) if they have to go.
+    if (backinv)
+        tile->invalidateL1s(
+            line,
             cache->getBaseAddr(line->getTag(), line->getIndex())
         );
 
-        // If the the line is dirty then this is a writeback
-        if (line->getFlags() == DIRTY)
-            cache->writeBack();
+    // If the the line is dirty then this is a writeback
+    if (line->getFlags() == DIRTY)
+        cache->writeBack();
 
-        // set the cache line state to invalid
-        line->invalidate();
-    }
+    // A prefetched line that goes away unused was a waste
+    if (line->isPrefetched())
+        cache->prefetchUseless();
 
-    state = s; // Set the new state
+    // set the cache line state to invalid
+    line->invalidate();
 }
 
-void CCSM::evict() {
+/*
+ * CCSM::evict
+ *     - Make room in the L2. With an inclusive hierarchy (or when
+ *       backinv is forced, e.g. for a flush) the L1 copies are
+ *       invalidated too; otherwise they are left alone. A dirty
+ *       copy in a write-back L1 is always recalled. With eviction
+ *       notices on the directory is told the block has gone.
+ */
+void CCSM::evict(int backinv) {
+
+    int addr = cache->getBaseAddr(line->getTag(), line->getIndex());
+
+    // If an L1 owns the block its dirty data has to come home first
+    if (line->getL1Owner() >= 0)
+        tile->recallL1(line, addr, 0);
+
+    // Dirty blocks have to go back to memory
+    if (line->getFlags() == DIRTY)
+        NETWORK->writeBackToMem(addr, tile->index);
+
+    // Tell the directory (unless this is a flush, which has already
+    // taken the block out of the directory)
+    if (EVICTNOTIFY && !backinv && state != STATEI)
+        tile->evictNotice(line, addr);
+
+    // A block another partition spilled here can't go back to it
+    if (line->isSpilled())
+        COOP->lost(addr, tile->partid);
+
     // On eviction set the state to invalid
-    setState(STATEI);
+    if (state != STATEI) {
+        backinv = backinv || HIERARCHY == HIERINCL;
+        if (backinv)
+            tile->backinvs++;
+        else
+            tile->backinvsaved++;
+        invalidate(backinv);
+    }
+    state = STATEI;
+}
+
+/*
+ * CCSM::drop
+ *     - Exclusive hierarchy: a clean block has moved up into an L1
+ *       so the L2 forgets it without telling anyone. The partition
+ *       stays a sharer at the directory.
+ */
+void CCSM::drop() {
+
+    assert(state == STATEE || state == STATES);
+    assert(line->getFlags() != DIRTY);
+
+    line->invalidate();
+    state = STATEI;
+}
+
+
+/*
+ * CCSM::spill
+ *     - Cooperative spilling: the block has moved to another
+ *       partition's L2, which took over its state (and any dirty
+ *       data), so it leaves here without a writeback. The L1 copies
+ *       go too since the directory no longer counts the partition
+ *       as a sharer.
+ */
+void CCSM::spill() {
+
+    int addr = cache->getBaseAddr(line->getTag(), line->getIndex());
+
+    assert(state != STATEI && line->getL1Owner() < 0);
+
+    tile->invalidateL1s(line, addr);
+    if (line->isPrefetched())
+        cache->prefetchUseless();
+
+    line->invalidate();
+    state = STATEI;
+}
+
+
+/*
+ * CCSM::moved
+ *     - Hot-block migration: the block's home moved to another
+ *       slice, which took over its state, its L1 sharers and any
+ *       dirty data. It leaves here without telling anyone.
+ */
+void CCSM::moved() {
+    line->invalidate();
+    state = STATEI;
+}
+
+
+/*
+ * CCSM::reinsert
+ *     - Exclusive hierarchy: a block an L1 held has come back
+ *       into the L2. It is clean and still shared at the directory.
+ */
+void CCSM::reinsert() {
+    assert(state == STATEI);
+    state = STATES;
 }
 
+/*
+ * CCSM::isClean
+ *     - Is the line held without dirty data (E or S)?
+ */
+int CCSM::isClean() {
+    return (state == STATEE || state == STATES);
+}
 
-void CCSM::netInitInv() {
+/*
+ * CCSM::isValid
+ *     - Does the line hold the block (any state but I)?
+ */
+int CCSM::isValid() {
+    return (state != STATEI);
+}
+
+/*
+ * CCSM::netInitInv
+ *     - Invalidate the line for the directory.
+ *
+ * Returns 1 if the line held dirty data (M or O), 0 if not.
+ */
+int CCSM::netInitInv() {
 
     int addr = cache->getBaseAddr(line->getTag(), line->getIndex());
 
     switch (state) {
 
         // For M we need to transition to Invalid state and flush. 
+        // Under MOESI the data goes straight to the requester
+        // instead.
         case STATEM: 
-            NETWORK->flushToMem(addr, tile->index);
+            if (PROTOCOL != PROTOMOESI)
+                NETWORK->flushToMem(addr, tile->index);
             setState(STATEI);
-            break;
+            return 1;
+
+        // For O (MOESI) the data goes to the requester (or the
+        // requester already has it for an upgrade)
+        case STATEO:
+            setState(STATEI);
+            return 1;
 
         // For E&S we need to transistion to Invalid state
         case STATEE: 
         case STATES: 
             setState(STATEI);
-            break;
+            return 0;
 
         // For invalid state should not happen
         case STATEI: 
@@ -95,30 +251,46 @@ void CCSM::netInitInv() {
     }
 }
 
-void CCSM::netInitInt() {
+/*
+ * CCSM::netInitInt
+ *     - Handle an intervention from the directory (someone else
+ *       wants to read the block).
+ *
+ * Returns 1 if the line held dirty data (M or O), 0 if not.
+ */
+int CCSM::netInitInt() {
 
     int addr = cache->getBaseAddr(line->getTag(), line->getIndex());
 
     switch (state) {
 
         // For M we need to transistion to Shared state and flush. 
+        // Under MOESI we keep the dirty block and become its owner.
         case STATEM: 
-            NETWORK->flushToMem(addr, tile->index);
-            setState(STATES);
-            break;
+            if (PROTOCOL == PROTOMOESI) {
+                setState(STATEO);
+            } else {
+                NETWORK->flushToMem(addr, tile->index);
+                setState(STATES);
+            }
+            return 1;
 
         // For E we transition to Shared
         case STATEE:
             setState(STATES);
-            break;
+            return 0;
         
         // For S, no need to change state, but we can optionally flush
         case STATES: 
-            break;
+            return 0;
+
+        // For O we stay the owner
+        case STATEO:
+            return 1;
 
         // Nothing to do for I
         case STATEI: 
-            break;
+            return 0;
 
         default :
             assert(0); // should not get here
@@ -137,8 +309,9 @@ void CCSM::procInitWr(ulong addr) {
             setState(STATEM);
             break;
 
-        // For S need to send UPGR and go to modified
+        // For S (or O) need to send UPGR and go to modified
         case STATES: 
+        case STATEO:
             NETWORK->sendReqTileToDir(UPGR, addr, tile->index);
             setState(STATEM);
             break;
@@ -157,10 +330,11 @@ void CCSM::procInitWr(ulong addr) {
 void CCSM::procInitRd(ulong addr) {
     int dirstate;
     switch (state) {
-        // Nothing to do for M&E&S states
+        // Nothing to do for M&E&S&O states
         case STATEM: 
         case STATEE: 
         case STATES: 
+        case STATEO:
             break;
 
         // For I, Send RD request to directory and then check
@@ -178,16 +352,20 @@ void CCSM::procInitRd(ulong addr) {
     }
 }
 
-void CCSM::getFromNetwork(ulong msg) {
+/*
+ * CCSM::getFromNetwork
+ *     - Handle a message from the directory.
+ *
+ * Returns 1 if the line held dirty data, 0 if not.
+ */
+int CCSM::getFromNetwork(ulong msg) {
     switch (msg) {
 
         // These come from directory
         case INV: 
-            netInitInv();
-            break;
+            return netInitInv();
         case INT: 
-            netInitInt();
-            break;
+            return netInitInt();
      ///case REPLY: 
      ///    netInitReply();
      ///    break;
@@ -1,7 +1,14 @@
 /*
  * Dusty Mabe - 2014
  * CCSM.h - Header file for Cache Coherence State Machine for
- *          the MESI protocol.
+ *          the MESI protocol and its MOESI and MESIF variants.
+ *
+ *          MOESI adds an Owned state: an owner that is asked for its
+ *          dirty block supplies it without writing it back. MESIF
+ *          adds a Forwarder, the one sharer that answers for a
+ *          shared block. Which partition is the forwarder only
+ *          matters to the directory so it is kept there and an F
+ *          line looks like an S line here.
  */
 #ifndef CCSM_H
 #define CCSM_H
@@ -12,6 +19,13 @@ class Cache;     // Forward Declaration
 class CacheLine; // Forward Declaration
 class Tile;      // Forward Declaration
 
+// Coherence protocols (selected with protocol=<protocol>)
+enum {
+    PROTOMESI = 0,
+    PROTOMOESI,
+    PROTOMESIF,
+};
+
 class CCSM {
     private:
     public:
@@ -23,10 +37,17 @@ class CCSM {
         CCSM(Tile *t, Cache *c, CacheLine *l); 
         ~CCSM();
         void setState(int s);
-        void evict();
-        void getFromNetwork(ulong msg);
-        void netInitInv();
-        void netInitInt();
+        void invalidate(int backinv);
+        void evict(int backinv);
+        void drop();
+        void spill();
+        void moved();
+        void reinsert();
+        int  isClean();
+        int  isValid();
+        int  getFromNetwork(ulong msg);
+        int  netInitInv();
+        int  netInitInt();
         void procInitRd(ulong addr);
         void procInitWr(ulong addr);
 };
@@ -11,10 +11,33 @@
 #include "CacheLine.h"
 #include "CCSM.h"
 #include "Tile.h"
+#include "Dir.h"
+#include "BitVector.h"
+#include "Stats.h"
+#include "Prof.h"
 #include "params.h"
+#include "Delay.h"
 
-// Global delay counter for the current outstanding memory request.
-extern int CURRENTDELAY;
+// The cycle of the access that is currently being simulated
+extern ulong CURRENTCYCLE;
+
+// Set when the current L2 access is the first hit on a prefetched line
+extern ulong CURRENTPFHIT;
+
+// How the L1s and L2s relate (HIERINCL, HIERNINE or HIEREXCL)
+extern ulong HIERARCHY;
+
+// L1 write policy (L1WRTHRU or L1WRBACK)
+extern ulong L1WRITE;
+
+// Keep clean L1 victims as replicas in the local L2 slice (0 or 1)
+extern ulong REPLICATE;
+
+// Spill L2 victims into neighbour partitions (0 or 1)
+extern ulong SPILL;
+
+// Global simulator profile is defined in simulator.cc
+extern Prof *PROF;
 
 /*
  * Cache::Cache - create a new cache object.
@@ -36,6 +59,12 @@ Cache::Cache(Tile * t, int l, int s, int a, int b) {
     readMisses   = 0;
     writeMisses  = 0;
     reads = writes = 0;
+    pfFills = pfMemFills = 0;
+    pfUseful = pfLate = pfLateCycles = 0;
+    pfUseless = 0;
+    exDrops = exReinserts = 0;
+    replFills = replSkipped = replHits = replMisses = 0;
+    replInvs = replEvicts = replDisplaced = 0;
 
     // Process arguments
     tile       = t;
@@ -65,12 +94,14 @@ Cache::Cache(Tile * t, int l, int s, int a, int b) {
     // If this is an L2 cache then we will create
     // a CCSM for each cache line. Since our L1 is write-through
     // we don't need a CCSM for L1 and can just keep up with the
-    // state at the L2 cache. 
+    // state at the L2 cache. (A write-back L1 only adds an owner,
+    // which the L2 line keeps track of, as it does the L1s that
+    // have copies.)
     if (cacheLevel == L2)
         for (i=0; i < numSets; i++)
             for (j=0; j< assoc; j++) {
                 ccsm = new CCSM(tile, this, &(cacheArray[i][j]));
-                cacheArray[i][j].init(ccsm);
+                cacheArray[i][j].init(ccsm, new BitVector(0));
             }
 }
 
@@ -166,6 +197,20 @@ ulong Cache::Access(ulong addr, uchar op) {
     if (state == HIT)
         updateLRU(line);
 
+    // First demand use of a prefetched line. If the prefetch
+    // is still on its way then wait for the rest of it.
+    if (state == HIT && line->isPrefetched()) {
+        ulong now = CURRENTCYCLE + CURRENTDELAY + CURRENTMEMDELAY;
+        line->clearPrefetched();
+        pfUseful++;
+        CURRENTPFHIT = 1;
+        if (line->getReady() > now) {
+            pfLate++;
+            pfLateCycles += line->getReady() - now;
+            CURRENTDELAY += line->getReady() - now;
+        }
+    }
+
     // Update the cache coherence protocol state machine
     // for this line in the cache
     if (cacheLevel == L2) {
@@ -179,16 +224,401 @@ ulong Cache::Access(ulong addr, uchar op) {
     return state;
 }
 
+/*
+ * Cache::bufferedWrite
+ *     - The (L1) cache's part of a store that goes into the store
+ *       buffer. A hit updates the line. A miss doesn't allocate
+ *       one; the store buffer holds the store until it drains.
+ *
+ * Returns MISS if miss
+ * Returns HIT  if hit
+ */
+ulong Cache::bufferedWrite(ulong addr) {
+    CacheLine * line;
+
+    assert(cacheLevel == L1);
+
+    CURRENTDELAY += L1ATIME;
+    lruCounter++;
+    writes++;
+
+    if (!(line = findLine(addr))) {
+        writeMisses++;
+        return MISS;
+    }
+
+    line->setFlags(DIRTY);
+    updateLRU(line);
+    return HIT;
+}
+
+/*
+ * Cache::prefetch
+ *     - Bring the block that contains addr into the (L2) cache
+ *       for a prefetcher. The fill goes through the directory like
+ *       a read miss but it doesn't count as an access. The line
+ *       remembers when its data arrives so that a demand access
+ *       that comes too soon can wait for it.
+ *
+ * Returns HIT if the block was already cached (nothing to do)
+ * Returns MISS if the block was fetched
+ */
+ulong Cache::prefetch(ulong addr) {
+    CacheLine * line;
+
+    assert(cacheLevel == L2);
+
+    // Tag check
+    CURRENTDELAY += L2ATIME;
+    if (findLine(addr))
+        return HIT;
+
+    lruCounter++;
+    line = fillLine(addr);
+    line->ccsm->procInitRd(addr);
+    line->setPrefetched(CURRENTCYCLE + CURRENTDELAY + CURRENTMEMDELAY);
+
+    pfFills++;
+    if (CURRENTMEMDELAY != 0)
+        pfMemFills++;
+
+    return MISS;
+}
+
+/*
+ * Cache::reinsert
+ *     - Exclusive hierarchy: put a block that an L1 of the
+ *       partition holds back into the (L2) cache. The L1 copy is
+ *       clean and the partition is still a sharer at the directory,
+ *       so the line comes back in S. (A write then upgrades it.)
+ *
+ * Returns 1 if the block was put back, 0 if it was already here.
+ */
+int Cache::reinsert(ulong addr) {
+    CacheLine * line;
+
+    assert(cacheLevel == L2);
+
+    if (findLine(addr))
+        return 0;
+
+    lruCounter++;
+    line = fillLine(addr);
+    line->ccsm->reinsert();
+    exReinserts++;
+    return 1;
+}
+
+/*
+ * Cache::dropClean
+ *     - Exclusive hierarchy: the block containing addr has just
+ *       been handed to an L1. If it is clean the (L2) cache lets it
+ *       go; dirty blocks stay since the L1 is write-through and
+ *       can't hold them.
+ *
+ * Returns 1 if the block was dropped.
+ */
+int Cache::dropClean(ulong addr) {
+    CacheLine * line = findLine(addr);
+
+    assert(cacheLevel == L2);
+
+    if (!line || line->getFlags() == DIRTY || !line->ccsm->isClean())
+        return 0;
+
+    line->ccsm->drop();
+    exDrops++;
+    return 1;
+}
+
+/*
+ * Cache::evictLine
+ *     - Evict the block containing addr from the (L2) cache if it
+ *       is there. The L1 copies are invalidated too.
+ *
+ * Returns 1 if the block was evicted.
+ */
+int Cache::evictLine(ulong addr) {
+    CacheLine * line = findLine(addr);
+
+    assert(cacheLevel == L2);
+
+    if (!line)
+        return 0;
+
+    line->ccsm->evict(1);
+    return 1;
+}
+
+/*
+ * Cache::replicate
+ *     - Victim replication: keep a clean block our tile's L1 is
+ *       evicting, and whose home is another slice, as a replica in
+ *       this (L2) cache. The replica goes in an invalid line, else
+ *       in place of the LRU replica, else in place of the LRU home
+ *       line that no L1 has a copy of. If every line of the set is
+ *       a home line some L1 uses the block isn't kept.
+ *
+ * Returns 1 if the replica was made.
+ */
+int Cache::replicate(ulong addr) {
+    CacheLine *line, *victim = NULL;
+    ulong j, index = calcIndex(addr);
+
+    assert(cacheLevel == L2);
+
+    if (findReplica(addr) || findLine(addr))
+        return 0;
+
+    for (j=0; j < assoc; j++) {
+        line = &cacheArray[index][j];
+        if (!line->isValid()) {
+            victim = line;
+            break;
+        }
+        if (line->isReplica()) {
+            if (!victim || !victim->isReplica() ||
+                line->getSeq() < victim->getSeq())
+                victim = line;
+        } else if (!line->getL1Sharers()->getNumSetBits()) {
+            if (!victim || (!victim->isReplica() &&
+                            line->getSeq() < victim->getSeq()))
+                victim = line;
+        }
+    }
+
+    if (!victim) {
+        replSkipped++;
+        return 0;
+    }
+
+    if (victim->isReplica()) {
+        replEvicts++;
+        victim->invalidate();
+    } else if (victim->isValid()) {
+        if (victim->getFlags() == DIRTY)
+            writeBack();
+        victim->ccsm->evict(0);
+        replDisplaced++;
+    }
+
+    lruCounter++;
+    updateLRU(victim);
+    victim->setTag(calcTag(addr));
+    victim->setIndex(index);
+    victim->setFlags(VALID);
+    victim->setReplica();
+    replFills++;
+    return 1;
+}
+
+/*
+ * Cache::replicaHit
+ *     - Victim replication: look for a replica of the block
+ *       containing addr in this (L2) cache for an L1 read miss.
+ *       A miss only costs the tag check.
+ *
+ * Returns 1 if there is one.
+ */
+int Cache::replicaHit(ulong addr) {
+    CacheLine *line = findReplica(addr);
+
+    assert(cacheLevel == L2);
+
+    lruCounter++;
+
+    if (!line) {
+        CURRENTDELAY += L2TAGTIME;
+        replMisses++;
+        return 0;
+    }
+
+    CURRENTDELAY += L2ATIME;
+    updateLRU(line);
+    replHits++;
+    return 1;
+}
+
+/*
+ * Cache::dropReplica
+ *     - Invalidate the replica of the block containing addr if
+ *       this (L2) cache has one.
+ *
+ * Returns 1 if there was one.
+ */
+int Cache::dropReplica(ulong addr) {
+    CacheLine *line = findReplica(addr);
+
+    if (!line)
+        return 0;
+
+    line->invalidate();
+    replInvs++;
+    return 1;
+}
+
+/*
+ * Cache::affinity
+ *     - Hot-block migration: tile asked this (L2) cache, the block's
+ *       home, for the block containing addr. A request from the
+ *       tile the line has affinity for bumps the counter. One from
+ *       any other tile lowers it and the affinity passes to that
+ *       tile when it runs out.
+ *
+ * Returns the tile once its counter saturates, else -1.
+ */
+int Cache::affinity(ulong addr, int tile) {
+    CacheLine * line = findLine(addr);
+    int t, c;
+
+    assert(cacheLevel == L2);
+
+    if (!line || line->isSpilled())
+        return -1;
+
+    t = line->getAffTile();
+    c = line->getAffCount();
+    if (t == tile) {
+        if (c < MIGCOUNTMAX)
+            c++;
+    } else if (--c <= 0) {
+        t = tile;
+        c = 1;
+    }
+    line->setAffinity(t, c);
+
+    return (c == MIGCOUNTMAX) ? t : -1;
+}
+
+/*
+ * Cache::moveLine
+ *     - Hot-block migration: the block containing addr has a new
+ *       home slice whose (L2) cache is to. Move our line there with
+ *       all it knows (flags, CCSM state, L1 sharers and owner,
+ *       affinity) and forget it here.
+ *
+ * Returns 1 if the line was moved.
+ */
+int Cache::moveLine(ulong addr, Cache *to) {
+    CacheLine *line, *dst;
+    BitVector *from, *bv;
+    int i;
+
+    assert(cacheLevel == L2 && to->cacheLevel == L2);
+
+    line = findLine(addr);
+    if (!line || to->findLine(addr))
+        return 0;
+
+    to->lruCounter++;
+    dst = to->fillLine(addr);
+    dst->setFlags(line->getFlags());
+    if (line->isPrefetched())
+        dst->setPrefetched(line->getReady());
+    if (line->isSpilled())
+        dst->setSpilled();
+    dst->setL1Owner(line->getL1Owner());
+    dst->setAffinity(line->getAffTile(), line->getAffCount());
+
+    from = line->getL1Sharers();
+    bv   = dst->getL1Sharers();
+    if (from && bv) {
+        bv->clearAllBits();
+        for (i=0; i < NPROCS; i++)
+            if (from->getBit(i))
+                bv->setBit(i);
+    }
+
+    dst->ccsm->setState(line->ccsm->state);
+    line->ccsm->moved();
+    return 1;
+}
+
+/*
+ * Cache::spillRoom
+ *     - Cooperative spilling: could a block another partition
+ *       spilled go in the set addr maps to without pushing out a
+ *       block of our own? It can take an invalid line, a replica or
+ *       another spilled block.
+ */
+int Cache::spillRoom(ulong addr) {
+    ulong index, j;
+
+    index = calcIndex(addr);
+    for(j=0;j<assoc;j++) {
+        if (!cacheArray[index][j].isValid() ||
+            cacheArray[index][j].isReplica() ||
+            cacheArray[index][j].isSpilled())
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Cache::spillIn
+ *     - Cooperative spilling: put a block that another partition's
+ *       L2 evicted in this (L2) cache. It keeps the flags and CCSM
+ *       state it had there, so dirty data stays dirty.
+ */
+void Cache::spillIn(ulong addr, ulong flags, int state) {
+    CacheLine * line;
+
+    assert(cacheLevel == L2 && !findLine(addr));
+
+    lruCounter++;
+    line = fillLine(addr);
+    line->setFlags(flags);
+    line->ccsm->setState(state);
+    line->setSpilled();
+}
+
+/*
+ * Cache::countReplicas
+ *     - Count the replicas held by this (L2) cache.
+ */
+ulong Cache::countReplicas() {
+    ulong i, j, n = 0;
+    for (i=0; i < numSets; i++)
+        for (j=0; j < assoc; j++)
+            if (cacheArray[i][j].isReplica())
+                n++;
+    return n;
+}
+
+/*
+ * Cache::countL1Only
+ *     - Count the valid (L1) lines whose blocks are not in their
+ *       home L2 slice. Together with the L2 lines that gives the
+ *       number of blocks the hierarchy holds.
+ */
+ulong Cache::countL1Only(Tile **tiles) {
+    ulong i, j, addr, n = 0;
+
+    for (i=0; i < numSets; i++) {
+        for (j=0; j < assoc; j++) {
+            if (!cacheArray[i][j].isValid())
+                continue;
+            addr = getBaseAddr(cacheArray[i][j].getTag(), i);
+            if (!tiles[tile->mapAddrToTile(addr)]->hasL2Line(addr))
+                n++;
+        }
+    }
+    return n;
+}
+
 /*
  * Cache::findLine
  *     - Find a line within the cache that corresponds
- *       to the address addr. 
+ *       to the address addr. Replicas don't count; only the
+ *       home slice's own lines do.
  *
  * Returns a CacheLine object or NULL if not found.
  */
 CacheLine * Cache::findLine(ulong addr) {
     ulong index, j, tag;
 
+    PROF->calls[PROFFINDLINE]++;
+
     // Calculate tag and index from addr
     tag   = calcTag(addr);   // Tag value
     index = calcIndex(addr); // Set index
@@ -196,8 +626,9 @@ CacheLine * Cache::findLine(ulong addr) {
     // Iterate through set to see if we have a hit.
     for(j=0; j<assoc; j++) {
 
-        // If not valid then continue
-        if (cacheArray[index][j].isValid() == 0)
+        // If not valid (or a replica) then continue
+        if (cacheArray[index][j].isValid() == 0 ||
+            cacheArray[index][j].isReplica())
             continue;
 
         // Does the tag match.. If so then score!
@@ -210,6 +641,26 @@ CacheLine * Cache::findLine(ulong addr) {
     return NULL;
 }
 
+/*
+ * Cache::findReplica
+ *     - Find the replica of the block containing addr.
+ *
+ * Returns a CacheLine object or NULL if not found.
+ */
+CacheLine * Cache::findReplica(ulong addr) {
+    ulong index, j, tag;
+
+    tag   = calcTag(addr);
+    index = calcIndex(addr);
+
+    for (j=0; j < assoc; j++)
+        if (cacheArray[index][j].isReplica() &&
+            cacheArray[index][j].getTag() == tag)
+            return &(cacheArray[index][j]);
+
+    return NULL;
+}
+
 /*
  * Cache::updateLRU
  *     - Update the sequence for line to be 
@@ -231,6 +682,8 @@ void Cache::updateLRU(CacheLine *line) {
 CacheLine * Cache::getLRU(ulong addr) {
     ulong index, j, victim, min;
 
+    PROF->calls[PROFGETLRU]++;
+
     // set victim = assoc (an impossible value)
     victim = assoc;
 
@@ -246,6 +699,30 @@ CacheLine * Cache::getLRU(ulong addr) {
           return &(cacheArray[index][j]);     
     }   
 
+    // Replicas are only extra copies so the LRU one goes before
+    // any of the home lines
+    for(j=0;j<assoc;j++) {
+        if (cacheArray[index][j].isReplica() &&
+            cacheArray[index][j].getSeq() <= min) {
+            victim = j;
+            min = cacheArray[index][j].getSeq();
+        }
+    }
+    if (victim != assoc)
+        return &(cacheArray[index][victim]);
+
+    // So are blocks other partitions spilled here (they are kept
+    // for them only while we don't need the room)
+    for(j=0;j<assoc;j++) {
+        if (cacheArray[index][j].isSpilled() &&
+            cacheArray[index][j].getSeq() <= min) {
+            victim = j;
+            min = cacheArray[index][j].getSeq();
+        }
+    }
+    if (victim != assoc)
+        return &(cacheArray[index][victim]);
+
     // No invalid lines. Find LRU. 
     for(j=0;j<assoc;j++) {
         if (cacheArray[index][j].getSeq() <= min) { 
@@ -271,18 +748,45 @@ CacheLine * Cache::getLRU(ulong addr) {
 CacheLine *Cache::fillLine(ulong addr) { 
     CacheLine *victim;
 
+    // A replica of a block that has become ours (its home moved
+    // here) would be a second copy
+    if (cacheLevel == L2 && REPLICATE)
+        dropReplica(addr);
+
     // Get the LRU block (or invalid block)
     victim = getLRU(addr);
     assert(victim);
 
+    // With cooperative spilling the fill counts toward how busy our
+    // partition is and the victim may move to a neighbour partition
+    // rather than leave the chip
+    if (cacheLevel == L2 && SPILL)
+        tile->spillVictim(victim);
+
     // If the chosen victim is dirty then update writeBack
     if (victim->isValid() && victim->getFlags() == DIRTY)
         writeBack();
 
     // If the chosen victim is valid then mark as invalid 
-    // in the CCSM
-    if (cacheLevel == L2 && victim->isValid())
-        victim->ccsm->evict();
+    // in the CCSM. A replica just goes.
+    if (cacheLevel == L2 && victim->isReplica()) {
+        replEvicts++;
+        victim->invalidate();
+    } else if (cacheLevel == L2 && victim->isValid()) {
+        victim->ccsm->evict(0);
+    }
+
+    // A write-back L1 sends its dirty victims home. In an exclusive
+    // hierarchy the clean ones go back to the L2 too. With victim
+    // replication the clean ones may stay in our own L2 slice.
+    if (cacheLevel == L1 && victim->isValid()) {
+        if (L1WRITE == L1WRBACK && victim->getFlags() == DIRTY)
+            tile->l1WriteBack(getBaseAddr(victim->getTag(), victim->getIndex()));
+        else if (HIERARCHY == HIEREXCL)
+            tile->l1Victim(getBaseAddr(victim->getTag(), victim->getIndex()));
+        else if (REPLICATE && victim->getFlags() != DIRTY)
+            tile->l1Replicate(getBaseAddr(victim->getTag(), victim->getIndex()));
+    }
 
     // Since we are placing data into this line
     // then update the LRU information to indicate
@@ -293,6 +797,12 @@ CacheLine *Cache::fillLine(ulong addr) {
     victim->setTag(calcTag(addr));
     victim->setIndex(calcIndex(addr));
     victim->setFlags(VALID);    
+    victim->clearPrefetched();
+
+    // Unless the hierarchy is inclusive the L1s may still have
+    // copies from before the block last left the L2
+    if (cacheLevel == L2 && HIERARCHY != HIERINCL)
+        tile->allL1Sharers(victim);
 
     return victim;
 }
@@ -318,6 +828,90 @@ void Cache::invalidateLineIfExists(ulong addr) {
     }
 }
 
+/*
+ * Cache::countLines
+ *     - Count the valid and the dirty lines in the cache.
+ *       Replicas are extra copies and aren't counted.
+ */
+void Cache::countLines(ulong *valid, ulong *dirty) {
+    ulong i, j;
+    *valid = *dirty = 0;
+    for (i=0; i < numSets; i++) {
+        for (j=0; j < assoc; j++) {
+            if (cacheArray[i][j].isReplica())
+                continue;
+            if (cacheArray[i][j].isValid())
+                (*valid)++;
+            if (cacheArray[i][j].getFlags() == DIRTY)
+                (*dirty)++;
+        }
+    }
+}
+
+/*
+ * Cache::flush
+ *     - Evict every valid line of the (L2) cache. Dirty lines go
+ *       back to memory and the directory forgets the blocks.
+ *       Counts the valid and dirty lines that were flushed.
+ *       Replicas are simply dropped.
+ */
+void Cache::flush(Dir *dir, ulong *valid, ulong *dirty) {
+    ulong i, j;
+    CacheLine *line;
+
+    assert(cacheLevel == L2);
+
+    *valid = *dirty = 0;
+    for (i=0; i < numSets; i++) {
+        for (j=0; j < assoc; j++) {
+            line = &cacheArray[i][j];
+            if (line->isReplica())
+                line->invalidate();
+            if (!line->isValid())
+                continue;
+            (*valid)++;
+            if (line->getFlags() == DIRTY)
+                (*dirty)++;
+            dir->clearEntry(getBaseAddr(line->getTag(), line->getIndex()));
+            line->ccsm->evict(1);
+        }
+    }
+}
+
+
+/*
+ * Cache::invalidateAll
+ *     - Drop every line of the (L1) cache. Its lines are clean
+ *       (write-through, or recalled by the L2 flush if write-back)
+ *       so nothing has to be written back.
+ */
+void Cache::invalidateAll() {
+    ulong i, j;
+
+    assert(cacheLevel == L1);
+
+    for (i=0; i < numSets; i++)
+        for (j=0; j < assoc; j++)
+            cacheArray[i][j].invalidate();
+}
+
+
+/*
+ * Cache::recall
+ *     - The home slice wants the dirty data of a block this
+ *       (write-back L1) cache owns. The line is written back and
+ *       stays as a clean copy.
+ */
+void Cache::recall(ulong addr) {
+    CacheLine *line = findLine(addr);
+
+    assert(cacheLevel == L1);
+    assert(line && line->getFlags() == DIRTY);
+
+    writeBack();
+    line->setFlags(VALID);
+}
+
 
 /*
  * Cache::PrintStats
@@ -347,53 +941,24 @@ void Cache::PrintStats() {
 }
 
 /*
- * Cache::PrintStatsTabular
- *     - Print statistics for this cache.
+ * Cache::getStats
+ *     - Add this cache's counters to the current row of the tile
+ *       table t (the column names start with L1 or L2).
  */
-void Cache::PrintStatsTabular(int printhead) {
-
-    char buftemp[100]  = { 0 };
-    char bufhead[2048] = { 0 };
-    char bufbody[2048] = { 0 };
-    char level[100]    = "L2";
-
-    if (cacheLevel == L1)
-        level[1] = '1';
-
-    sprintf(level+2, "%s", "reads");
-    sprintf(buftemp, "%15s", level);
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", reads);
-    strcat(bufbody, buftemp);
-
-    sprintf(level+2, "%s", "rdMisses");
-    sprintf(buftemp, "%15s", level);
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", readMisses);
-    strcat(bufbody, buftemp);
-
-    sprintf(level+2, "%s", "writes");
-    sprintf(buftemp, "%15s", level);
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", writes);
-    strcat(bufbody, buftemp);
-
-    sprintf(level+2, "%s", "wrMisses");
-    sprintf(buftemp, "%15s", level);
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", writeMisses);
-    strcat(bufbody, buftemp);
-
-    sprintf(level+2, "%s", "wrBacks");
-    sprintf(buftemp, "%15s", level);
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", writeBacks);
-    strcat(bufbody, buftemp);
-
-    if (printhead)
-        printf("%s", bufhead);
-    else
-        printf("%s", bufbody);
-
+void Cache::getStats(StatTable *t) {
+
+    char name[STATNAMELEN];
+    const char *level = (cacheLevel == L1) ? "L1" : "L2";
+
+    sprintf(name, "%sreads", level);
+    t->count(name, reads);
+    sprintf(name, "%srdMisses", level);
+    t->count(name, readMisses);
+    sprintf(name, "%swrites", level);
+    t->count(name, writes);
+    sprintf(name, "%swrMisses", level);
+    t->count(name, writeMisses);
+    sprintf(name, "%swrBacks", level);
+    t->count(name, writeBacks);
 }
 
@@ -13,9 +13,34 @@
 #define  HIT 0
 #define MISS 1
 
+// How the L1s relate to the L2 (selected with hierarchy=<policy>)
+enum {
+    HIERINCL = 0, // Inclusive: L2 evictions invalidate the L1 copies
+    HIERNINE,     // Non-inclusive non-exclusive: L1 copies survive
+    HIEREXCL,     // Exclusive: clean blocks move up into the L1 and
+                  // L1 victims come back down into the L2
+};
+
+// How L1 copies are found when an L2 line goes (selected with
+// l1inv=<policy>)
+enum {
+    L1INVBCAST = 0, // Send L1INV to every tile of the partition
+    L1INVMASK,      // Send L1INV to the tiles in the line's L1 sharer
+                    // mask only
+};
+
+// L1 write policy (selected with l1write=<policy>)
+enum {
+    L1WRTHRU = 0, // Write-through: every write also goes to the L2
+    L1WRBACK,     // Write-back: the first write gets ownership from
+                  // the home L2 slice and later ones stay in the L1
+};
+
 class CacheLine; // Forward Declaration
 class CCSM;      // Forward Declaration
 class Tile;      // Forward Declaration  
+class Dir;       // Forward Declaration
+class StatTable; // Forward Declaration
 
 class Cache {
 protected:
@@ -32,6 +57,25 @@ protected:
     ulong interventions, invalidations;
     ulong transfers;
 
+    // Prefetch counters (L2 only)
+    ulong pfFills, pfMemFills;
+    ulong pfUseful, pfLate, pfLateCycles;
+    ulong pfUseless;
+
+public:
+    // Exclusive hierarchy counters (L2 only)
+    ulong exDrops;     // Clean blocks that moved up into an L1
+    ulong exReinserts; // L1 victims (or written blocks) put back
+
+    // Victim replication counters (L2 only)
+    ulong replFills;     // Clean L1 victims kept as replicas
+    ulong replSkipped;   // ... that found no room in the set
+    ulong replHits;      // L1 read misses that found a replica
+    ulong replMisses;    // ... that didn't
+    ulong replInvs;      // Replicas invalidated (L1INV or a write)
+    ulong replEvicts;    // Replicas pushed out by other lines
+    ulong replDisplaced; // Home lines evicted to make room for one
+
     // The 2-dimensional cache
     CacheLine **cacheArray;
 
@@ -47,9 +91,14 @@ public:
 
     CacheLine * fillLine(ulong addr);
     CacheLine * findLine(ulong addr);
+    CacheLine * findReplica(ulong addr);
     CacheLine * getLRU(ulong);
 
     void invalidateLineIfExists(ulong addr);
+    void countLines(ulong *valid, ulong *dirty);
+    void flush(Dir *dir, ulong *valid, ulong *dirty);
+    void invalidateAll();
+    void recall(ulong addr);
 
     ulong getRM()       { return readMisses;  }
     ulong getWM()       { return writeMisses; }
@@ -57,10 +106,32 @@ public:
     ulong getWrites()   { return writes;      }
     ulong getWB()       { return writeBacks;  }
     void writeBack()    { writeBacks++;       }
+    void prefetchUseless() { pfUseless++;     }
+
+    ulong getPFFills()      { return pfFills;      }
+    ulong getPFMemFills()   { return pfMemFills;   }
+    ulong getPFUseful()     { return pfUseful;     }
+    ulong getPFLate()       { return pfLate;       }
+    ulong getPFLateCycles() { return pfLateCycles; }
+    ulong getPFUseless()    { return pfUseless;    }
 
     ulong Access(ulong, uchar);
+    ulong prefetch(ulong addr);
+    ulong bufferedWrite(ulong addr);
+    int   reinsert(ulong addr);
+    int   dropClean(ulong addr);
+    int   evictLine(ulong addr);
+    int   replicate(ulong addr);
+    int   replicaHit(ulong addr);
+    int   dropReplica(ulong addr);
+    int   spillRoom(ulong addr);
+    int   affinity(ulong addr, int tile);
+    int   moveLine(ulong addr, Cache *to);
+    void  spillIn(ulong addr, ulong flags, int state);
+    ulong countReplicas();
+    ulong countL1Only(Tile **tiles);
     void PrintStats();
-    void PrintStatsTabular(int printhead); 
+    void getStats(StatTable *t);
     void updateLRU(CacheLine *);
 
     ulong calcTag(ulong addr);
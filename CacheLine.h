@@ -6,7 +6,9 @@
 #ifndef CACHELINE_H
 #define CACHELINE_H
 
+#include <stddef.h>
 #include "types.h"
+#include "BitVector.h"
 
 class CCSM; // Forward Declaration
 
@@ -24,10 +26,20 @@ protected:
     ulong Flags;   // 0:invalid, 1:valid, 2:dirty 
     ulong seq; 
     ulong state;
+    ulong prefetched; // Brought in by a prefetch and not used yet
+    ulong ready;      // Time the prefetched data arrives
+    int   l1owner;    // Tile whose write-back L1 has the block dirty (-1 if none)
+    ulong replica;    // A copy of a block homed in another slice (L2 only)
+    ulong spilled;    // Spilled here by another partition (L2 only)
+    int   afftile;    // Tile that dominates the requests (-1 if none)
+    int   affcount;   // How strongly (saturates at MIGCOUNTMAX)
+    BitVector * l1sharers; // Tiles whose L1s may have the block (L2 only)
  
 public:
     CCSM * ccsm;
-    CacheLine()                 { tag = 0; Flags = 0; }
+    CacheLine()                 { tag = 0; Flags = 0; prefetched = 0; l1owner = -1;
+                                  replica = 0; spilled = 0; afftile = -1; affcount = 0;
+                                  l1sharers = NULL; }
     ulong getTag()              { return tag; }
     ulong getIndex()            { return index; }
     ulong getFlags()            { return Flags;}
@@ -36,9 +48,26 @@ public:
     void setFlags(ulong flags)  { Flags = flags;}
     void setTag(ulong a)        { tag   = a; }
     void setIndex(ulong a)      { index = a; }
-    void invalidate()           { tag = 0; Flags = INVALID; }
+    void invalidate()           { tag = 0; Flags = INVALID; prefetched = 0; l1owner = -1;
+                                  replica = 0; spilled = 0; afftile = -1; affcount = 0;
+                                  if (l1sharers) l1sharers->clearAllBits(); }
     bool isValid()              { return ((Flags) != INVALID); }
-    void init(CCSM *sm) {
+    bool isPrefetched()         { return prefetched; }
+    ulong getReady()            { return ready; }
+    void setPrefetched(ulong t) { prefetched = 1; ready = t; }
+    void clearPrefetched()      { prefetched = 0; }
+    int  getL1Owner()           { return l1owner; }
+    void setL1Owner(int t)      { l1owner = t; }
+    bool isReplica()            { return replica; }
+    void setReplica()           { replica = 1; }
+    bool isSpilled()            { return spilled; }
+    void setSpilled()           { spilled = 1; }
+    int  getAffTile()           { return afftile; }
+    int  getAffCount()          { return affcount; }
+    void setAffinity(int t, int c) { afftile = t; affcount = c; }
+    BitVector * getL1Sharers()  { return l1sharers; }
+    void init(CCSM *sm, BitVector *bv) {
+        l1sharers = bv;
         invalidate(); 
         ccsm = sm;
     }
@@ -0,0 +1,214 @@
+/*
+ * Dusty Mabe - 2014
+ * Coop.cc - Implementation of cooperative spilling between partitions.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "Coop.h"
+#include "Dir.h"
+#include "Tile.h"
+#include "Net.h"
+#include "params.h"
+#include "Delay.h"
+
+// Global NETWORK is defined in simulator.cc
+extern Net *NETWORK;
+
+Coop::Coop(Dir *d, Tile **t) {
+
+    dir   = d;
+    tiles = t;
+
+    memset(fills,     0, sizeof(fills));
+    memset(spillsout, 0, sizeof(spillsout));
+    memset(spillsin,  0, sizeof(spillsin));
+    noroom = notonly = present = full = 0;
+    spilling = 0;
+
+    rebuild();
+}
+
+/*
+ * Coop::rebuild
+ *     - Find the partitions next to each partition (those with a
+ *       tile one hop or less from one of its tiles) and start the
+ *       utilization counters over. Called again after a
+ *       repartition.
+ */
+void Coop::rebuild() {
+    int i, j, p, q, near;
+
+    memset(util, 0, sizeof(util));
+    memset(nadj, 0, sizeof(nadj));
+    window = 0;
+
+    for (p=0; p < dir->numparts; p++) {
+        for (q=0; q < dir->numparts; q++) {
+            near = 0;
+            for (i=0; q != p && i < dir->partsize[p] && !near; i++)
+                for (j=0; j < dir->partsize[q] && !near; j++)
+                    near = (NETWORK->calcTileToTileHops(dir->parttiles[p][i],
+                                                        dir->parttiles[q][j]) <= 1);
+            if (near)
+                adj[p][nadj[p]++] = q;
+        }
+    }
+}
+
+/*
+ * Coop::fill
+ *     - A slice of partition partid is filling a line. Blocks put
+ *       in for a spill don't count.
+ */
+void Coop::fill(int partid) {
+    int p;
+
+    if (spilling)
+        return;
+
+    util[partid]++;
+    fills[partid]++;
+
+    if (++window >= SPILLWINDOW) {
+        window = 0;
+        for (p=0; p < dir->numparts; p++)
+            util[p] /= 2;
+    }
+}
+
+/*
+ * Coop::target
+ *     - Pick the partition that partid's victim (the block
+ *       containing addr) should be spilled to: the least loaded
+ *       adjacent partition, if it is lightly loaded. Only the last
+ *       copy on the chip is worth spilling and only to a partition
+ *       that doesn't have it and has room for it (a spilled block
+ *       never pushes out one of the neighbour's own).
+ *
+ * Returns the partition or -1 if the victim isn't spilled.
+ */
+int Coop::target(ulong addr, int partid) {
+    int i, p, totile, best = -1;
+
+    if (spilling)
+        return -1;
+
+    for (i=0; i < nadj[partid]; i++) {
+        p = adj[partid][i];
+        if (util[p] * dir->partsize[partid] * SPILLRATIO >=
+            util[partid] * dir->partsize[p])
+            continue;
+        if (best < 0 || util[p] * dir->partsize[best] <
+                        util[best] * dir->partsize[p])
+            best = p;
+    }
+
+    if (best < 0) {
+        noroom++;
+        return -1;
+    }
+
+    if (!dir->spillable(addr, partid)) {
+        notonly++;
+        return -1;
+    }
+
+    totile = dir->mapAddrToTile(best, addr);
+    if (tiles[totile]->hasL2Line(addr)) {
+        present++;
+        return -1;
+    }
+
+    if (!tiles[totile]->spillRoom(addr)) {
+        full++;
+        return -1;
+    }
+
+    return best;
+}
+
+/*
+ * Coop::spill
+ *     - Move the block containing addr (whose line had flags and
+ *       CCSM state state) from fromtile's slice to its home tile in
+ *       partition topart and tell the directory. Nobody waits for
+ *       this.
+ */
+void Coop::spill(ulong addr, int fromtile, int topart, ulong flags, int state) {
+
+    int totile   = dir->mapAddrToTile(topart, addr);
+    int frompart = dir->mapTileToPart(fromtile);
+    DelayScope saved;
+
+    spilling = 1;
+
+    NETWORK->fakeDataTileToTile(fromtile, totile);
+    tiles[totile]->spillIn(addr, flags, state);
+    NETWORK->fakeReqTileToDir(addr, totile);
+    dir->spillMove(addr, frompart, topart, totile);
+
+    spilling = 0;
+
+    spillsout[frompart]++;
+    spillsin[topart]++;
+}
+
+/*
+ * Coop::lost
+ *     - A slice of partition partid evicted a block that was
+ *       spilled to it. Let the directory know (with a message that
+ *       nobody waits for).
+ */
+void Coop::lost(ulong addr, int partid) {
+
+    DelayScope saved;
+
+    NETWORK->fakeReqTileToDir(addr, dir->mapAddrToTile(partid, addr));
+    dir->spillLost(addr, partid);
+}
+
+/*
+ * Coop::PrintStats
+ *     - Print a row per partition of its L2 fills, its utilization
+ *       counter at the end and the victims it spilled and took in.
+ *       Then how many spills paid off (the block came back from
+ *       the neighbour) and the memory traffic left.
+ */
+void Coop::PrintStats(int tabular) {
+
+    int p;
+    ulong out = 0, in = 0, f = 0;
+
+    if (!tabular)
+        printf("===== Cooperative spilling ========================\n");
+    printf("%15s%15s%15s%15s%15s%15s\n",
+           "partition", "tiles", "l2fills", "util", "spillsout", "spillsin");
+
+    for (p=0; p < dir->numparts; p++) {
+        printf("%15d%15d%15lu%15lu%15lu%15lu\n", p, dir->partsize[p],
+               fills[p], util[p], spillsout[p], spillsin[p]);
+        f   += fills[p];
+        out += spillsout[p];
+        in  += spillsin[p];
+    }
+    printf("%15s%15d%15lu%15s%15lu%15lu\n", "all", NPROCS, f, "-", out, in);
+
+    if (tabular) {
+        printf("%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s\n",
+               "spills", "noroom", "notonly", "present", "full", "returns",
+               "returnrate", "lost", "memreads", "memwbacks");
+        printf("%15lu%15lu%15lu%15lu%15lu%15lu%15f%15lu%15lu%15lu\n",
+               out, noroom, notonly, present, full, dir->spillreturns,
+               out ? ((float)dir->spillreturns / (float)out) : 0.0,
+               dir->spilllost, dir->memreads, dir->memwbacks);
+    } else {
+        printf("Spilled %lu victims (%lu kept since no neighbour was lightly "
+               "loaded, %lu not the last copy, %lu already there, "
+               "%lu no room)\n", out, noroom, notonly, present, full);
+        printf("Spilled blocks got back %lu, evicted by the neighbour %lu, "
+               "memory reads %lu, writebacks %lu\n",
+               dir->spillreturns, dir->spilllost, dir->memreads, dir->memwbacks);
+    }
+}
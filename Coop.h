@@ -0,0 +1,58 @@
+/*
+ * Dusty Mabe - 2014
+ * Coop.h - Header file for cooperative spilling between partitions.
+ *          Normally a block evicted from a partition's L2 leaves the
+ *          chip (written back if dirty). With spill=on a victim that
+ *          no other partition has is moved into the L2 of an
+ *          adjacent partition instead, if that partition is lightly
+ *          loaded. Its next miss in the spiller gets it back from
+ *          there with a ptop transfer rather than from memory.
+ *
+ *          How loaded a partition is comes from a utilization
+ *          counter per partition: the L2 fills of its slices,
+ *          halved every SPILLWINDOW fills so that it follows the
+ *          recent past. A neighbour is lightly loaded if its fills
+ *          per tile are under 1/SPILLRATIO of the spiller's.
+ */
+#ifndef COOP_H
+#define COOP_H
+
+#include "types.h"
+#include "params.h"
+
+class Dir;  // Forward Declaration
+class Tile; // Forward Declaration
+
+class Coop {
+private:
+    Dir * dir;
+    Tile ** tiles;
+    ulong util[NPROCS];       // Decayed L2 fills of each partition
+    ulong window;             // Fills since the counters were halved
+    int   nadj[NPROCS];       // Partitions adjacent to each partition
+    int   adj[NPROCS][NPROCS];
+    int   spilling;           // Set while a spilled block is put in
+
+public:
+    // Counters (per partition number)
+    ulong fills[NPROCS];      // L2 fills in the partition
+    ulong spillsout[NPROCS];  // Victims it spilled to a neighbour
+    ulong spillsin[NPROCS];   // Victims it took in from a neighbour
+
+    // Victims that weren't spilled
+    ulong noroom;   // ... since no neighbour was lightly loaded
+    ulong notonly;  // ... since another partition had the block
+    ulong present;  // ... since the neighbour's slice had it already
+    ulong full;     // ... since its set there held only their blocks
+
+    Coop(Dir *d, Tile **t);
+
+    void rebuild();
+    void fill(int partid);
+    int  target(ulong addr, int partid);
+    void spill(ulong addr, int fromtile, int topart, ulong flags, int state);
+    void lost(ulong addr, int partid);
+    void PrintStats(int tabular);
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * Dusty Mabe - 2014
+ * Delay.h - Header file for the delay counters of the access being
+ *           simulated. CURRENTDELAY is the time spent on chip so far
+ *           and CURRENTMEMDELAY the time spent at memory. Both are
+ *           defined in simulator.cc.
+ *
+ *           Messages that nobody waits for (write-backs, evictions,
+ *           prefetches, ...) are still sent through the network so
+ *           that they are counted, but they must not add to the
+ *           latency of the access that caused them. A DelayScope
+ *           saves the counters when it is created and puts them
+ *           back when it goes out of scope.
+ */
+#ifndef DELAY_H
+#define DELAY_H
+
+#include "types.h"
+
+// Global delay counter for the current outstanding memory request.
+extern ulong CURRENTDELAY;
+extern ulong CURRENTMEMDELAY;
+
+class DelayScope {
+private:
+    int kept; // Leave the counters alone at the end of the scope
+
+public:
+    ulong delay;    // CURRENTDELAY when the scope started
+    ulong memdelay; // CURRENTMEMDELAY when the scope started
+
+    DelayScope() {
+        kept     = 0;
+        delay    = CURRENTDELAY;
+        memdelay = CURRENTMEMDELAY;
+    }
+
+    ~DelayScope() {
+        if (kept)
+            return;
+        CURRENTDELAY    = delay;
+        CURRENTMEMDELAY = memdelay;
+    }
+
+    // The access waits for what was sent after all
+    inline void keep() { kept = 1; }
+};
+
+#endif
@@ -6,22 +6,62 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include "Dir.h"
 #include "BitVector.h"
 #include "Net.h"
 #include "Tile.h"
+#include "MemCtrl.h"
+#include "ResTable.h"
+#include "CCSM.h"
+#include "Cache.h"
+#include "Nuca.h"
+#include "Prof.h"
 #include "types.h"
+#include "Delay.h"
 
 
 // Global NETWORK is defined in simulator.cc
 extern Net *NETWORK;
 
-// Global delay counter for the current outstanding memory request.
-extern int CURRENTDELAY;
-extern int CURRENTMEMDELAY;
+// Global L2 placement policy state is defined in simulator.cc
+extern Nuca *NUCA;
+
+// Global simulator profile is defined in simulator.cc
+extern Prof *PROF;
+
 extern int PARTSHARING;
 
+// The cycle of the access currently being simulated
+extern ulong CURRENTCYCLE;
+
+// Which memory model to use (MEMFIXED or MEMDRAM)
+extern ulong MEMMODEL;
+
+// Which directory timing model to use (DIRINSTANT or DIRTIMED)
+extern ulong DIRMODEL;
+
+// Which coherence protocol to use (PROTOMESI, PROTOMOESI or PROTOMESIF)
+extern ulong PROTOCOL;
+
+// How the L1s and L2s relate (HIERINCL, HIERNINE or HIEREXCL)
+extern ulong HIERARCHY;
+
+// Bytes per coarse directory region (0 tracks every block on its own)
+extern ulong DIRREGION;
+
+// Number of memory controllers (one directory slice each)
+extern ulong NUMMEMCTRLS;
+
+// Shape of the tile grid
+extern ulong TOPOWIDTH;
+extern ulong TOPOHEIGHT;
+
+// How the tiles are split into partitions
+extern ulong PARTLAYOUT;
+extern char *PARTFILE;
+
 /*
  * DirEntry constructor
  *    - Build up the data structures that belong to a
@@ -29,9 +69,18 @@ extern int PARTSHARING;
  *      address blockaddr.
  */
 DirEntry::DirEntry(ulong blockaddr) {
-    blockaddr = blockaddr;
+    this->blockaddr = blockaddr;
     state     = DSTATEI;
     sharers   = new BitVector(0);
+    owner     = -1;
+    spiller   = -1;
+    spillto   = -1;
+
+    busystart  = 0;
+    busyuntil  = 0;
+    qdepth     = 0;
+    waitcycles = 0;
+    next       = NULL;
 }
 
 /*
@@ -42,6 +91,20 @@ DirEntry::~DirEntry() {
     delete sharers;
 }
 
+/*
+ * RegionEntry constructor
+ *    - A region that partition partid has just touched for the
+ *      first time. It is the partition's alone until someone else
+ *      touches it.
+ */
+RegionEntry::RegionEntry(ulong region, int partid) {
+    this->region = region;
+    owner  = partid;
+    shared = 0;
+    exact  = 0;
+    next   = NULL;
+}
+
 
 /*
  * Dir constructor
@@ -49,63 +112,257 @@ DirEntry::~DirEntry() {
  *      directory.
  */
 Dir::Dir(int partscheme) {
+
+    // A 32 bit address space has 2^26 (NUMBLOCKS) blocks but only
+    // the ones in use get an entry. Start with a small hash table
+    // and let it grow with them.
+    dirbits   = DIRTABLEBITS;
+    directory = new DirEntry*[1UL << dirbits]();
+
+    // Cold misses are only counted if someone asks
+    touched    = NULL;
+    coldmisses = 0;
+
+    memset(reqs,      0, sizeof(reqs));
+    memset(reqcycles, 0, sizeof(reqcycles));
+    memreads = memflushes = memwbacks = 0;
+    c2cxfers = ownerxfers = 0;
+    spillreturns = spilllost = 0;
+
+    blocklookups = regionlookups = 0;
+    blockentries = maxblockentries = regionentries = maxdirbytes = 0;
+    regionshares = probes = probeheld = probecycles = 0;
+    memset(statecount, 0, sizeof(statecount));
+
+    // Track whole regions until they are shared if asked to
+    regions    = NULL;
+    regbits    = 0;
+    regionbits = 0;
+    if (DIRREGION) {
+        while ((1UL << regionbits) < DIRREGION)
+            regionbits++;
+        regbits = DIRTABLEBITS;
+        regions = new RegionEntry*[1UL << regbits]();
+    }
+
+    // Model the memory controllers if asked to
+    mem = NULL;
+    if (MEMMODEL == MEMDRAM)
+        mem = new MemCtrl();
+
+    // Model directory occupancy if asked to
+    dirbusy = NULL;
+    if (DIRMODEL == DIRTIMED) {
+        dirbusy = new ResTable(NUMMEMCTRLS, DIRBUCKETBITS, DIRBUCKETS,
+                               1 << DIRBUCKETBITS);
+        dirreqs    = new ulong[NUMMEMCTRLS];
+        dirqcycles = new ulong[NUMMEMCTRLS];
+        blockwaits = new ulong[NUMMEMCTRLS];
+        waitcycles = new ulong[NUMMEMCTRLS];
+        qdepthsum  = new ulong[NUMMEMCTRLS];
+        maxqdepth  = new ulong[NUMMEMCTRLS];
+        memset(dirreqs,    0, NUMMEMCTRLS * sizeof(ulong));
+        memset(dirqcycles, 0, NUMMEMCTRLS * sizeof(ulong));
+        memset(blockwaits, 0, NUMMEMCTRLS * sizeof(ulong));
+        memset(waitcycles, 0, NUMMEMCTRLS * sizeof(ulong));
+        memset(qdepthsum,  0, NUMMEMCTRLS * sizeof(ulong));
+        memset(maxqdepth,  0, NUMMEMCTRLS * sizeof(ulong));
+    }
+
+    // Split the tiles into partitions
+    if (PARTLAYOUT == LAYOUTFILE) {
+        loadPartFile(PARTFILE);
+    } else {
+        if (!validScheme(partscheme)) {
+            if (PARTLAYOUT == LAYOUTRECT)
+                printf("Can't split a %lux%lu grid into partitions of %d tiles. "
+                       "Try layout=linear or a partition map file\n",
+                       TOPOWIDTH, TOPOHEIGHT, partscheme);
+            else
+                printf("Can't make partitions of %d tiles\n", partscheme);
+            exit(1);
+        }
+        buildParts(partscheme);
+    }
+
+    buildPartLookup();
+}
+
+/*
+ * Dir::rectShape
+ *     - For the rect layout partitions are rectangles of tiles on
+ *       the tile grid that are about as square as possible (wider
+ *       than they are tall when they can't be square). Find the
+ *       width c and height r of the rectangle for partscheme.
+ *
+ * Returns 0 if the grid can't be split into such rectangles.
+ */
+int Dir::rectShape(int partscheme, int *c, int *r) {
+
+    if (partscheme < 1)
+        return 0;
+
+    for (*c=1; (*c)*(*c) < partscheme; *c*=2)
+        ;
+    if (*c > (int)TOPOWIDTH)
+        *c = TOPOWIDTH;
+    *r = partscheme / *c;
+    if (*r > (int)TOPOHEIGHT) {
+        *r = TOPOHEIGHT;
+        *c = partscheme / *r;
+    }
+
+    return ((*c)*(*r) == partscheme && TOPOWIDTH % *c == 0 && TOPOHEIGHT % *r == 0);
+}
+
+/*
+ * Dir::validScheme
+ *     - Can the layout rule make partitions of partscheme tiles?
+ */
+int Dir::validScheme(int partscheme) {
+    int c, r;
+    if (PARTLAYOUT == LAYOUTLINEAR)
+        return (partscheme >= 1 && partscheme <= NPROCS);
+    return rectShape(partscheme, &c, &r);
+}
+
+/*
+ * Dir::ruleTilePart
+ *     - Partition that tile falls in when the layout rule makes
+ *       partitions of partscheme tiles. Rectangles are numbered row
+ *       major. Linear partitions are runs of partscheme consecutive
+ *       tile ids and if partscheme doesn't divide NPROCS the last
+ *       partition gets the tiles that are left over.
+ */
+int Dir::ruleTilePart(int partscheme, int tile) {
+    int c, r;
+
+    if (PARTLAYOUT == LAYOUTLINEAR)
+        return tile / partscheme;
+
+    rectShape(partscheme, &c, &r);
+    return ((tile / TOPOWIDTH) / r) * (TOPOWIDTH / c) +
+           ((tile % TOPOWIDTH) / c);
+}
+
+/*
+ * Dir::buildParts
+ *     - Fill in the partition vectors using the layout rule.
+ */
+void Dir::buildParts(int partscheme) {
     int i;
 
-    // We need a directory for every block. How many do we need
-    // for a 32 bit address space and 64 byte blocks?
-    //
-    //      2^32 bytes * (1 block / 2^6 bytes) = 2^26 blocks
-    //
-    // Therefore we need 2^26 directory entries. What we will
-    // do now is just allocoate the pointers for that many 
-    // directories but we won't allocate the directories until
-    // they are accessed.  
-    directory = new DirEntry*[(1 << 26) - 1];
-
-    // Verify each direntry is initialized to NULL
-    for (i=0; i < (1<<26); i++)
-        assert(directory[i] == NULL);
-
-    // Calculate the # of partitions in the system.
-    numparts = NPROCS/partscheme;
-
-    // We need a table of partition vectors.
+    numparts  = (NPROCS + partscheme - 1) / partscheme;
     parttable = new BitVector*[numparts];
+    for (i=0; i < numparts; i++)
+        parttable[i] = new BitVector(0);
+
+    for (i=0; i < NPROCS; i++)
+        parttable[ruleTilePart(partscheme, i)]->setBit(i);
+}
+
+/*
+ * Dir::loadPartFile
+ *     - Read the partitions from a partition map file. Each line
+ *       lists the tiles of one partition as tile ids or ranges
+ *       of tile ids separated by spaces or commas, e.g.
+ *
+ *           # An L shaped partition and what is left over
+ *           0-3 4 8 12
+ *           5-7, 9-11, 13-15
+ *
+ *       Everything after a # is ignored, as are blank lines. Every
+ *       tile has to be in exactly one partition.
+ */
+void Dir::loadPartFile(char *fname) {
+    FILE *f;
+    char line[4096];
+    char *tok, *hash;
+    int lo, hi, t, i, n;
+    int *owner;
+
+    if ((f = fopen(fname, "r")) == NULL) {
+        printf("Can't open partition map %s\n", fname);
+        exit(1);
+    }
 
+    owner = new int[NPROCS];
+    for (i=0; i < NPROCS; i++)
+        owner[i] = -1;
 
-    // Based on the partition scheme file in the appropriate
-    // vectors with information.
-    switch (partscheme) {
+    // There can't be more partitions than tiles
+    parttable = new BitVector*[NPROCS];
+    numparts  = 0;
 
-        case 1:
-            for (i=0; i < numparts; i++)
-                parttable[i] = new BitVector(0b1 << i);
-            break;
+    for (n=1; fgets(line, sizeof(line), f); n++) {
 
-        case 2:
-            for (i=0; i < numparts; i++)
-                parttable[i] = new BitVector(0b11 << 2*i);
-            break;
-                                      //   111111 
-        case 4:                       //   5432109876543210
-            parttable[0] = new BitVector(0b0000000000110011);
-            parttable[1] = new BitVector(0b0000000011001100);
-            parttable[2] = new BitVector(0b0011001100000000);
-            parttable[3] = new BitVector(0b1100110000000000);
-            break;
-                                      //   111111 
-        case 8:                       //   5432109876543210
-            parttable[0] = new BitVector(0b1111111100000000);
-            parttable[1] = new BitVector(0b0000000011111111);
-            break;
+        if ((hash = strchr(line, '#')))
+            *hash = '\0';
 
-                                      //   111111 
-        case 16:                      //   5432109876543210
-            parttable[0] = new BitVector(0b1111111111111111);
-            break;
+        tok = strtok(line, " ,\t\r\n");
+        if (tok == NULL)
+            continue;
+
+        if (numparts == NPROCS) {
+            printf("%s:%d: more partitions than tiles\n", fname, n);
+            exit(1);
+        }
+        parttable[numparts] = new BitVector(0);
+
+        for (; tok; tok = strtok(NULL, " ,\t\r\n")) {
+            i = sscanf(tok, "%d-%d", &lo, &hi);
+            if (i == 1)
+                hi = lo;
+            if (i < 1 || lo < 0 || hi < lo || hi >= NPROCS) {
+                printf("%s:%d: bad tile %s\n", fname, n, tok);
+                exit(1);
+            }
+            for (t=lo; t <= hi; t++) {
+                if (owner[t] != -1) {
+                    printf("%s:%d: tile %d is already in partition %d\n",
+                           fname, n, t, owner[t]);
+                    exit(1);
+                }
+                owner[t] = numparts;
+                parttable[numparts]->setBit(t);
+            }
+        }
+        numparts++;
+    }
+    fclose(f);
 
-        default:
-            assert(0); // Should not get here
+    for (i=0; i < NPROCS; i++) {
+        if (owner[i] == -1) {
+            printf("%s: tile %d is not in any partition\n", fname, i);
+            exit(1);
+        }
+    }
+    delete [] owner;
+}
+
+/*
+ * Dir::buildPartLookup
+ *     - Build the tables that map a tile to its partition and a
+ *       partition to its tiles so neither has to scan bitvectors
+ *       on every access. The tiles of a partition are kept in
+ *       increasing order, same as the bit order of the vectors.
+ */
+void Dir::buildPartLookup() {
+    int i, t, n;
+
+    tilepart  = new int[NPROCS];
+    partsize  = new int[numparts];
+    parttiles = new int*[numparts];
+
+    for (i=0; i < numparts; i++) {
+        partsize[i]  = parttable[i]->getNumSetBits();
+        parttiles[i] = new int[partsize[i]];
+        for (t=0, n=0; t < NPROCS; t++) {
+            if (parttable[i]->getBit(t)) {
+                parttiles[i][n++] = t;
+                tilepart[t] = i;
+            }
+        }
     }
 }
 
@@ -115,37 +372,319 @@ Dir::Dir(int partscheme) {
  *       to a specific tile within the partition. 
  */
 int Dir::mapAddrToTile(int partid, int addr) {
+    return NUCA->home(addr, partid, partsize[partid], parttiles[partid]);
+}
+
+/*
+ * Dir::mapTileToPart
+ *     - Given a tile index find the partition it belongs to
+ */
+int Dir::mapTileToPart(int tileid) {
+    return tilepart[tileid];
+}
 
-    // Get the vector representing the partition
-    BitVector *bv = parttable[partid];
+/*
+ * Dir::freeParts
+ *     - Free the partition vectors and lookup tables.
+ */
+void Dir::freeParts() {
+    int i;
+    for (i=0; i < numparts; i++) {
+        delete parttable[i];
+        delete [] parttiles[i];
+    }
+    delete [] parttable;
+    delete [] parttiles;
+    delete [] partsize;
+    delete [] tilepart;
+}
 
-    // Get the number of tiles within the partition
-    int numtiles = bv->getNumSetBits();
+/*
+ * Dir::repartition
+ *     - Switch to partitions of partscheme tiles using the layout
+ *       rule. The caches must have been flushed first since the
+ *       sharer vectors of the directory entries are in terms of
+ *       the old partitions.
+ */
+void Dir::repartition(int partscheme) {
+    assert(PARTLAYOUT != LAYOUTFILE && validScheme(partscheme));
+    freeParts();
+    buildParts(partscheme);
+    buildPartLookup();
+    clearAll();
+}
 
-    // Since the tiles logically share L2 the blocks are 
-    // interleaved among the tiles. Find the tile offset
-    // within the partition.
-    int tileoffset = ADDRHASH(addr) % numtiles; 
+/*
+ * Dir::clearAll
+ *     - Forget every block. Used after all of the caches have been
+ *       flushed so that no sharer vector still refers to a partition
+ *       number from an old layout.
+ */
+void Dir::clearAll() {
+    ulong i;
+    RegionEntry *re;
 
-    // Find the actual tile id of the tile. Note: add
-    // 1 because even if offset is 0 we want to find 1st
-    // set bit. 
-    int tileid = bv->getNthSetBit(tileoffset + 1);
+    for (i=0; i < (1UL << dirbits); i++) {
+        while (directory[i])
+            freeEntry(directory[i]->blockaddr);
+    }
 
-    return tileid;
+    // The region owners are old partition numbers too
+    if (regions) {
+        for (i=0; i < (1UL << regbits); i++) {
+            while ((re = regions[i])) {
+                regions[i] = re->next;
+                delete re;
+            }
+        }
+        regionentries = 0;
+    }
 }
 
 /*
- * Dir::mapTileToPart
- *     - Given a tile index find the partition it belongs to
+ * Dir::findEntry
+ *     - The entry for blockaddr (NULL if it has none).
  */
-int Dir::mapTileToPart(int tileid) {
-    int i;
-    for (i=0; i < numparts; i++)
-        if (parttable[i]->getBit(tileid))
-            return i;
+DirEntry *Dir::findEntry(ulong blockaddr) {
+    DirEntry *de = directory[DIRHASH(blockaddr, dirbits)];
+    while (de && de->blockaddr != blockaddr)
+        de = de->next;
+    return de;
+}
 
-    assert(0); // Should not get here
+/*
+ * Dir::findRegion
+ *     - Coarse directory: the entry for region (NULL if nobody has
+ *       touched it).
+ */
+RegionEntry *Dir::findRegion(ulong region) {
+    RegionEntry *re = regions[DIRHASH(region, regbits)];
+    while (re && re->region != region)
+        re = re->next;
+    return re;
+}
+
+/*
+ * Dir::growDirectory
+ *     - Double the buckets of the entry hash table and move the
+ *       entries over.
+ */
+void Dir::growDirectory() {
+    ulong i, h;
+    DirEntry **old = directory;
+    DirEntry *de;
+
+    directory = new DirEntry*[1UL << (dirbits + 1)]();
+    for (i=0; i < (1UL << dirbits); i++) {
+        while ((de = old[i])) {
+            old[i]  = de->next;
+            h       = DIRHASH(de->blockaddr, dirbits + 1);
+            de->next     = directory[h];
+            directory[h] = de;
+        }
+    }
+    dirbits++;
+    delete [] old;
+}
+
+/*
+ * Dir::growRegions
+ *     - Coarse directory: double the buckets of the region hash
+ *       table and move the regions over.
+ */
+void Dir::growRegions() {
+    ulong i, h;
+    RegionEntry **old = regions;
+    RegionEntry *re;
+
+    regions = new RegionEntry*[1UL << (regbits + 1)]();
+    for (i=0; i < (1UL << regbits); i++) {
+        while ((re = old[i])) {
+            old[i]     = re->next;
+            h          = DIRHASH(re->region, regbits + 1);
+            re->next   = regions[h];
+            regions[h] = re;
+        }
+    }
+    regbits++;
+    delete [] old;
+}
+
+/*
+ * Dir::countBytes
+ *     - Keep track of the most memory the entries and the hash
+ *       tables that find them have taken.
+ */
+void Dir::countBytes() {
+    ulong bytes;
+
+    bytes = blockentries  * (sizeof(DirEntry) + sizeof(BitVector)) +
+            regionentries * sizeof(RegionEntry) +
+            (1UL << dirbits) * sizeof(DirEntry *);
+    if (regions)
+        bytes += (1UL << regbits) * sizeof(RegionEntry *);
+    maxdirbytes = MAX(maxdirbytes, bytes);
+}
+
+/*
+ * Dir::clearEntry
+ *     - Forget everything about the block containing addr (it is
+ *       no longer cached anywhere).
+ */
+void Dir::clearEntry(ulong addr) {
+    ulong blockaddr = BLKADDR(addr);
+    if (findEntry(blockaddr))
+        freeEntry(blockaddr);
+}
+
+/*
+ * Dir::newEntry
+ *     - Allocate the entry for blockaddr and keep track of how much
+ *       memory the directory is using.
+ */
+DirEntry *Dir::newEntry(ulong blockaddr) {
+    ulong h;
+    DirEntry *de = new DirEntry(blockaddr);
+    assert(de);
+
+    if (blockentries >= (1UL << dirbits))
+        growDirectory();
+    h            = DIRHASH(blockaddr, dirbits);
+    de->next     = directory[h];
+    directory[h] = de;
+
+    blockentries++;
+    statecount[DSTATEI - DSTATEEM]++;
+    maxblockentries = MAX(maxblockentries, blockentries);
+    countBytes();
+
+    return de;
+}
+
+/*
+ * Dir::freeEntry
+ *     - Free the entry for blockaddr. The pointer is cleared too so
+ *       the next access starts with a fresh entry.
+ */
+void Dir::freeEntry(ulong blockaddr) {
+    DirEntry **p = &directory[DIRHASH(blockaddr, dirbits)];
+    DirEntry *de;
+
+    while ((*p)->blockaddr != blockaddr)
+        p = &(*p)->next;
+    de = *p;
+    *p = de->next;
+
+    statecount[de->state - DSTATEEM]--;
+    delete de;
+    blockentries--;
+}
+
+/*
+ * Dir::exactBlock
+ *     - Coarse directory: look up the region of addr for a message
+ *       from fromtile. A region nobody has touched becomes private
+ *       to fromtile's partition. The first touch from another
+ *       partition makes it shared for good. From then on each block
+ *       gets an exact entry the first time it is used. Until then
+ *       only the owner could have used it, so the home tile of the
+ *       owner is asked whether it still has the block (the request
+ *       waits for the round trip).
+ *
+ * Returns 1 if the block has an exact entry, 0 if the region is
+ * private to fromtile's partition.
+ */
+int Dir::exactBlock(ulong addr, ulong fromtile) {
+
+    ulong blockaddr = BLKADDR(addr);
+    ulong bit       = 1UL << (blockaddr & ((1UL << (regionbits - OFFSETBITS)) - 1));
+    int   partid    = mapTileToPart(fromtile);
+    ulong region    = addr >> regionbits;
+    RegionEntry *re = findRegion(region);
+    DirEntry    *de;
+    ulong h, held, tileid;
+    ulong origDelay = CURRENTDELAY;
+
+    if (re == NULL) {
+        if (regionentries >= (1UL << regbits))
+            growRegions();
+        re = new RegionEntry(region, partid);
+        h  = DIRHASH(region, regbits);
+        re->next   = regions[h];
+        regions[h] = re;
+        regionentries++;
+        countBytes();
+        return 0;
+    }
+
+    if (!re->shared && re->owner == partid)
+        return 0;
+
+    if (!re->shared) {
+        re->shared = 1;
+        regionshares++;
+    }
+
+    if (!(re->exact & bit)) {
+        re->exact |= bit;
+        assert(findEntry(blockaddr) == NULL);
+        de = newEntry(blockaddr);
+
+        tileid = mapAddrToTile(re->owner, addr);
+        held   = NETWORK->sendReqDirToTile(PROBE, addr, tileid);
+        NETWORK->fakeReqTileToDir(addr, tileid);
+        probes++;
+        probecycles += CURRENTDELAY - origDelay;
+
+        // The owner got the block in EM. If its L2 slice let it go
+        // the L1s may still have clean copies (unless the hierarchy
+        // is inclusive), so then it stays a sharer.
+        if (held == 1) {
+            probeheld++;
+            de->sharers->setBit(re->owner);
+            changeState(de, DSTATEEM);
+        } else if (HIERARCHY != HIERINCL) {
+            de->sharers->setBit(re->owner);
+            changeState(de, DSTATES);
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Dir::regionAccess
+ *     - Coarse directory: handle a message for a block of a region
+ *       that is private to the sender's partition. Nobody else can
+ *       have the block so reads get it from memory in EM and
+ *       upgrades and eviction notices need nothing but the lookup.
+ *
+ * Returns the directory state to the caller (always EM)
+ */
+ulong Dir::regionAccess(ulong msg, ulong addr, ulong fromtile) {
+
+    regionlookups++;
+
+    // Pay for the lookup (there is no block to be busy)
+    if (dirbusy)
+        dirArrive(NULL, addr);
+
+    switch (msg) {
+        case RD:
+        case RDX:
+            replyData(addr, -1, fromtile);
+            break;
+        case UPGR:
+            NETWORK->fakeReqDirToTile(addr, fromtile);
+            break;
+        case PUTS:
+        case PUTM:
+            break;
+        default :
+            assert(0); // should not get here
+    }
+
+    return DSTATEEM;
 }
 
 /*
@@ -153,18 +692,24 @@ int Dir::mapTileToPart(int tileid) {
  *     - Given a block address use the partitions vectors to determine
  *       what partitions share the block and send invalidations to all
  *       of them. Skip the pid partition.
+ *
+ * Returns 1 if one of them had the block dirty, 0 if not.
  */
 int Dir::invalidateSharers(int addr, int pid) {
-    int max = 0;
+    ulong max = 0;
+    int dirty = 0;
+
+    PROF->calls[PROFINVSHARERS]++;
 
     // Lets play a game with CURRENTDELAY. Since this stuff is
     // done in parallel we will save off the original value and
-    // then find the max delay of all parallel requests. 
+    // then find the max delay of all parallel requests. Each
+    // request starts from the original value so that the network
+    // sees them all leave at the same time.
     ulong origDelay = CURRENTDELAY;
-    CURRENTDELAY  = 0;
 
     // Get the bitvector of sharers.
-    DirEntry  *de = directory[BLKADDR(addr)];
+    DirEntry  *de = findEntry(BLKADDR(addr));
     BitVector *bv = de->sharers;
 
     //printf("Sharers are %x\n", bv->vector);
@@ -184,18 +729,20 @@ int Dir::invalidateSharers(int addr, int pid) {
             // Get the actual tileid of the tile within the
             // partition that is responsible for addr
             tileid = mapAddrToTile(partid, addr);
-            NETWORK->sendReqDirToTile(INV, addr, tileid);
+            CURRENTDELAY = origDelay;
+            if (NETWORK->sendReqDirToTile(INV, addr, tileid) == 1)
+                dirty = 1;
             bv->clearBit(partid);
 
-            // Update max and reset
-            max = MAX(max, CURRENTDELAY);
-            CURRENTDELAY = 0; // Reset for next iter
+            // Update max
+            max = MAX(max, CURRENTDELAY - origDelay);
         }
     }
 
     // Add the max to the original delay
     CURRENTDELAY = origDelay + max;
 
+    return dirty;
 }
 
 /*
@@ -212,10 +759,10 @@ int Dir::findClosestSharer(int addr, int tile) {
     int distance, tileid, partid;
 
     // Get the partition that the tile belongs to
-    ulong pid = mapTileToPart(tile); 
+    int pid = mapTileToPart(tile);
 
     // Get the bitvector of sharers.
-    DirEntry  *de = directory[BLKADDR(addr)];
+    DirEntry  *de = findEntry(BLKADDR(addr));
     BitVector *bv = de->sharers;
 
     // Iterate over sharers 
@@ -249,14 +796,17 @@ int Dir::findClosestSharer(int addr, int tile) {
  *       to find the partition that owns the block. Map the addr
  *       and partid to a specific tile and then send an intervention
  *       to the tile.
+ *
+ * Returns 1 if the owner had the block dirty, 0 if not.
  */
 int Dir::interveneOwner(int addr) {
     // Get the bitvector of sharers.
-    DirEntry  *de = directory[BLKADDR(addr)];
+    DirEntry  *de = findEntry(BLKADDR(addr));
     BitVector *bv = de->sharers;
 
     int tileid;
     int partid;
+    int dirty = 0;
 
     // Iterate over sharers and send INT to any that
     // exist.
@@ -265,9 +815,112 @@ int Dir::interveneOwner(int addr) {
             // Get the actual tileid of the tile within the
             // partition that is responsible for addr
             tileid = mapAddrToTile(partid, addr);
-            NETWORK->sendReqDirToTile(INT, addr, tileid);
+            if (NETWORK->sendReqDirToTile(INT, addr, tileid) == 1)
+                dirty = 1;
         }
     }
+
+    return dirty;
+}
+
+/*
+ * Dir::dataSource
+ *     - Pick the tile that should supply the block containing addr
+ *       to tile. Under MESIF a shared block only comes from its
+ *       forwarder; otherwise the closest sharer answers.
+ *
+ * Returns the tile or -1 if the data has to come from memory.
+ */
+int Dir::dataSource(int addr, int tile) {
+
+    DirEntry *de = findEntry(BLKADDR(addr));
+
+    if (PROTOCOL == PROTOMESIF && de->state == DSTATES) {
+        if (de->owner < 0 || de->owner == mapTileToPart(tile))
+            return -1;
+        return mapAddrToTile(de->owner, addr);
+    }
+
+    return findClosestSharer(addr, tile);
+}
+
+/*
+ * Dir::spillable
+ *     - Cooperative spilling: is partid the only partition with the
+ *       block containing addr (so spilling it keeps the only copy on
+ *       the chip)? A block of a private region has no entry but only
+ *       its owner can have it.
+ */
+int Dir::spillable(ulong addr, int partid) {
+
+    DirEntry *de = findEntry(BLKADDR(addr));
+
+    if (de == NULL)
+        return (regions != NULL);
+
+    return (de->sharers->getNumSetBits() == 1 && de->sharers->getBit(partid));
+}
+
+/*
+ * Dir::spillMove
+ *     - Cooperative spilling: the block containing addr has moved
+ *       from partition frompart's L2 to the home tile totile of
+ *       partition topart. The new holder takes over the old one's
+ *       place (and ownership) and the move is remembered so the
+ *       spiller can get the block back.
+ */
+void Dir::spillMove(ulong addr, int frompart, int topart, int totile) {
+
+    DirEntry *de;
+
+    // A block of a private region needs an entry of its own now
+    if (regions && findEntry(BLKADDR(addr)) == NULL)
+        exactBlock(addr, totile);
+
+    de = findEntry(BLKADDR(addr));
+    assert(de && de->sharers->getBit(frompart));
+
+    de->sharers->clearBit(frompart);
+    de->sharers->setBit(topart);
+    if (de->owner == frompart)
+        de->owner = topart;
+
+    de->spiller = frompart;
+    de->spillto = topart;
+}
+
+/*
+ * Dir::spillLost
+ *     - Cooperative spilling: partition partid evicted a block that
+ *       was spilled to it, so the spiller can't get it back anymore.
+ */
+void Dir::spillLost(ulong addr, int partid) {
+
+    DirEntry *de = findEntry(BLKADDR(addr));
+
+    if (de == NULL || de->spillto != partid)
+        return;
+
+    de->spiller = de->spillto = -1;
+    spilllost++;
+}
+
+/*
+ * Dir::spillSource
+ *     - Cooperative spilling: if tile's partition spilled the block
+ *       containing addr, the tile it went to.
+ *
+ * Returns the tile or -1 if the block wasn't spilled by tile's
+ * partition.
+ */
+int Dir::spillSource(int addr, int tile) {
+
+    DirEntry *de = findEntry(BLKADDR(addr));
+
+    if (de == NULL || de->spiller < 0 || de->spiller != mapTileToPart(tile))
+        return -1;
+
+    return mapAddrToTile(de->spillto, addr);
 }
 
 /*
@@ -277,26 +930,307 @@ int Dir::interveneOwner(int addr) {
 void Dir::replyData(int addr, int fromtile, int totile) {
 
     // Is forwarding data requests to other partitions allowed? 
-    // If not then just set fromtile to -1
+    // If not then just set fromtile to -1. A block the requester's
+    // partition spilled comes back from where it went either way.
     if (PARTSHARING == 0)
-        fromtile = -1;
+        fromtile = spillSource(addr, totile);
 
     // If fromtile == -1 then there is no sharer
     if (fromtile == -1) {
 
         // Had to access memory so add in the delay
-        CURRENTMEMDELAY += MEMATIME;
+        CURRENTMEMDELAY += memAccess(addr, 0);
         // Reply Data
         NETWORK->fakeDataDirToTile(addr, totile);
+        memreads++;
 
     } else {
 
-        // Accessed the L2 $ of sending tile
-        CURRENTDELAY += L2ATIME;
-        // Reply Data - simulate sending from closesttile;
-        NETWORK->fakeReqDirToTile(addr, fromtile);     // Fwd req to fromtile
-        NETWORK->fakeDataTileToTile(fromtile, totile); // Data fromtile totile
+        forwardData(addr, fromtile, totile);
+        c2cxfers++;
+
+    }
+}
+
+/*
+ * Dir::forwardData
+ *     - Have fromtile send the block to totile. Used directly
+ *       (whether or not partitions may share) when fromtile has the
+ *       only up to date copy.
+ */
+void Dir::forwardData(int addr, int fromtile, int totile) {
+
+    // Accessed the L2 $ of sending tile
+    CURRENTDELAY += L2ATIME;
+    // Reply Data - simulate sending from closesttile;
+    NETWORK->fakeReqDirToTile(addr, fromtile);     // Fwd req to fromtile
+    NETWORK->fakeDataTileToTile(fromtile, totile); // Data fromtile totile
+}
+
+/*
+ * Dir::recordLatency
+ *     - Count a request of type msg that took cycles from leaving
+ *       the tile to getting its reply.
+ */
+void Dir::recordLatency(ulong msg, ulong cycles) {
+    reqs[msg - RD]++;
+    reqcycles[msg - RD] += cycles;
+}
+
+/*
+ * Dir::trackColdMisses
+ *     - Start counting the memory reads of blocks that have never
+ *       been read before (compulsory misses).
+ */
+void Dir::trackColdMisses() {
+    touched = new uchar[NUMBLOCKS / 8];
+    memset(touched, 0, NUMBLOCKS / 8);
+}
+
+/*
+ * Dir::memAccess
+ *     - Read or write the block containing addr from memory. The
+ *       request arrives at the controller now (the hops to get here
+ *       are already in CURRENTDELAY).
+ *
+ * Returns the memory access time.
+ */
+ulong Dir::memAccess(ulong addr, int write) {
+
+    ulong blockaddr = BLKADDR(addr);
 
+    // Is this the first time anybody needed the block?
+    if (touched && !write && !(touched[blockaddr >> 3] & (1 << (blockaddr & 7)))) {
+        touched[blockaddr >> 3] |= (1 << (blockaddr & 7));
+        coldmisses++;
+    }
+
+    if (mem == NULL)
+        return MEMATIME;
+
+    return mem->access(addr, CURRENTCYCLE + CURRENTDELAY + CURRENTMEMDELAY, write);
+}
+
+/*
+ * Dir::mapAddrToCtrl
+ *     - Find the memory controller (and directory) responsible
+ *       for addr.
+ */
+ulong Dir::mapAddrToCtrl(ulong addr) {
+    return MemCtrl::mapAddrToCtrl(addr);
+}
+
+/*
+ * Dir::dirArrive
+ *     - Timed directory: a request for the block of de has arrived
+ *       at its directory. If another request is still in the middle
+ *       of the block (e.g. waiting on invalidations) then wait for it
+ *       to finish. Then wait for the directory controller to be free
+ *       and pay for the lookup. de is NULL for a lookup that only
+ *       needed a coarse region entry.
+ */
+void Dir::dirArrive(DirEntry *de, ulong addr) {
+
+    ulong ctrl = mapAddrToCtrl(addr);
+    ulong now  = CURRENTCYCLE + CURRENTDELAY + CURRENTMEMDELAY;
+    ulong wait = 0;
+    ulong q;
+
+    dirreqs[ctrl]++;
+
+    // Block is busy. Queue up behind the request that has it.
+    if (de && now >= de->busystart && now < de->busyuntil) {
+        wait = de->busyuntil - now;
+        de->qdepth++;
+        de->waitcycles += wait;
+        blockwaits[ctrl]++;
+        waitcycles[ctrl] += wait;
+        qdepthsum[ctrl]  += de->qdepth;
+        maxqdepth[ctrl]   = MAX(maxqdepth[ctrl], de->qdepth);
+    } else if (de) {
+        de->qdepth = 0;
+    }
+
+    // Wait for the directory controller and do the lookup
+    q = dirbusy->reserve(ctrl, now + wait, DIRATIME);
+    dirqcycles[ctrl] += q;
+    CURRENTDELAY += wait + q + DIRATIME;
+
+    // The block is ours from here until dirDepart()
+    if (de) {
+        de->busystart = now + wait + q;
+        de->busyuntil = de->busystart;
+    }
+}
+
+/*
+ * Dir::dirDepart
+ *     - Timed directory: the request that owns the block of de is
+ *       done. Everything it did (invalidations, interventions,
+ *       memory) kept the block busy.
+ */
+void Dir::dirDepart(DirEntry *de) {
+    de->busyuntil = CURRENTCYCLE + CURRENTDELAY + CURRENTMEMDELAY;
+}
+
+/*
+ * Dir::PrintStats
+ *     - Print stats for the directory and the memory controllers.
+ */
+void Dir::PrintStats(int tabular) {
+    if (dirbusy)
+        PrintDirStats(tabular);
+    if (mem)
+        mem->PrintStats(tabular);
+    if (PROTOCOL != PROTOMESI)
+        PrintProtocolStats(tabular);
+    if (regions)
+        PrintStorageStats(tabular);
+}
+
+/*
+ * Dir::PrintStorageStats
+ *     - Print how many lookups needed a block entry and how many a
+ *       coarse region answered, the most memory the entries took,
+ *       and what the probes of newly shared regions cost.
+ */
+void Dir::PrintStorageStats(int tabular) {
+
+    char grain[16];
+
+    sprintf(grain, "%luB", DIRREGION);
+
+    if (tabular) {
+        printf("%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s\n",
+               "dirgrain", "blocklookups", "regionlookups",
+               "maxblkentries", "regionentries", "maxdirkbytes",
+               "regionshares", "probes", "probeheld", "probecycles");
+        printf("%15s%15lu%15lu%15lu%15lu%15lu%15lu%15lu%15lu%15lu\n",
+               grain, blocklookups, regionlookups, maxblockentries,
+               regionentries, maxdirbytes / ONEKBYTE, regionshares,
+               probes, probeheld, probecycles);
+    } else {
+        printf("===== Directory storage (%s) ======================\n", grain);
+        printf("Lookups: %lu block entries, %lu private regions\n",
+               blocklookups, regionlookups);
+        printf("Entries: at most %lu blocks, %lu regions, %lu KiB\n",
+               maxblockentries, regionentries, maxdirbytes / ONEKBYTE);
+        printf("Regions shared %lu, owner probes %lu (%lu still had "
+               "the block, %lu cycles waited)\n",
+               regionshares, probes, probeheld, probecycles);
+    }
+}
+
+/*
+ * Dir::PrintProtocolStats
+ *     - Print the latency of each kind of coherence request and
+ *       where the data replies came from and the dirty blocks
+ *       went, so the protocols can be compared.
+ */
+void Dir::PrintProtocolStats(int tabular) {
+
+    int i;
+    float avg[3];
+    const char *name = (PROTOCOL == PROTOMOESI) ? "MOESI" :
+                       (PROTOCOL == PROTOMESIF) ? "MESIF" : "MESI";
+
+    for (i=0; i < 3; i++)
+        avg[i] = reqs[i] ? ((float)reqcycles[i] / (float)reqs[i]) : 0.0;
+
+    if (tabular) {
+        printf("%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s\n",
+               "protocol", "rdreqs", "avgrdlat", "rdxreqs", "avgrdxlat",
+               "upgrreqs", "avgupgrlat", "memreads", "memflushes",
+               "memwbacks", "c2cxfers", "ownerxfers");
+        printf("%15s%15lu%15f%15lu%15f%15lu%15f%15lu%15lu%15lu%15lu%15lu\n",
+               name, reqs[0], avg[0], reqs[1], avg[1], reqs[2], avg[2],
+               memreads, memflushes, memwbacks, c2cxfers, ownerxfers);
+    } else {
+        printf("===== Coherence protocol (%s) =====================\n", name);
+        printf("RD requests:   %lu, avg latency %f\n", reqs[0], avg[0]);
+        printf("RDX requests:  %lu, avg latency %f\n", reqs[1], avg[1]);
+        printf("UPGR requests: %lu, avg latency %f\n", reqs[2], avg[2]);
+        printf("Data from memory %lu, from other partitions %lu, "
+               "from dirty owners %lu\n", memreads, c2cxfers, ownerxfers);
+        printf("Dirty blocks flushed to memory %lu, written back on "
+               "eviction %lu\n", memflushes, memwbacks);
+    }
+}
+
+/*
+ * Dir::PrintDirStats
+ *     - Print per controller directory occupancy and block
+ *       serialization stats followed by the blocks that requests
+ *       spent the most time waiting on.
+ */
+void Dir::PrintDirStats(int tabular) {
+
+    ulong i, j, k;
+    ulong hot[DIRHOTBLOCKS];
+    ulong hotwait[DIRHOTBLOCKS];
+    DirEntry *de;
+
+    if (tabular)
+        printf("%15s%15s%15s%15s%15s%15s%15s\n",
+               "dirctrl", "requests", "avgdirqdelay", "blockwaits",
+               "avgblockwait", "avgqdepth", "maxqdepth");
+    else
+        printf("===== Directory (timed model) =====================\n");
+
+    for (i=0; i < NUMMEMCTRLS; i++) {
+        if (tabular) {
+            printf("%15lu%15lu%15f%15lu%15f%15f%15lu\n",
+                   i, dirreqs[i],
+                   dirreqs[i] ? ((float)dirqcycles[i] / (float)dirreqs[i]) : 0.0,
+                   blockwaits[i],
+                   blockwaits[i] ? ((float)waitcycles[i] / (float)blockwaits[i]) : 0.0,
+                   blockwaits[i] ? ((float)qdepthsum[i] / (float)blockwaits[i]) : 0.0,
+                   maxqdepth[i]);
+        } else {
+            printf("Directory %lu: requests %lu, avg controller wait %f, "
+                   "busy block waits %lu, avg block wait %f, "
+                   "avg queue depth %f, max queue depth %lu\n",
+                   i, dirreqs[i],
+                   dirreqs[i] ? ((float)dirqcycles[i] / (float)dirreqs[i]) : 0.0,
+                   blockwaits[i],
+                   blockwaits[i] ? ((float)waitcycles[i] / (float)blockwaits[i]) : 0.0,
+                   blockwaits[i] ? ((float)qdepthsum[i] / (float)blockwaits[i]) : 0.0,
+                   maxqdepth[i]);
+        }
+    }
+
+    // Find the hottest blocks (insertion into a small sorted list)
+    memset(hot,     0, sizeof(hot));
+    memset(hotwait, 0, sizeof(hotwait));
+    // (ties go to the lower block so the list doesn't depend on the
+    // order of the hash table)
+#define HOTTER(de, n) ((de)->waitcycles > hotwait[n] || \
+        (hotwait[n] && (de)->waitcycles == hotwait[n] && (de)->blockaddr < hot[n]))
+    for (i=0; i < (1UL << dirbits); i++) {
+        for (de = directory[i]; de; de = de->next) {
+            if (!HOTTER(de, DIRHOTBLOCKS-1))
+                continue;
+            for (j=0; j < DIRHOTBLOCKS; j++)
+                if (HOTTER(de, j))
+                    break;
+            for (k=DIRHOTBLOCKS-1; k > j; k--) {
+                hot[k]     = hot[k-1];
+                hotwait[k] = hotwait[k-1];
+            }
+            hot[j]     = de->blockaddr;
+            hotwait[j] = de->waitcycles;
+        }
+    }
+#undef HOTTER
+
+    if (tabular)
+        printf("%15s%15s\n", "hotblock", "waitcycles");
+    for (j=0; j < DIRHOTBLOCKS && hotwait[j]; j++) {
+        if (tabular)
+            printf("%15lx%15lu\n", hot[j] << OFFSETBITS, hotwait[j]);
+        else
+            printf("Hot block %08lx: %lu cycles waited\n",
+                   hot[j] << OFFSETBITS, hotwait[j]);
     }
 }
 
@@ -308,15 +1242,28 @@ void Dir::replyData(int addr, int fromtile, int totile) {
  */
 void Dir::setState(ulong addr, int s) {
 
-    DirEntry * de = directory[BLKADDR(addr)];
+    DirEntry * de = findEntry(BLKADDR(addr));
     assert(de); // verify de is not NULL
 
-    de->state = s; // Set the new state
+    changeState(de, s); // Set the new state
 
     // If we are going to the invalid state then delete the
-    // memory associated with the directory entry.
+    // memory associated with the directory entry. The pointer is
+    // cleared too so the next access starts with a fresh entry and
+    // clearAll() never frees it a second time.
     if (s == DSTATEI)
-        delete de;
+        freeEntry(BLKADDR(addr));
+}
+
+/*
+ * Dir::changeState
+ *     - Put the entry de in state s, keeping the count of entries
+ *       in each state up to date.
+ */
+void Dir::changeState(DirEntry *de, int s) {
+    statecount[de->state - DSTATEEM]--;
+    statecount[s - DSTATEEM]++;
+    de->state = s;
 }
 
 /*
@@ -330,13 +1277,49 @@ ulong Dir::getFromNetwork(ulong msg, ulong addr, ulong fromtile) {
 
     // Get the blockaddr
     ulong blockaddr = BLKADDR(addr);
+    DirEntry *de;
+    ulong reads;
+    int spilled;
+
+    // A block of a region only one partition uses has no entry
+    if (regions && !exactBlock(addr, fromtile))
+        return regionAccess(msg, addr, fromtile);
+
+    blocklookups++;
+
+    // An eviction notice may leave nothing to track (and free the
+    // entry), so it is handled on its own
+    if (msg == PUTS || msg == PUTM) {
+        if (dirbusy)
+            dirArrive(findEntry(blockaddr), addr);
+        netInitPut(addr, fromtile);
+        if ((de = findEntry(blockaddr)) == NULL)
+            return DSTATEI;
+        if (dirbusy)
+            dirDepart(de);
+        return de->state;
+    }
+
+    if ((de = findEntry(blockaddr)) == NULL)
+        de = newEntry(blockaddr);
+
+    // Pay for the lookup (and wait if the block is busy)
+    if (dirbusy)
+        dirArrive(de, addr);
 
-    if (directory[blockaddr] == NULL)
-        directory[blockaddr] = new DirEntry(blockaddr);
+    // Is the requester's partition after a block it spilled?
+    spilled = (de->spiller >= 0 && de->spiller == mapTileToPart(fromtile));
+    reads   = memreads;
 
     switch (msg) {
         case RD: 
-            netInitRd(addr, fromtile);
+            // The neighbour only kept a spilled block for the spiller,
+            // so the spiller takes it back exclusive (as if it had
+            // never left) rather than shared with the neighbour
+            if (spilled)
+                netInitRdX(addr, fromtile);
+            else
+                netInitRd(addr, fromtile);
             break;
         case RDX: 
             netInitRdX(addr, fromtile);
@@ -348,7 +1331,20 @@ ulong Dir::getFromNetwork(ulong msg, ulong addr, ulong fromtile) {
             assert(0); // should not get here
     }
 
-    return directory[blockaddr]->state;
+    // The spiller has the block back (from the neighbour unless it
+    // had to go to memory), or someone else wrote it and the copy
+    // that was spilled is gone
+    if (spilled && memreads == reads)
+        spillreturns++;
+    if (spilled || (msg != RD && de->spiller >= 0))
+        de->spiller = de->spillto = -1;
+
+    // The block stays busy until everything above is done
+    de = findEntry(blockaddr);
+    if (dirbusy)
+        dirDepart(de);
+
+    return de->state;
 }
 
 /*
@@ -358,23 +1354,37 @@ ulong Dir::getFromNetwork(ulong msg, ulong addr, ulong fromtile) {
  */
 void Dir::netInitRdX(ulong addr, ulong fromtile) {
     int closesttile;
+    int dirty;
 
-    DirEntry * de = directory[BLKADDR(addr)];
+    DirEntry * de = findEntry(BLKADDR(addr));
 
     // Get the partition that the tile belongs to
     ulong partid = mapTileToPart(fromtile); 
 
+    // A MOESI owner that is our own partition has evicted the
+    // block (and written it back) so treat the block as shared
+    if (de->state == DSTATEO && de->owner == (int)partid) {
+        de->owner = -1;
+        changeState(de, DSTATES);
+    }
+
     switch (de->state) {
 
         // For EM we need to invalidate the current owner
         // and reply with data to new owner. Will stay in M state.
+        // Under MOESI a dirty owner hands its data straight over.
         case DSTATEEM: 
             // Find the closest sharer
             closesttile = findClosestSharer(addr, fromtile);
             // Invalidate current owner.
-            invalidateSharers(addr, partid);
+            dirty = invalidateSharers(addr, partid);
             // Reply Data
-            replyData(addr, closesttile, fromtile);
+            if (PROTOCOL == PROTOMOESI && dirty && closesttile != -1) {
+                forwardData(addr, closesttile, fromtile);
+                ownerxfers++;
+            } else {
+                replyData(addr, closesttile, fromtile);
+            }
             // Add new owner to bit map.
             de->sharers->setBit(partid);
             break;
@@ -382,8 +1392,8 @@ void Dir::netInitRdX(ulong addr, ulong fromtile) {
         // For S we need to transition to M and invalidate all
         // sharers.
         case DSTATES: 
-            // Find the closest sharer
-            closesttile = findClosestSharer(addr, fromtile);
+            // Find the closest sharer (or the forwarder)
+            closesttile = dataSource(addr, fromtile);
             // Invalidate all sharers
             invalidateSharers(addr, partid);
             // Reply Data
@@ -391,6 +1401,19 @@ void Dir::netInitRdX(ulong addr, ulong fromtile) {
             // Add new owner to bit map.
             de->sharers->setBit(partid);
             // Transition to EM
+            de->owner = -1;
+            setState(addr, DSTATEEM);
+            break;
+
+        // For O (MOESI) the owner sends its dirty data and
+        // everyone is invalidated
+        case DSTATEO:
+            closesttile = mapAddrToTile(de->owner, addr);
+            invalidateSharers(addr, partid);
+            forwardData(addr, closesttile, fromtile);
+            ownerxfers++;
+            de->sharers->setBit(partid);
+            de->owner = -1;
             setState(addr, DSTATEEM);
             break;
 
@@ -418,11 +1441,18 @@ void Dir::netInitRdX(ulong addr, ulong fromtile) {
 void Dir::netInitRd(ulong addr, ulong fromtile) {
     int closesttile;
 
-    DirEntry * de = directory[BLKADDR(addr)];
+    DirEntry * de = findEntry(BLKADDR(addr));
 
     // Get the partition that the tile belongs to
     ulong partid = mapTileToPart(fromtile); 
 
+    // A MOESI owner that is our own partition has evicted the
+    // block (and written it back) so treat the block as shared
+    if (de->state == DSTATEO && de->owner == (int)partid) {
+        de->owner = -1;
+        changeState(de, DSTATES);
+    }
+
     switch (de->state) {
 
         // For EM we need to transistion to shared state 
@@ -430,24 +1460,46 @@ void Dir::netInitRd(ulong addr, ulong fromtile) {
         case DSTATEEM: 
             // Find the closest sharer
             closesttile = findClosestSharer(addr, fromtile);
-            // send intervention
-            interveneOwner(addr);
+            // send intervention. Under MOESI a dirty owner
+            // keeps the block in O and supplies it itself.
+            if (interveneOwner(addr) && PROTOCOL == PROTOMOESI &&
+                closesttile != -1) {
+                forwardData(addr, closesttile, fromtile);
+                ownerxfers++;
+                de->sharers->setBit(partid);
+                de->owner = mapTileToPart(closesttile);
+                setState(addr, DSTATEO);
+                break;
+            }
             // Reply Data
             replyData(addr, closesttile, fromtile);
             // Add new sharer to bit map.
             de->sharers->setBit(partid);
-            // Transition to S
+            // Transition to S. Under MESIF the newest sharer
+            // forwards from now on.
+            if (PROTOCOL == PROTOMESIF)
+                de->owner = partid;
             setState(addr, DSTATES);
             break;
 
         // For S, no need to change state
         case DSTATES: 
-            // Find the closest sharer
-            closesttile = findClosestSharer(addr, fromtile);
+            // Find the closest sharer (or the forwarder)
+            closesttile = dataSource(addr, fromtile);
             // Reply Data
             replyData(addr, closesttile, fromtile);
             // Add new sharer to bit map.
             de->sharers->setBit(partid);
+            if (PROTOCOL == PROTOMESIF)
+                de->owner = partid;
+            break;
+
+        // For O (MOESI) the owner supplies the dirty data and
+        // keeps it
+        case DSTATEO:
+            forwardData(addr, mapAddrToTile(de->owner, addr), fromtile);
+            ownerxfers++;
+            de->sharers->setBit(partid);
             break;
 
         // For I, transition to EM
@@ -472,19 +1524,25 @@ void Dir::netInitRd(ulong addr, ulong fromtile) {
  */
 void Dir::netInitUpgr(ulong addr, ulong fromtile) {
 
-    DirEntry * de = directory[BLKADDR(addr)];
+    DirEntry * de = findEntry(BLKADDR(addr));
     // Get the partition that the tile belongs to
     ulong partid = mapTileToPart(fromtile); 
 
     switch (de->state) {
         // For ME we should never get UPGR since there
-        // should not be more than one copy in the system
+        // should not be more than one copy in the system. The
+        // exception is an exclusive hierarchy where the owner
+        // partition's L2 gave the block to an L1 and got it back
+        // in S. Then there is nobody else to invalidate.
         case DSTATEEM: 
-            assert(0);
+            assert(HIERARCHY == HIEREXCL && de->sharers->getBit(partid));
+            NETWORK->fakeReqDirToTile(addr, fromtile);
             break;
 
-        // For S, transistion to EM
+        // For S (or O), transistion to EM. Under MOESI the
+        // requester already has the dirty owner's data.
         case DSTATES:
+        case DSTATEO:
             // Invalidate all sharers, but first clear
             // the bit related to partid because that one 
             // shouldn't be invalidated.
@@ -493,6 +1551,7 @@ void Dir::netInitUpgr(ulong addr, ulong fromtile) {
             // Reply - no data
             NETWORK->fakeReqDirToTile(addr, fromtile);
             // Transition to EM
+            de->owner = -1;
             setState(addr, DSTATEEM);
             // Add partid back into sharers bit map.
             de->sharers->setBit(partid);
@@ -508,3 +1567,38 @@ void Dir::netInitUpgr(ulong addr, ulong fromtile) {
             assert(0); // should not get here
     }
 }
+
+/*
+ * Dir::netInitPut
+ *     - This function handles the logic for when an eviction notice
+ *       (PUTS or PUTM) is delivered to the directory. The partition
+ *       no longer has the block so it stops being a sharer (and the
+ *       owner or forwarder). Once no partition is left the block
+ *       goes to I.
+ */
+void Dir::netInitPut(ulong addr, ulong fromtile) {
+
+    DirEntry * de = findEntry(BLKADDR(addr));
+    // Get the partition that the tile belongs to
+    int partid = mapTileToPart(fromtile); 
+
+    // Notices are only sent for blocks the partition holds, so the
+    // directory has to be tracking it
+    assert(de && de->sharers->getBit(partid));
+
+    de->sharers->clearBit(partid);
+    if (de->owner == partid)
+        de->owner = -1;
+    if (de->spillto == partid)
+        de->spiller = de->spillto = -1;
+
+    // Nobody has a copy anymore
+    if (de->sharers->getNumSetBits() == 0) {
+        setState(addr, DSTATEI);
+        return;
+    }
+
+    // The dirty owner (MOESI) left but clean sharers remain
+    if (de->state == DSTATEO && de->owner < 0)
+        changeState(de, DSTATES);
+}
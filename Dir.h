@@ -10,12 +10,28 @@
 #include "types.h"
 
 class BitVector; // Forward Declaration
+class MemCtrl;   // Forward Declaration
+class ResTable;  // Forward Declaration
+
+// How the tiles are split into partitions (selected with layout=<layout>)
+enum {
+    LAYOUTRECT = 0, // Near-square rectangles on the tile grid
+    LAYOUTLINEAR,   // Runs of consecutive tile ids (last one may be short)
+    LAYOUTFILE,     // Read from a partition map file
+};
 
 // Directory states
 enum {
     DSTATEEM = 100,
     DSTATES,
     DSTATEI,
+    DSTATEO,    // Shared with one dirty owner (MOESI only)
+};
+
+// Directory timing models (selected with dir=<model>)
+enum {
+    DIRINSTANT = 0, // Requests are handled instantly
+    DIRTIMED,       // Lookup latency, occupancy and busy blocks
 };
 
 class DirEntry {
@@ -26,37 +42,176 @@ class DirEntry {
         ulong location;
         BitVector * sharers;
 
+        // Partition that owns the block in O (MOESI) or forwards it
+        // while it is shared (MESIF). -1 if there is none.
+        int owner;
+
+        // Cooperative spilling: the partition that spilled the block
+        // and the partition it went to. -1 if it wasn't spilled (or
+        // the spiller has it back). Shorts so they fit in the padding
+        // after owner.
+        short spiller;
+        short spillto;
+
+        // Transient state for the timed directory. While a request
+        // is being handled (e.g. waiting on invalidations) the block
+        // is busy from busystart to busyuntil and later requests
+        // to it have to wait.
+        ulong busystart;
+        ulong busyuntil;
+        ulong qdepth;     // Requests queued on the block right now
+        ulong waitcycles; // Total cycles requests waited on the block
+
+        DirEntry * next;  // Next entry in the same hash bucket
+
         DirEntry(ulong blockaddr);
         ~DirEntry();
 };
 
+// A region of the coarse directory (dirregion=<bytes>). While only
+// one partition uses the region none of its blocks have entries of
+// their own; the owner is the sharer superset of all of them. Once
+// another partition touches the region its blocks get exact entries
+// as they are used.
+class RegionEntry {
+
+    public:
+        ulong region;  // Region number (addr >> regionbits)
+        int   owner;   // Partition that had the region to itself
+        int   shared;  // Another partition has touched the region
+        ulong exact;   // Blocks with exact tracking (one bit each)
+        RegionEntry * next; // Next region in the same hash bucket
+
+        RegionEntry(ulong region, int partid);
+};
+
 class Dir {
     private:
 
+        // Entries only exist for blocks that are in use, so they
+        // are kept in a hash table of 2^dirbits chains that doubles
+        // when it holds more entries than buckets
         DirEntry  **directory;
+        ulong dirbits;
+
+        // Coarse directory regions, hashed the same way (NULL if
+        // every block is tracked on its own)
+        RegionEntry **regions;
+        ulong regbits;
+        ulong regionbits;  // log2(DIRREGION)
+
+        // Model of the memory controllers (NULL for the flat
+        // MEMATIME model)
+        MemCtrl * mem;
+
+        // Directory controller occupancy and per controller
+        // counters for the timed directory model
+        ResTable * dirbusy;
+        ulong * dirreqs;
+        ulong * dirqcycles;   // Waiting for the directory controller
+        ulong * blockwaits;   // Requests that found their block busy
+        ulong * waitcycles;   // Cycles waiting on busy blocks
+        ulong * qdepthsum;    // Sum of block queue depth at arrival
+        ulong * maxqdepth;
+
+        // One bit per block that has ever been read from memory
+        // (only kept when asked for with trackColdMisses())
+        uchar * touched;
 
-        // Array of directory entires (1 for each mem block) each containing
-        //  - bitvector representing which parts cache the block
-        //  - M/S/I states
+        DirEntry * findEntry(ulong blockaddr);
+        RegionEntry * findRegion(ulong region);
+        void growDirectory();
+        void growRegions();
+        void countBytes();
+
+        int  rectShape(int partscheme, int *c, int *r);
+        void buildParts(int partscheme);
+        void loadPartFile(char *fname);
+        void buildPartLookup();
+        void freeParts();
 
     public:
         BitVector **parttable; // Table of partitions.
 
         int numparts; // # of partitions in the system
 
+        ulong coldmisses; // Reads of blocks never read from memory before
+
+        // Protocol counters
+        ulong reqs[3];      // RD, RDX and UPGR requests
+        ulong reqcycles[3]; // Cycles from sending them to the reply
+        ulong memreads;     // Data replies that came from memory
+        ulong memflushes;   // Dirty blocks flushed to memory by INV/INT
+        ulong memwbacks;    // Dirty blocks written back on eviction
+        ulong c2cxfers;     // Data replies forwarded by another partition
+        ulong ownerxfers;   // ... by a dirty owner that kept or passed on
+                            //     the dirty data (MOESI)
+
+        // Directory storage and lookup counters
+        ulong blocklookups;  // Requests that used a block entry
+        ulong regionlookups; // Requests a private region answered
+        ulong blockentries;  // Block entries allocated right now
+        ulong maxblockentries;
+        ulong regionentries; // Region entries allocated right now
+        ulong maxdirbytes;   // Most memory the entries (and their hash
+                             // tables) took at once
+        ulong regionshares;  // Regions that became shared
+        ulong probes;        // Region owners asked if they had a block
+        ulong probeheld;     // ... that still had it
+        ulong probecycles;   // Cycles requests waited for the probes
+        ulong statecount[4]; // Block entries in each state right now
+                             // (indexed by state - DSTATEEM)
+
+        // Cooperative spilling counters
+        ulong spillreturns;  // Spilled blocks their partition got back
+                             // from the neighbour instead of memory
+        ulong spilllost;     // Spilled blocks the neighbour evicted
+
+        // Lookup tables built from parttable at startup
+        int *  tilepart;  // [NPROCS] partition of each tile
+        int *  partsize;  // [numparts] tiles in each partition
+        int ** parttiles; // [numparts][partsize] tiles of each partition
+
         Dir(int partscheme);
         ~Dir();
         int mapAddrToTile(int partid, int blockaddr);
         int mapTileToPart(int tileid);
+        int validScheme(int partscheme);
+        int ruleTilePart(int partscheme, int tile);
+        void repartition(int partscheme);
+        void clearEntry(ulong addr);
+        void clearAll();
+        DirEntry *newEntry(ulong blockaddr);
+        void freeEntry(ulong blockaddr);
+        int  exactBlock(ulong addr, ulong fromtile);
+        ulong regionAccess(ulong msg, ulong addr, ulong fromtile);
+        void trackColdMisses();
         int invalidateSharers(int addr, int partid);
         int interveneOwner(int addr);
         int findClosestSharer(int addr, int tile);
+        int dataSource(int addr, int tile);
+        int spillable(ulong addr, int partid);
+        void spillMove(ulong addr, int frompart, int topart, int totile);
+        void spillLost(ulong addr, int partid);
+        int spillSource(int addr, int tile);
         void replyData(int addr, int fromtile, int totile);
+        void forwardData(int addr, int fromtile, int totile);
+        void recordLatency(ulong msg, ulong cycles);
+        ulong memAccess(ulong addr, int write);
+        ulong mapAddrToCtrl(ulong addr);
+        void dirArrive(DirEntry *de, ulong addr);
+        void dirDepart(DirEntry *de);
+        void PrintStats(int tabular);
+        void PrintDirStats(int tabular);
+        void PrintProtocolStats(int tabular);
+        void PrintStorageStats(int tabular);
         void setState(ulong blockaddr, int s);
+        void changeState(DirEntry *de, int s);
         ulong getFromNetwork(ulong msg, ulong addr, ulong fromtile);
         void netInitRdX(ulong blockaddr, ulong partid);
         void netInitRd(ulong blockaddr, ulong partid);
         void netInitUpgr(ulong blockaddr, ulong partid);
+        void netInitPut(ulong blockaddr, ulong partid);
 };
 
 #endif
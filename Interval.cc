@@ -0,0 +1,124 @@
+/*
+ * Dusty Mabe - 2014
+ * Interval.cc - Implementation of the per-interval statistics.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "Interval.h"
+#include "Dir.h"
+#include "Tile.h"
+#include "params.h"
+
+Interval::Interval(Dir *d, Tile **t, char *fname, ulong by, ulong n) {
+
+    dir   = d;
+    tiles = t;
+    unit  = by;
+    len   = n;
+    count = last = num = 0;
+    next  = len;
+
+    fp = fopen(fname, "w");
+    if (fp == NULL) {
+        printf("Can't open stats file %s\n", fname);
+        exit(1);
+    }
+
+    // Rows only go out in big writes
+    setvbuf(fp, NULL, _IOFBF, INTBUFBYTES);
+
+    fprintf(fp, "# interval of %lu %s\n", len,
+            (unit == INTCYCLES) ? "cycles" : "accesses");
+    fprintf(fp, "# t n accesses tile cycle accesses l2accesses locxfer "
+                "ctocxfer ptopxfer memxfer l1misses l2misses\n");
+    fprintf(fp, "# d n accesses entries em s o i memreads memwbacks "
+                "c2cxfers\n");
+
+    memset(prev, 0, sizeof(prev));
+    memreads = memwbacks = c2cxfers = 0;
+}
+
+Interval::~Interval() {
+    fclose(fp);
+}
+
+/*
+ * Interval::access
+ *     - Called after every access. cycle is the cycle the tile that
+ *       made it is at now. Take the snapshots that have come due.
+ *       Counting in cycles the tiles don't move in step, so a
+ *       snapshot is due when the first tile passes its cycle.
+ */
+void Interval::access(ulong cycle) {
+
+    count++;
+
+    if (unit == INTACCESSES) {
+        if (count >= next) {
+            snapshot();
+            next += len;
+        }
+        return;
+    }
+
+    while (cycle >= next) {
+        snapshot();
+        next += len;
+    }
+}
+
+/*
+ * Interval::finish
+ *     - Write the part of an interval that was left when the trace
+ *       ran out.
+ */
+void Interval::finish() {
+    if (count > last)
+        snapshot();
+    fflush(fp);
+}
+
+/*
+ * Interval::snapshot
+ *     - Write a row per tile and one for the directory with what
+ *       happened since the last snapshot.
+ */
+void Interval::snapshot() {
+
+    IntervalStats s;
+    int i;
+
+    for (i=0; i < NPROCS; i++) {
+        tiles[i]->getIntervalStats(&s);
+        fprintf(fp, "t %lu %lu %d %lu %lu %lu %lu %lu %lu %lu %lu %lu\n",
+                num, count, i, s.cycle,
+                s.accesses   - prev[i].accesses,
+                s.l2accesses - prev[i].l2accesses,
+                s.locxfer    - prev[i].locxfer,
+                s.ctocxfer   - prev[i].ctocxfer,
+                s.ptopxfer   - prev[i].ptopxfer,
+                s.memxfer    - prev[i].memxfer,
+                s.l1misses   - prev[i].l1misses,
+                s.l2misses   - prev[i].l2misses);
+        prev[i] = s;
+    }
+
+    fprintf(fp, "d %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu\n",
+            num, count, dir->blockentries,
+            dir->statecount[DSTATEEM - DSTATEEM],
+            dir->statecount[DSTATES  - DSTATEEM],
+            dir->statecount[DSTATEO  - DSTATEEM],
+            dir->statecount[DSTATEI  - DSTATEEM],
+            dir->memreads  - memreads,
+            dir->memwbacks - memwbacks,
+            dir->c2cxfers  - c2cxfers);
+    memreads  = dir->memreads;
+    memwbacks = dir->memwbacks;
+    c2cxfers  = dir->c2cxfers;
+
+    last = count;
+    num++;
+}
@@ -0,0 +1,80 @@
+/*
+ * Dusty Mabe - 2014
+ * Interval.h - Header file for the per-interval statistics. With
+ *              interval=<n> the simulator takes a snapshot of the
+ *              counters every n accesses (or n cycles) and writes
+ *              what changed since the last one to statsfile=<file>,
+ *              so that phases of a long trace can be told apart.
+ *
+ *              Each snapshot is a row per tile and a row for the
+ *              directory, with the values separated by spaces:
+ *
+ *              t <n> <accesses> <tile> <cycle> <accesses> <l2accesses>
+ *                <locxfer> <ctocxfer> <ptopxfer> <memxfer>
+ *                <l1misses> <l2misses>
+ *              d <n> <accesses> <entries> <em> <s> <o> <i>
+ *                <memreads> <memwbacks> <c2cxfers>
+ *
+ *              The first three columns are the row type, the
+ *              snapshot number and the accesses simulated so far.
+ *              cycle and the directory entry counts are what they
+ *              were at the snapshot; the rest are counts for the
+ *              interval. The file starts with # lines naming the
+ *              columns.
+ */
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <stdio.h>
+#include "types.h"
+#include "params.h"
+
+class Dir;  // Forward Declaration
+class Tile; // Forward Declaration
+
+// What an interval is counted in (selected with intervalby=<unit>)
+enum {
+    INTACCESSES = 0, // Accesses simulated (by all tiles)
+    INTCYCLES,       // Cycles of the furthest ahead tile
+};
+
+// The counters of a tile that go in a snapshot
+struct IntervalStats {
+    ulong cycle;
+    ulong accesses;
+    ulong l2accesses;
+    ulong locxfer;
+    ulong ctocxfer;
+    ulong ptopxfer;
+    ulong memxfer;
+    ulong l1misses;
+    ulong l2misses;
+};
+
+class Interval {
+private:
+    Dir  *  dir;
+    Tile ** tiles;
+    FILE *  fp;
+    ulong   unit;       // INTACCESSES or INTCYCLES
+    ulong   len;        // Accesses or cycles per interval
+    ulong   count;      // Accesses so far (all tiles)
+    ulong   next;       // When the next snapshot is due
+    ulong   num;        // Snapshots written
+    ulong   last;       // count at the last snapshot
+
+    // Counters at the last snapshot
+    IntervalStats prev[NPROCS];
+    ulong   memreads, memwbacks, c2cxfers;
+
+    void snapshot();
+
+public:
+    Interval(Dir *d, Tile **t, char *fname, ulong by, ulong n);
+    ~Interval();
+
+    void access(ulong cycle);
+    void finish();
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Dusty Mabe - 2014
+ * MSHR.cc - Implementation of a miss status holding register file.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "MSHR.h"
+#include "params.h"
+
+MSHR::MSHR(ulong n) {
+
+    size = n;
+    blk  = new ulong[size];
+    done = new ulong[size];
+    assert(blk && done);
+
+    // Every register starts out free (completed at time 0)
+    memset(blk,  0, size * sizeof(ulong));
+    memset(done, 0, size * sizeof(ulong));
+
+    allocs = merges = fullstalls = stallcycles = occupancy = 0;
+}
+
+MSHR::~MSHR() {
+    delete [] blk;
+    delete [] done;
+}
+
+/*
+ * MSHR::lookup
+ *     - Find a register with an outstanding miss for blockaddr.
+ *
+ * Returns the register index or -1 if there is none.
+ */
+int MSHR::lookup(ulong blockaddr, ulong now) {
+    ulong i;
+    for (i=0; i < size; i++)
+        if (done[i] > now && blk[i] == blockaddr)
+            return i;
+    return -1;
+}
+
+/*
+ * MSHR::allocate
+ *     - Allocate a register for a miss to blockaddr issued at now
+ *       that takes latency cycles. If all registers are busy then
+ *       the miss has to wait for the first one to complete.
+ *
+ * Returns the time at which the miss was actually issued.
+ */
+ulong MSHR::allocate(ulong blockaddr, ulong now, ulong latency) {
+
+    ulong i, busy = 0;
+    ulong first = 0; // Register that completes first
+
+    for (i=0; i < size; i++) {
+        if (done[i] > now)
+            busy++;
+        if (done[i] < done[first])
+            first = i;
+    }
+
+    allocs++;
+    occupancy += busy;
+
+    // Stall until a register frees up
+    if (done[first] > now) {
+        fullstalls++;
+        stallcycles += done[first] - now;
+        now = done[first];
+    }
+
+    blk[first]  = blockaddr;
+    done[first] = now + latency;
+
+    return now;
+}
+
+/*
+ * MSHR::lastDone
+ *     - Time at which the last outstanding miss completes.
+ */
+ulong MSHR::lastDone() {
+    ulong i, last = 0;
+    for (i=0; i < size; i++)
+        last = MAX(last, done[i]);
+    return last;
+}
+
+/*
+ * MSHR::PrintStatsTabular
+ *     - Print the MSHR counters as columns.
+ */
+void MSHR::PrintStatsTabular(int printhead) {
+
+    if (printhead) {
+        printf("%15s%15s%15s%15s%15s%15s",
+               "mshrallocs", "mshrmerges", "mergerate",
+               "avgoccupancy", "fullstalls", "stallcycles");
+        return;
+    }
+
+    printf("%15lu%15lu%15f%15f%15lu%15lu",
+           allocs, merges,
+           (allocs + merges) ? ((float)merges / (float)(allocs + merges)) : 0.0,
+           allocs ? ((float)occupancy / (float)allocs) : 0.0,
+           fullstalls, stallcycles);
+}
@@ -0,0 +1,36 @@
+/*
+ * Dusty Mabe - 2014
+ * MSHR.h - Header file for a file of miss status holding registers.
+ *          Each tile has one so that it can keep several misses to
+ *          the L2/memory outstanding at a time instead of waiting
+ *          for each one to complete.
+ */
+#ifndef MSHR_H
+#define MSHR_H
+
+#include "types.h"
+
+class MSHR {
+private:
+    ulong size;     // Number of registers
+    ulong *blk;     // Block address held by each register
+    ulong *done;    // Time at which each register's miss completes
+
+public:
+    // Counters
+    ulong allocs;      // Misses that needed a new register
+    ulong merges;      // Accesses merged into an outstanding miss
+    ulong fullstalls;  // Times a miss found every register busy
+    ulong stallcycles; // Cycles spent waiting for a free register
+    ulong occupancy;   // Sum of busy registers seen at each alloc
+
+    MSHR(ulong n);
+    ~MSHR();
+
+    int   lookup(ulong blockaddr, ulong now);
+    ulong allocate(ulong blockaddr, ulong now, ulong latency);
+    ulong lastDone();
+    void  PrintStatsTabular(int printhead);
+};
+
+#endif
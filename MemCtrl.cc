@@ -0,0 +1,203 @@
+/*
+ * Dusty Mabe - 2014
+ * MemCtrl.cc - Implementation of the memory controller / DRAM model.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "MemCtrl.h"
+#include "ResTable.h"
+#include "params.h"
+
+// Which row buffer policy to use (ROWOPEN or ROWCLOSED)
+extern ulong ROWPOLICY;
+
+// Number of memory controllers and how blocks are spread across them
+extern ulong NUMMEMCTRLS;
+extern ulong INTERLEAVE;
+
+MemCtrl::MemCtrl() {
+
+    ulong i;
+
+    // Banks are reserved for the time the array is busy and the
+    // bus for the time it takes to move a block.
+    banks = new ResTable(NUMMEMCTRLS * MEMBANKS, MEMBANKBITS, MEMBUCKETS,
+                         1 << MEMBANKBITS);
+    bus   = new ResTable(NUMMEMCTRLS, MEMBUSBITS, MEMBUCKETS,
+                         1 << MEMBUSBITS);
+    assert(banks && bus);
+
+    openrow = new long[NUMMEMCTRLS * MEMBANKS];
+    for (i=0; i < NUMMEMCTRLS * MEMBANKS; i++)
+        openrow[i] = -1;
+
+    reads        = new ulong[NUMMEMCTRLS];
+    writes       = new ulong[NUMMEMCTRLS];
+    rowhits      = new ulong[NUMMEMCTRLS];
+    rowmisses    = new ulong[NUMMEMCTRLS];
+    rowconflicts = new ulong[NUMMEMCTRLS];
+    qcycles      = new ulong[NUMMEMCTRLS];
+    latcycles    = new ulong[NUMMEMCTRLS];
+    memset(reads,        0, NUMMEMCTRLS * sizeof(ulong));
+    memset(writes,       0, NUMMEMCTRLS * sizeof(ulong));
+    memset(rowhits,      0, NUMMEMCTRLS * sizeof(ulong));
+    memset(rowmisses,    0, NUMMEMCTRLS * sizeof(ulong));
+    memset(rowconflicts, 0, NUMMEMCTRLS * sizeof(ulong));
+    memset(qcycles,      0, NUMMEMCTRLS * sizeof(ulong));
+    memset(latcycles,    0, NUMMEMCTRLS * sizeof(ulong));
+
+    lasttime = 0;
+}
+
+MemCtrl::~MemCtrl() {
+    delete banks;
+    delete bus;
+    delete [] openrow;
+    delete [] reads;
+    delete [] writes;
+    delete [] rowhits;
+    delete [] rowmisses;
+    delete [] rowconflicts;
+    delete [] qcycles;
+    delete [] latcycles;
+}
+
+/*
+ * MemCtrl::mapAddrToCtrl
+ *     - Find the memory controller responsible for addr. This is
+ *       the one place the interleaving policy lives; the directory
+ *       and the network both ask here.
+ */
+ulong MemCtrl::mapAddrToCtrl(ulong addr) {
+
+    ulong blk = BLKADDR(addr);
+    ulong h;
+
+    switch (INTERLEAVE) {
+        case ILVPAGE:
+            return (addr >> PAGEBITS) % NUMMEMCTRLS;
+        case ILVXOR:
+            for (h = 0; blk; blk >>= XORFOLDBITS)
+                h ^= blk & ((1 << XORFOLDBITS) - 1);
+            return h % NUMMEMCTRLS;
+        default:
+            return blk % NUMMEMCTRLS;
+    }
+}
+
+/*
+ * MemCtrl::localBlock
+ *     - Number of the block containing addr among the blocks that
+ *       belong to its controller. Used to pick the bank and row.
+ */
+ulong MemCtrl::localBlock(ulong addr) {
+
+    ulong blk = BLKADDR(addr);
+    ulong pageblks = 1 << (PAGEBITS - OFFSETBITS);
+
+    if (INTERLEAVE == ILVPAGE)
+        return ((addr >> PAGEBITS) / NUMMEMCTRLS) * pageblks +
+               (blk % pageblks);
+    return blk / NUMMEMCTRLS;
+}
+
+/*
+ * MemCtrl::access
+ *     - Perform a read or write of the block containing addr that
+ *       arrives at its controller at time. Blocks are interleaved
+ *       across the controllers; within a controller consecutive
+ *       blocks fill a row before moving to the next bank.
+ *
+ * Returns the latency from arrival until the data is on its way
+ * back from the controller.
+ */
+ulong MemCtrl::access(ulong addr, ulong time, int write) {
+
+    ulong ctrl  = mapAddrToCtrl(addr);
+    ulong local = localBlock(addr); // Block # within ctrl
+    ulong blksperrow = MEMROWBYTES / BLKSIZE;
+    ulong bank  = (local / blksperrow) % MEMBANKS;
+    long  row   = local / (blksperrow * MEMBANKS);
+    ulong b     = ctrl*MEMBANKS + bank;
+    ulong array, busy, bankq, busq, start, done;
+
+    if (write)
+        writes[ctrl]++;
+    else
+        reads[ctrl]++;
+
+    // How long the bank array takes depends on the row buffer
+    if (ROWPOLICY == ROWCLOSED) {
+        rowmisses[ctrl]++;
+        array = TRCD + TCAS;
+        busy  = array + TRP; // Precharge before the next access
+    } else if (openrow[b] == row) {
+        rowhits[ctrl]++;
+        array = busy = TCAS;
+    } else if (openrow[b] == -1) {
+        rowmisses[ctrl]++;
+        array = busy = TRCD + TCAS;
+    } else {
+        rowconflicts[ctrl]++;
+        array = busy = TRP + TRCD + TCAS;
+    }
+    if (ROWPOLICY == ROWOPEN)
+        openrow[b] = row;
+
+    // Wait in the queue for the bank, then for the data bus
+    start = time + MEMCTRLTIME;
+    bankq = banks->reserve(b, start, busy);
+    start += bankq + array;
+    busq  = bus->reserve(ctrl, start, TBURST);
+    done  = start + busq + TBURST;
+
+    qcycles[ctrl]   += bankq + busq;
+    latcycles[ctrl] += done - time;
+    lasttime = MAX(lasttime, done);
+
+    return done - time;
+}
+
+/*
+ * MemCtrl::PrintStats
+ *     - Print per controller utilization and queuing stats.
+ *       Utilization is the fraction of time the data bus was busy.
+ *       Occupancy is the average number of requests in the
+ *       controller (Little's law).
+ */
+void MemCtrl::PrintStats(int tabular) {
+
+    ulong i, n;
+    ulong elapsed = (lasttime ? lasttime : 1);
+
+    if (tabular)
+        printf("%15s%15s%15s%15s%15s%15s%15s%15s%15s\n",
+               "memctrl", "reads", "writes", "rowhits", "rowmisses",
+               "rowconflicts", "avgqdelay", "occupancy", "busutil");
+    else
+        printf("===== Memory controllers (DRAM model) =============\n");
+
+    for (i=0; i < NUMMEMCTRLS; i++) {
+        n = reads[i] + writes[i];
+        if (tabular) {
+            printf("%15lu%15lu%15lu%15lu%15lu%15lu%15f%15f%15f\n",
+                   i, reads[i], writes[i], rowhits[i], rowmisses[i],
+                   rowconflicts[i],
+                   n ? ((float)qcycles[i] / (float)n) : 0.0,
+                   ((float)latcycles[i] / (float)elapsed),
+                   ((float)bus->units[i] / (float)elapsed));
+        } else {
+            printf("Controller %lu: reads %lu, writes %lu, row hits %lu, "
+                   "row misses %lu, row conflicts %lu\n",
+                   i, reads[i], writes[i], rowhits[i], rowmisses[i],
+                   rowconflicts[i]);
+            printf("              avg queuing delay %f, occupancy %f, "
+                   "bus utilization %f\n",
+                   n ? ((float)qcycles[i] / (float)n) : 0.0,
+                   ((float)latcycles[i] / (float)elapsed),
+                   ((float)bus->units[i] / (float)elapsed));
+        }
+    }
+}
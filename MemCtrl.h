@@ -0,0 +1,64 @@
+/*
+ * Dusty Mabe - 2014
+ * MemCtrl.h - Header file for a model of the memory controllers and
+ *             the DRAM behind them. Each controller has a number of
+ *             banks with a row buffer and a shared data bus. Requests
+ *             that find their bank or the bus busy wait in the
+ *             controller's request queue.
+ *
+ *             Like the directory there is one MemCtrl object that
+ *             models all of the controllers.
+ */
+#ifndef MEMCTRL_H
+#define MEMCTRL_H
+
+#include "types.h"
+
+class ResTable; // Forward Declaration
+
+// Memory models (selected with mem=<model> on the command line)
+enum {
+    MEMFIXED = 0, // Flat MEMATIME for every access
+    MEMDRAM,      // Queuing, banks and row buffers
+};
+
+// DRAM row buffer policies (selected with rowpolicy=<policy>)
+enum {
+    ROWOPEN = 0,  // Leave the row open after an access
+    ROWCLOSED,    // Precharge after every access
+};
+
+// Block to controller interleaving (selected with interleave=<policy>)
+enum {
+    ILVBLOCK = 0, // Consecutive blocks go to consecutive controllers
+    ILVPAGE,      // Consecutive pages go to consecutive controllers
+    ILVXOR,       // Controller picked by an XOR fold of the block address
+};
+
+class MemCtrl {
+private:
+    ResTable * banks;  // Bank occupancy [NUMMEMCTRLS * MEMBANKS]
+    ResTable * bus;    // Data bus occupancy [NUMMEMCTRLS]
+    long * openrow;    // Open row in each bank (-1 if closed)
+    ulong lasttime;    // Latest completion time seen (for utilization)
+
+    // Per controller counters
+    ulong * reads;
+    ulong * writes;
+    ulong * rowhits;
+    ulong * rowmisses;    // Bank was precharged
+    ulong * rowconflicts; // A different row was open
+    ulong * qcycles;      // Cycles spent waiting for a bank or the bus
+    ulong * latcycles;    // Cycles from arrival to completion
+
+public:
+    MemCtrl();
+    ~MemCtrl();
+
+    ulong access(ulong addr, ulong time, int write);
+    static ulong mapAddrToCtrl(ulong addr);
+    static ulong localBlock(ulong addr);
+    void  PrintStats(int tabular);
+};
+
+#endif
@@ -4,61 +4,282 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include "Net.h"
 #include "Dir.h"
 #include "Tile.h"
+#include "ResTable.h"
+#include "MemCtrl.h"
+#include "Prof.h"
 #include "types.h"
 #include "params.h"
+#include "Delay.h"
 
-// Global delay counter for the current outstanding memory request.
-extern int CURRENTDELAY;
+// The tile (and its cycle) whose access is currently being simulated
+extern ulong CURRENTTILE;
+extern ulong CURRENTCYCLE;
+
+// Which network model to use (NETFIXED or NETMESH)
+extern ulong NETMODEL;
+
+// Which memory model to use (MEMFIXED or MEMDRAM)
+extern ulong MEMMODEL;
+
+// Topology of the chip
+extern ulong TOPOLOGY;
+extern ulong TOPOWIDTH;
+extern ulong TOPOHEIGHT;
+extern ulong TOPOCONC;
+
+// Memory controllers and where they attach
+extern ulong NUMMEMCTRLS;
+extern ulong CTRLPLACE;
+extern ulong CTRLTILES[];
+extern ulong INTERLEAVE;
+
+// Global simulator profile is defined in simulator.cc
+extern Prof *PROF;
 
 Net::Net(Dir * dirr, Tile ** tiless) {
     dir   = dirr;
     tiles = tiless;
+    links = NULL;
+
+    qdelay  = new ulong[NPROCS];
+    netmsgs = new ulong[NPROCS];
+    memset(qdelay,  0, NPROCS * sizeof(ulong));
+    memset(netmsgs, 0, NPROCS * sizeof(ulong));
+
+    ctrlmsgs   = new ulong[NUMMEMCTRLS];
+    ctrlflits  = new ulong[NUMMEMCTRLS];
+    ctrlhopsum = new ulong[NUMMEMCTRLS];
+    memset(ctrlmsgs,   0, NUMMEMCTRLS * sizeof(ulong));
+    memset(ctrlflits,  0, NUMMEMCTRLS * sizeof(ulong));
+    memset(ctrlhopsum, 0, NUMMEMCTRLS * sizeof(ulong));
+
+    totalmsgs = totalflits = 0;
+
+    buildTopology();
+
+    // For the mesh model there is a link in each direction
+    // out of every router plus a link each way between every
+    // memory controller and its router.
+    if (NETMODEL == NETMESH)
+        links = new ResTable(rw * rh * NUMLINKDIRS + 2 * NUMMEMCTRLS,
+                             NETBUCKETBITS, NETBUCKETS,
+                             1 << NETBUCKETBITS); // 1 flit per cycle
+}
+
+/*
+ * Net::buildTopology
+ *     - Work out which router every tile hangs off of and where
+ *       the memory controllers attach, then precompute the hop
+ *       counts between every pair of tiles and between every
+ *       controller and tile so lookups are O(1) at any size.
+ */
+void Net::buildTopology() {
+
+    int i, j, d, row, col;
+
+    // Concentrated mesh: 2 tiles share a router side by side,
+    // 4 tiles share a router in a 2x2 block.
+    cw = ch = 1;
+    if (TOPOLOGY == TOPOCMESH) {
+        cw = (TOPOCONC >= 2) ? 2 : 1;
+        ch = (TOPOCONC >= 4) ? 2 : 1;
+    }
+    rw   = TOPOWIDTH / cw;
+    rh   = TOPOHEIGHT / ch;
+    wrap = (TOPOLOGY == TOPOTORUS || TOPOLOGY == TOPORING);
+
+    router = new int[NPROCS];
+    for (i=0; i < NPROCS; i++) {
+        row = i / TOPOWIDTH;
+        col = i % TOPOWIDTH;
+        router[i] = (row / ch) * rw + (col / cw);
+    }
+
+    placeCtrls();
+
+    tilehops = new ushort[NPROCS * NPROCS];
+    for (i=0; i < NPROCS; i++) {
+        for (j=0; j < NPROCS; j++) {
+            tilehops[i*NPROCS + j] = routerHops(router[i], router[j]);
+            // Tiles that share a router still go through it
+            if (i != j && router[i] == router[j])
+                tilehops[i*NPROCS + j] = 1;
+        }
+    }
+
+    ctrlhops = new ushort[NUMMEMCTRLS * NPROCS];
+    for (d=0; d < (int)NUMMEMCTRLS; d++)
+        for (j=0; j < NPROCS; j++)
+            ctrlhops[d*NPROCS + j] = 1 + routerHops(router[ctrltile[d]], router[j]);
+}
+
+/*
+ * Net::placeCtrls
+ *     - Pick the tile each memory controller attaches to. The
+ *       controller sits one hop off that tile.
+ *
+ *       corners: the top left, top right, bottom left and bottom
+ *                right tiles in that order (at most 4 controllers).
+ *       edges:   spread evenly around the edge of the grid, walking
+ *                clockwise from the top left tile.
+ *       list:    the tiles given with ctrlplace=<t0>,<t1>,...
+ *
+ *       On a ring there are no corners so corners and edges both
+ *       spread the controllers evenly around the ring.
+ */
+void Net::placeCtrls() {
+
+    int d, i, n, row, col;
+    int perim = 2*TOPOWIDTH + 2*TOPOHEIGHT - 4;
+    int * edge;
+
+    ctrltile = new int[NUMMEMCTRLS];
+
+    if (CTRLPLACE == CTRLLIST) {
+        for (d=0; d < (int)NUMMEMCTRLS; d++) {
+            if (CTRLTILES[d] >= NPROCS) {
+                printf("Memory controller %d: no tile %lu\n", d, CTRLTILES[d]);
+                exit(1);
+            }
+            ctrltile[d] = CTRLTILES[d];
+        }
+        return;
+    }
+
+    if (TOPOLOGY == TOPORING || TOPOHEIGHT == 1 || TOPOWIDTH == 1) {
+        for (d=0; d < (int)NUMMEMCTRLS; d++)
+            ctrltile[d] = d * NPROCS / NUMMEMCTRLS;
+        return;
+    }
+
+    if (CTRLPLACE == CTRLCORNERS) {
+        if (NUMMEMCTRLS > 4) {
+            printf("Only 4 memory controllers fit on the corners. "
+                   "Use ctrlplace=edges\n");
+            exit(1);
+        }
+        for (d=0; d < (int)NUMMEMCTRLS; d++) {
+            row = (d & 2) ? (TOPOHEIGHT - 1) : 0;
+            col = (d & 1) ? (TOPOWIDTH - 1)  : 0;
+            ctrltile[d] = row * TOPOWIDTH + col;
+        }
+        return;
+    }
+
+    // Walk the edge of the grid clockwise from the top left
+    edge = new int[perim];
+    n = 0;
+    for (col=0; col < (int)TOPOWIDTH; col++)
+        edge[n++] = col;
+    for (row=1; row < (int)TOPOHEIGHT; row++)
+        edge[n++] = row * TOPOWIDTH + TOPOWIDTH - 1;
+    for (col=TOPOWIDTH - 2; col >= 0; col--)
+        edge[n++] = (TOPOHEIGHT - 1) * TOPOWIDTH + col;
+    for (row=TOPOHEIGHT - 2; row > 0; row--)
+        edge[n++] = row * TOPOWIDTH;
+    assert(n == perim);
+
+    // Put each controller in the middle of its share of the edge
+    for (d=0; d < (int)NUMMEMCTRLS; d++) {
+        i = ((2*d + 1) * perim) / (2 * NUMMEMCTRLS);
+        ctrltile[d] = edge[i];
+    }
+    delete [] edge;
+}
+
+/*
+ * Net::routerHops
+ *     - Minimal number of router to router hops between r0 and r1.
+ */
+ulong Net::routerHops(int r0, int r1) {
+
+    int dx = abs((r0 % rw) - (r1 % rw));
+    int dy = abs((r0 / rw) - (r1 / rw));
+
+    if (wrap) {
+        dx = MIN(dx, rw - dx);
+        dy = MIN(dy, rh - dy);
+    }
+    return dx + dy;
 }
 
 ulong Net::sendReqTileToTile(ulong msg, ulong addr, ulong fromtile, ulong totile) {
     // Add in the delay
     if (fromtile != totile)
-        CURRENTDELAY += HOPDELAY(calcTileToTileHops(fromtile, totile));
+        CURRENTDELAY += msgDelay(fromtile, totile, REQFLITS);
 
     // Service the request
     return tiles[totile]->getFromNetwork(msg, addr, fromtile);
 }
 
-ulong Net::sendReqDirToTile(ulong msg, ulong addr, ulong totile) {
+/*
+ * Net::sendDataTileToTile
+ *     - Like sendReqTileToTile but the message carries a block.
+ */
+ulong Net::sendDataTileToTile(ulong msg, ulong addr, ulong fromtile, ulong totile) {
     // Add in the delay
-    CURRENTDELAY += HOPDELAY(calcTileToDirHops(addr, totile));
+    if (fromtile != totile)
+        CURRENTDELAY += msgDelay(fromtile, totile, DATAFLITS);
+
     // Service the request
-    tiles[totile]->getFromNetwork(msg, addr, -1); // Use invalid tile
-    return 1;
+    return tiles[totile]->getFromNetwork(msg, addr, fromtile);
+}
+
+ulong Net::sendReqDirToTile(ulong msg, ulong addr, ulong totile) {
+    // Add in the delay
+    CURRENTDELAY += msgDelay(dirNode(addr), totile, REQFLITS);
+    // Service the request (1 comes back if the tile had dirty data)
+    return tiles[totile]->getFromNetwork(msg, addr, -1); // Use invalid tile
 }
 
 ulong Net::sendReqTileToDir(ulong msg, ulong addr, ulong fromtile) {
+    ulong state;
+    ulong start = CURRENTDELAY + CURRENTMEMDELAY;
     // Add in the delay
-    CURRENTDELAY += HOPDELAY(calcTileToDirHops(addr, fromtile));
+    CURRENTDELAY += msgDelay(fromtile, dirNode(addr), REQFLITS);
     // Service the request
-    return dir->getFromNetwork(msg, addr, fromtile);
+    PROF->dirEnter();
+    state = dir->getFromNetwork(msg, addr, fromtile);
+    PROF->dirExit();
+    // Let the directory know how long the whole transaction took
+    // (nobody waits for an eviction notice)
+    if (msg != PUTS && msg != PUTM)
+        dir->recordLatency(msg, CURRENTDELAY + CURRENTMEMDELAY - start);
+    return state;
 }
 
 ulong Net::fakeReqDirToTile(ulong addr, ulong totile) {
     // Add in the delay
-    CURRENTDELAY += HOPDELAY(calcTileToDirHops(addr, totile));
+    CURRENTDELAY += msgDelay(dirNode(addr), totile, REQFLITS);
+    return 1;
+}
+
+/*
+ * Net::fakeReqTileToDir
+ *     - A reply (no data) from a tile back to the directory.
+ */
+ulong Net::fakeReqTileToDir(ulong addr, ulong fromtile) {
+    // Add in the delay
+    CURRENTDELAY += msgDelay(fromtile, dirNode(addr), REQFLITS);
     return 1;
 }
 
 ulong Net::fakeDataTileToTile(ulong fromtile, ulong totile) {
     // Add in the delay
     if (fromtile != totile)
-        CURRENTDELAY += DATAHOPDELAY(calcTileToTileHops(fromtile, totile));
+        CURRENTDELAY += msgDelay(fromtile, totile, DATAFLITS);
     return 1;
 }
 
 ulong Net::fakeDataDirToTile(ulong addr, ulong totile) {
     // Add in the delay
-    CURRENTDELAY += DATAHOPDELAY(calcTileToDirHops(addr, totile));
+    CURRENTDELAY += msgDelay(dirNode(addr), totile, DATAFLITS);
     return 1;
 }
 
@@ -70,44 +291,299 @@ ulong Net::flushToMem(ulong addr, ulong fromtile) {
 
     // Don't need to actually send a message to mem
     // just calculate # hops and then delay
-    int hops  = calcTileToDirHops(addr, fromtile);
-    int delay = DATAHOPDELAY(hops);
+    ulong delay = msgDelay(fromtile, dirNode(addr), DATAFLITS);
+    CURRENTDELAY += delay;
+    dir->memflushes++;
 
-    CURRENTDELAY += delay; 
+    // The write still takes up memory bandwidth
+    if (MEMMODEL == MEMDRAM)
+        dir->memAccess(addr, 1);
+
+    return delay;
 }
 
-ulong Net::calcTileToDirHops(ulong addr, ulong tile) {
+/*
+ * Net::writeBackToMem
+ *     - Send an evicted dirty block back to memory. Nobody waits
+ *       for this so it doesn't add to the delay, but with the DRAM
+ *       model it uses up bank and bus time at the controller.
+ */
+ulong Net::writeBackToMem(ulong addr, ulong fromtile) {
+
+    dir->memwbacks++;
+
+    if (MEMMODEL != MEMDRAM)
+        return 0;
+
+    DelayScope saved;
+    CURRENTDELAY += msgDelay(fromtile, dirNode(addr), DATAFLITS);
+    dir->memAccess(addr, 1);
+    return 0;
+}
 
-    int dirnum = BLKADDR(addr) % 4;
-    int hops   = 0;
-    switch (dirnum) {
-        case 0: // Attached to tile 0. 1 hop to the left
-            hops = calcDistance(-1, 0, tiles[tile]->xindex, tiles[tile]->yindex);
-            break;
-        case 1: // Attached to tile 3. 1 hop to the right
-            hops = calcDistance(4, 0, tiles[tile]->xindex, tiles[tile]->yindex);
-            break;
-        case 2: // Attached to tile 12. 1 hop to the left
-            hops = calcDistance(-1, 3, tiles[tile]->xindex, tiles[tile]->yindex);
-            break;
-        case 3: // Attached to tile 15. 1 hop to the right
-            hops = calcDistance(4, 3, tiles[tile]->xindex, tiles[tile]->yindex);
-            break;
-        default :
-            assert(0); // Should not get here.
+/*
+ * Net::dirNode
+ *     - Network node of the memory controller (directory) that
+ *       owns addr. Nodes 0..NPROCS-1 are the tiles and the
+ *       memory controllers follow.
+ */
+ulong Net::dirNode(ulong addr) {
+    return NPROCS + dir->mapAddrToCtrl(addr);
+}
+
+/*
+ * Net::msgDelay
+ *     - Calculate the delay of a message of flits flits sent from
+ *       fromnode to tonode using the selected network model.
+ */
+ulong Net::msgDelay(ulong fromnode, ulong tonode, ulong flits) {
+
+    ulong hops, ctrl;
+
+    totalmsgs++;
+    totalflits += flits;
+
+    if (fromnode >= NPROCS || tonode >= NPROCS) {
+        ctrl = (fromnode >= NPROCS) ? fromnode - NPROCS : tonode - NPROCS;
+        hops = calcDirToTileHops(ctrl, (fromnode >= NPROCS) ? tonode : fromnode);
+        ctrlmsgs[ctrl]++;
+        ctrlflits[ctrl]  += flits;
+        ctrlhopsum[ctrl] += hops;
+    } else {
+        hops = calcTileToTileHops(fromnode, tonode);
+    }
+
+    if (NETMODEL == NETMESH)
+        return routeMesh(fromnode, tonode, flits);
+
+    // Fixed model: a constant delay per hop
+    if (flits == REQFLITS)
+        return HOPDELAY(hops);
+    return DATAHOPDELAY(hops);
+}
+
+/*
+ * Net::linkId
+ *     - Index of the link leaving router in direction dir.
+ */
+ulong Net::linkId(int router, int dir) {
+    return router * NUMLINKDIRS + dir;
+}
+
+/*
+ * Net::ctrlLinkId
+ *     - Index of the link between a memory controller and its
+ *       router (in == 1 for the direction into the controller).
+ */
+ulong Net::ctrlLinkId(int ctrl, int in) {
+    return rw * rh * NUMLINKDIRS + 2 * ctrl + in;
+}
+
+/*
+ * Net::nextLink
+ *     - Dimension order routing: move along the row first, then
+ *       along the column. With wraparound links go whichever way
+ *       round is shorter.
+ *
+ * Returns the direction of the link to take and sets next to the
+ * router at the other end of it.
+ */
+int Net::nextLink(int cur, int dst, int *next) {
+
+    int x  = cur % rw, y  = cur / rw;
+    int dx = dst % rw, dy = dst / rw;
+    int dir, fwd;
+
+    if (x != dx) {
+        fwd = (dx > x);
+        if (wrap && abs(dx - x) > rw - abs(dx - x))
+            fwd = !fwd;
+        dir = fwd ? LINKE : LINKW;
+        x   = (x + (fwd ? 1 : rw - 1)) % rw;
+    } else {
+        fwd = (dy > y);
+        if (wrap && abs(dy - y) > rh - abs(dy - y))
+            fwd = !fwd;
+        dir = fwd ? LINKS : LINKN;
+        y   = (y + (fwd ? 1 : rh - 1)) % rh;
+    }
+
+    *next = y * rw + x;
+    return dir;
+}
+
+/*
+ * Net::routeMesh
+ *     - Send a message through the network hop by hop. Every hop
+ *       costs a router traversal plus a link traversal, and the
+ *       flits of the message are reserved on each link they cross.
+ *       If the link is already busy in that time bucket the message
+ *       waits.
+ *
+ * Returns the latency of the message (arrival of the tail flit).
+ */
+ulong Net::routeMesh(ulong fromnode, ulong tonode, ulong flits) {
+
+    int cur, dst, next, dir;
+    ulong q;
+    ulong start = CURRENTCYCLE + CURRENTDELAY + CURRENTMEMDELAY;
+    ulong time  = start;
+
+    // Memory controllers first cross the link to their router
+    if (fromnode >= NPROCS) {
+        time += ROUTERTIME;
+        q = links->reserve(ctrlLinkId(fromnode - NPROCS, 0), time, flits);
+        time += q + LINKTIME;
+        qdelay[CURRENTTILE] += q;
+        cur = router[ctrltile[fromnode - NPROCS]];
+    } else {
+        cur = router[fromnode];
+    }
+
+    if (tonode >= NPROCS)
+        dst = router[ctrltile[tonode - NPROCS]];
+    else
+        dst = router[tonode];
+
+    // Tiles on the same router just go through its crossbar
+    if (cur == dst && fromnode != tonode && tonode < NPROCS)
+        time += ROUTERTIME + LINKTIME;
+
+    while (cur != dst) {
+
+        dir = nextLink(cur, dst, &next);
+
+        // Through the router and then wait for the link
+        time += ROUTERTIME;
+        q = links->reserve(linkId(cur, dir), time, flits);
+        time += q + LINKTIME;
+        qdelay[CURRENTTILE] += q;
+
+        cur = next;
+    }
+
+    // And the last link into the memory controller
+    if (tonode >= NPROCS) {
+        time += ROUTERTIME;
+        q = links->reserve(ctrlLinkId(tonode - NPROCS, 1), time, flits);
+        time += q + LINKTIME;
+        qdelay[CURRENTTILE] += q;
     }
 
-    return hops;
+    netmsgs[CURRENTTILE]++;
+
+    // The rest of the flits trail the head flit
+    return (time - start) + (flits - 1);
+}
+
+ulong Net::calcTileToDirHops(ulong addr, ulong tile) {
+    return ctrlhops[dir->mapAddrToCtrl(addr) * NPROCS + tile];
+}
+
+ulong Net::calcDirToTileHops(ulong dirnum, ulong tile) {
+    return ctrlhops[dirnum * NPROCS + tile];
 }
 
 ulong Net::calcTileToTileHops(ulong fromtile, ulong totile) {
-    int x0 = tiles[fromtile]->xindex;
-    int y0 = tiles[fromtile]->yindex;
-    int x1 = tiles[totile]->xindex;
-    int y1 = tiles[totile]->yindex;
-    return calcDistance(x0, x1, y0, y1);
+    return tilehops[fromtile * NPROCS + totile];
 }
 
-ulong Net::calcDistance(int x0, int x1, int y0, int y1) {
-    return (abs(x1-x0) + abs(y1-y0));
+/*
+ * Net::PrintStats
+ *     - Print per tile link utilization and queuing delay for the
+ *       contention model. Utilization is the fraction of the cycles
+ *       that the links leaving a tile's router were busy.
+ */
+void Net::PrintStats(int tabular) {
+
+    ulong i, d, flits;
+    ulong elapsed = 0;
+
+    // Only if the controllers aren't the default 4 block interleaved
+    // ones off the corners
+    if (NUMMEMCTRLS != 4 || CTRLPLACE != CTRLCORNERS || INTERLEAVE != ILVBLOCK)
+        PrintCtrlStats(tabular);
+
+    if (NETMODEL != NETMESH)
+        return;
+
+    // Elapsed time is the time of the slowest tile
+    for (i=0; i < NPROCS; i++)
+        elapsed = MAX(elapsed, tiles[i]->cycle);
+    if (elapsed == 0)
+        elapsed = 1;
+
+    if (tabular)
+        printf("%15s%15s%15s%15s%15s\n",
+               "tile", "netmsgs", "qdelay", "avgqdelay", "linkutil");
+    else
+        printf("===== Network (mesh contention model) =============\n");
+
+    for (i=0; i < NPROCS; i++) {
+        flits = 0;
+        for (d=0; d < NUMLINKDIRS; d++)
+            flits += links->units[linkId(router[i], d)];
+
+        if (tabular) {
+            printf("%15lu%15lu%15lu%15f%15f\n", i, netmsgs[i], qdelay[i],
+                   netmsgs[i] ? ((float)qdelay[i] / (float)netmsgs[i]) : 0.0,
+                   ((float)flits / (float)(NUMLINKDIRS * elapsed)));
+        } else {
+            printf("Tile %2lu: messages %lu, queuing cycles %lu, link utilization %f\n",
+                   i, netmsgs[i], qdelay[i],
+                   ((float)flits / (float)(NUMLINKDIRS * elapsed)));
+        }
+    }
+}
+
+/*
+ * Net::PrintCtrlStats
+ *     - Print how the traffic is spread across the memory
+ *       controllers. Share is the fraction of all controller flits
+ *       that went through a controller and imbalance is the busiest
+ *       controller's flits over the mean (1.0 is perfectly even).
+ */
+void Net::PrintCtrlStats(int tabular) {
+
+    ulong i;
+    ulong msgs = 0, flits = 0, hops = 0, maxflits = 0;
+    float imbalance;
+
+    for (i=0; i < NUMMEMCTRLS; i++) {
+        msgs  += ctrlmsgs[i];
+        flits += ctrlflits[i];
+        hops  += ctrlhopsum[i];
+        maxflits = MAX(maxflits, ctrlflits[i]);
+    }
+    imbalance = flits ? ((float)maxflits * NUMMEMCTRLS / (float)flits) : 0.0;
+
+    if (tabular)
+        printf("%15s%15s%15s%15s%15s%15s\n",
+               "memctrl", "attachtile", "ctrlmsgs", "ctrlflits",
+               "flitshare", "avghops");
+    else
+        printf("===== Memory controller traffic ====================\n");
+
+    for (i=0; i < NUMMEMCTRLS; i++) {
+        if (tabular) {
+            printf("%15lu%15d%15lu%15lu%15f%15f\n",
+                   i, ctrltile[i], ctrlmsgs[i], ctrlflits[i],
+                   flits ? ((float)ctrlflits[i] / (float)flits) : 0.0,
+                   ctrlmsgs[i] ? ((float)ctrlhopsum[i] / (float)ctrlmsgs[i]) : 0.0);
+        } else {
+            printf("Controller %lu (tile %d): messages %lu, flits %lu, "
+                   "share %f, avg hops %f\n",
+                   i, ctrltile[i], ctrlmsgs[i], ctrlflits[i],
+                   flits ? ((float)ctrlflits[i] / (float)flits) : 0.0,
+                   ctrlmsgs[i] ? ((float)ctrlhopsum[i] / (float)ctrlmsgs[i]) : 0.0);
+        }
+    }
+
+    if (tabular) {
+        printf("%15s%15s%15s%15s\n", "ctrlmsgs", "ctrlflits", "imbalance", "avghops");
+        printf("%15lu%15lu%15f%15f\n", msgs, flits, imbalance,
+               msgs ? ((float)hops / (float)msgs) : 0.0);
+    } else
+        printf("Imbalance (max/mean flits) %f, avg hops %f\n",
+               imbalance, msgs ? ((float)hops / (float)msgs) : 0.0);
 }
@@ -17,8 +17,39 @@
 
 #include "types.h"
 
-class Dir;  // Forward Declaration
-class Tile; // Forward Declaration
+class Dir;      // Forward Declaration
+class Tile;     // Forward Declaration
+class ResTable; // Forward Declaration
+
+// Topologies (selected with topo=<topology> on the command line)
+enum {
+    TOPOMESH = 0, // WxH mesh
+    TOPOTORUS,    // WxH mesh with wraparound links
+    TOPORING,     // Bidirectional ring
+    TOPOCMESH,    // WxH tiles with TOPOCONC tiles per mesh router
+};
+
+// Where the memory controllers attach (selected with ctrlplace=<placement>)
+enum {
+    CTRLCORNERS = 0, // Off the corner tiles (spread evenly on a ring)
+    CTRLEDGES,       // Spread evenly around the edge of the grid
+    CTRLLIST,        // Off the tiles given on the command line
+};
+
+// Network models (selected with net=<model> on the command line)
+enum {
+    NETFIXED = 0, // Fixed HOPDELAY/DATAHOPDELAY per hop
+    NETMESH,      // Dimension order routing with per-link contention
+};
+
+// Router link directions
+enum {
+    LINKE = 0,
+    LINKW,
+    LINKN,
+    LINKS,
+    NUMLINKDIRS
+};
 
 
 // Message types to be passed back and forth over the network. 
@@ -43,6 +74,35 @@ enum {
     // Note: happens on L1 miss or L1 writethrough
     L2RD,
     L2WR,
+
+    // Tile (prefetcher) -> Tile (L2) messages
+    // Note: asks the home slice to fetch a block nobody needs yet
+    L2PF,
+
+    // Tile (L1) -> Tile (L2) messages for the exclusive hierarchy
+    // Note: L2WT is a write-through of a block the L1 holds (and
+    //       brings it back if the L2 gave it up), L2VICT carries an
+    //       L1 victim back down
+    L2WT,
+    L2VICT,
+
+    // Write-back L1 messages
+    // Note: L1RECALL asks the L1 that owns a block for its dirty data
+    //       (Tile (L2) -> Tile (L1)), L1WB carries a dirty L1 victim
+    //       back to its home slice (Tile (L1) -> Tile (L2))
+    L1RECALL,
+    L1WB,
+
+    // Eviction notices (Tile (L2 CCSM) -> Dir)
+    // Note: only sent with evictnotify=on. PUTS drops a clean copy,
+    //       PUTM a dirty one (its data goes to memory as a write back)
+    PUTS,
+    PUTM,
+
+    // Dir -> Tile (L2) message for the coarse directory
+    // Note: asks the home tile of a region's owner whether it still
+    //       has a block when the region becomes shared
+    PROBE,
 };
 
 
@@ -51,20 +111,64 @@ private:
     Tile ** tiles;
     Dir  *  dir;
 
+    // Topology. Tiles are numbered row major on a TOPOWIDTH x
+    // TOPOHEIGHT grid. Groups of cw x ch tiles share a router and
+    // the routers form an rw x rh grid (with wraparound links for
+    // the torus and ring).
+    int cw, ch;
+    int rw, rh;
+    int wrap;
+    int * router;      // [NPROCS] router of each tile
+    int * ctrltile;    // [NUMMEMCTRLS] tile each controller hangs off of
+
+    // Precomputed hop counts
+    ushort * tilehops; // [NPROCS][NPROCS]
+    ushort * ctrlhops; // [NUMMEMCTRLS][NPROCS]
+
+    // State for the mesh contention model
+    ResTable * links;  // Reservation table with one entry per link
+    ulong * qdelay;    // [NPROCS] queuing cycles seen on behalf of each tile
+    ulong * netmsgs;   // [NPROCS] messages sent on behalf of each tile
+
+    // Traffic into and out of each memory controller
+    ulong * ctrlmsgs;  // [NUMMEMCTRLS] messages
+    ulong * ctrlflits; // [NUMMEMCTRLS] flits
+    ulong * ctrlhopsum;// [NUMMEMCTRLS] hops travelled by those messages
+
+    void  buildTopology();
+    void  placeCtrls();
+    ulong routerHops(int r0, int r1);
+    int   nextLink(int cur, int dst, int *next);
+
 public:
+    // Every message (and its flits) sent so far
+    ulong totalmsgs;
+    ulong totalflits;
+
     Net(Dir * dirr, Tile ** tiless);
     ~Net();
+    ulong msgDelay(ulong fromnode, ulong tonode, ulong flits);
+    ulong routeMesh(ulong fromnode, ulong tonode, ulong flits);
+    ulong linkId(int router, int dir);
+    ulong ctrlLinkId(int ctrl, int in);
+    ulong dirNode(ulong addr);
+    void  PrintStats(int tabular);
+    void  PrintCtrlStats(int tabular);
+
     ulong sendReqTileToTile(ulong msg, ulong addr, ulong fromtile, ulong totile);
     ulong sendReqDirToTile( ulong msg, ulong addr, ulong totile);
     ulong sendReqTileToDir( ulong msg, ulong addr, ulong fromtile);
+    ulong sendDataTileToTile(ulong msg, ulong addr, ulong fromtile, ulong totile);
 
     ulong fakeReqDirToTile(ulong addr, ulong totile);
+    ulong fakeReqTileToDir(ulong addr, ulong fromtile);
     ulong fakeDataTileToTile(ulong fromtile, ulong totile);
     ulong fakeDataDirToTile(ulong addr, ulong totile);
     ulong flushToMem(ulong addr, ulong fromtile);
+    ulong writeBackToMem(ulong addr, ulong fromtile);
     ulong calcTileToDirHops(ulong addr, ulong tile);
+    ulong calcDirToTileHops(ulong dirnum, ulong tile);
     ulong calcTileToTileHops(ulong fromtile, ulong totile);
-    ulong calcDistance(int x0, int x1, int y0, int y1);
 };
 
 #endif
@@ -0,0 +1,399 @@
+/*
+ * Dusty Mabe - 2014
+ * Nuca.cc - Implementation of the L2 placement policies.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "Nuca.h"
+#include "Tile.h"
+#include "Net.h"
+#include "params.h"
+#include "Delay.h"
+
+// Global NETWORK is defined in simulator.cc
+extern Net *NETWORK;
+
+// L2 placement policy (defined in simulator.cc)
+extern ulong PLACEMENT;
+
+// Move hot blocks to the slice of the tile that uses them (0 or 1)
+extern ulong MIGRATE;
+
+// Pages in the 32 bit address space
+#define NUCAPAGES (1UL << (32 - PAGEBITS))
+
+Nuca::Nuca(Tile **t) {
+
+    assert(NPROCS < NUCASHARED);
+
+    tiles = t;
+    memset(pages, 0, sizeof(pages));
+    memset(remap, 0, sizeof(remap));
+    miglru = 0;
+
+    touched = shared = moves = blocksmoved = 0;
+    migrations = migrehomes = movebacks = 0;
+    migmsgs = migflits = migcycles = 0;
+}
+
+Nuca::~Nuca() {
+    int i;
+    for (i=0; i < NPROCS; i++) {
+        delete [] pages[i];
+        delete [] remap[i];
+    }
+}
+
+/*
+ * Nuca::pageTable
+ *     - Get the page table of partition partid, allocating it the
+ *       first time.
+ */
+ushort *Nuca::pageTable(int partid) {
+    if (pages[partid] == NULL) {
+        pages[partid] = new ushort[NUCAPAGES];
+        assert(pages[partid]);
+        memset(pages[partid], 0xff, NUCAPAGES * sizeof(ushort));
+    }
+    return pages[partid];
+}
+
+/*
+ * Nuca::touch
+ *     - tile (of partition partid) is about to use the block
+ *       containing addr. Record the first tile to touch the page and
+ *       whether any other tile has touched it since. Under rnuca the
+ *       first touch by a second tile makes the page shared and the
+ *       blocks of it that the first tile's slice holds are evicted.
+ */
+void Nuca::touch(ulong addr, int tile, int partid) {
+
+    ushort *pt;
+    ulong page = addr >> PAGEBITS;
+    int first;
+
+    if (PLACEMENT != PLACEFIRST && PLACEMENT != PLACERNUCA)
+        return;
+
+    pt = pageTable(partid);
+
+    if (pt[page] == NUCANONE) {
+        pt[page] = tile;
+        touched++;
+        return;
+    }
+
+    first = pt[page] & ~NUCASHARED;
+    if ((pt[page] & NUCASHARED) || first == tile)
+        return;
+
+    pt[page] |= NUCASHARED;
+    shared++;
+
+    if (PLACEMENT == PLACERNUCA) {
+        moves++;
+        blocksmoved += tiles[first]->evictPage(page);
+    }
+}
+
+/*
+ * Nuca::home
+ *     - Map the block containing addr to its home tile within the
+ *       partition partid (whose ntiles tiles are in ptiles). A block
+ *       that migrated is wherever the remap table says.
+ */
+int Nuca::home(ulong addr, int partid, int ntiles, int *ptiles) {
+
+    MigEntry *e;
+
+    if (MIGRATE && (e = findRemap(addr, partid)))
+        return e->tile;
+
+    return placeHome(addr, partid, ntiles, ptiles);
+}
+
+/*
+ * Nuca::placeHome
+ *     - Map the block containing addr to the home tile the placement
+ *       policy gives it within the partition partid.
+ */
+int Nuca::placeHome(ulong addr, int partid, int ntiles, int *ptiles) {
+
+    ushort h;
+    ulong page;
+
+    switch (PLACEMENT) {
+        // Fold higher page bits in (like ADDRHASH does for blocks)
+        // so that a slice doesn't only get pages whose low bits, and
+        // so its set index bits, are the same
+        case PLACEPAGE:
+            page = addr >> PAGEBITS;
+            return ptiles[((page >> INDEXBITS) ^ page) % ntiles];
+
+        case PLACEFIRST:
+        case PLACERNUCA:
+            h = pages[partid] ? pages[partid][addr >> PAGEBITS] : NUCANONE;
+            if (h == NUCANONE)
+                break;
+            if (PLACEMENT == PLACEFIRST)
+                return h & ~NUCASHARED;
+            if (!(h & NUCASHARED))
+                return h;
+            break;
+
+        default:
+            break;
+    }
+
+    // Since the tiles logically share L2 the blocks are
+    // interleaved among the tiles. Find the tile offset
+    // within the partition.
+    return ptiles[ADDRHASH(addr) % ntiles];
+}
+
+/*
+ * Nuca::findRemap
+ *     - Find the remap table entry of partition partid for the
+ *       block containing addr.
+ *
+ * Returns the entry or NULL if the block hasn't migrated.
+ */
+MigEntry *Nuca::findRemap(ulong addr, int partid) {
+
+    MigEntry *set;
+    ulong blk = BLKADDR(addr);
+    int j;
+
+    if (remap[partid] == NULL)
+        return NULL;
+
+    set = &remap[partid][(blk % MIGSETS) * MIGWAYS];
+    for (j=0; j < MIGWAYS; j++)
+        if (set[j].tile >= 0 && set[j].blk == blk)
+            return &set[j];
+
+    return NULL;
+}
+
+/*
+ * Nuca::newRemap
+ *     - Get a remap table entry of partition partid (whose ntiles
+ *       tiles are in ptiles) for the block containing addr: a free
+ *       one of its set or else the LRU one. The block of an entry
+ *       that is taken goes back to its place.
+ */
+MigEntry *Nuca::newRemap(ulong addr, int partid, int ntiles, int *ptiles) {
+
+    MigEntry *set, *e = NULL;
+    ulong blk = BLKADDR(addr);
+    int j;
+
+    if (remap[partid] == NULL) {
+        remap[partid] = new MigEntry[MIGSETS * MIGWAYS];
+        assert(remap[partid]);
+        for (j=0; j < MIGSETS * MIGWAYS; j++)
+            remap[partid][j].tile = -1;
+    }
+
+    set = &remap[partid][(blk % MIGSETS) * MIGWAYS];
+    for (j=0; j < MIGWAYS && !(e && e->tile < 0); j++)
+        if (!e || set[j].tile < 0 || set[j].lru < e->lru)
+            e = &set[j];
+
+    if (e->tile >= 0) {
+        if (moveBlock(e->blk << OFFSETBITS, e->tile,
+                      placeHome(e->blk << OFFSETBITS, partid, ntiles, ptiles)))
+            movebacks++;
+        e->tile = -1;
+    }
+
+    e->blk = blk;
+    e->lru = ++miglru;
+    return e;
+}
+
+/*
+ * Nuca::moveBlock
+ *     - Move the block containing addr from the L2 slice of tile
+ *       from to that of tile to. Nobody waits for this.
+ *
+ * Returns 1 if from had the block.
+ */
+int Nuca::moveBlock(ulong addr, int from, int to) {
+
+    ulong msgs, flits;
+    DelayScope saved;
+
+    if (from == to || !tiles[from]->hasL2Line(addr))
+        return 0;
+
+    msgs  = NETWORK->totalmsgs;
+    flits = NETWORK->totalflits;
+
+    migcycles += NETWORK->fakeDataTileToTile(from, to);
+    tiles[from]->moveL2Line(addr, tiles[to]);
+
+    migmsgs  += NETWORK->totalmsgs  - msgs;
+    migflits += NETWORK->totalflits - flits;
+
+    return 1;
+}
+
+/*
+ * Nuca::access
+ *     - Hot-block migration: tile (of partition partid, whose ntiles
+ *       tiles are in ptiles) has asked home for the block containing
+ *       addr. Count the request toward the block's affinity and if
+ *       another tile now dominates it move the block to that tile.
+ */
+void Nuca::access(ulong addr, int tile, int home, int partid,
+                  int ntiles, int *ptiles) {
+
+    MigEntry *e;
+    int to;
+
+    if ((e = findRemap(addr, partid)))
+        e->lru = ++miglru;
+
+    to = tiles[home]->affinity(addr, tile);
+    if (to < 0 || to == home)
+        return;
+
+    // Going back to where the policy puts it needs no entry
+    if (to == placeHome(addr, partid, ntiles, ptiles)) {
+        if (e && moveBlock(addr, home, to)) {
+            e->tile = -1;
+            migrations++;
+            migrehomes++;
+        }
+        return;
+    }
+
+    // Taking an entry can move another block into the slice and push
+    // ours out, then there is nothing to move
+    if (!e)
+        e = newRemap(addr, partid, ntiles, ptiles);
+    if (moveBlock(addr, home, to)) {
+        e->tile = to;
+        migrations++;
+    }
+}
+
+/*
+ * Nuca::clear
+ *     - Forget every page and migrated block. Used after all of the
+ *       caches have been flushed for a repartition since the tables
+ *       are per partition.
+ */
+void Nuca::clear() {
+    int i;
+    for (i=0; i < NPROCS; i++) {
+        delete [] pages[i];
+        pages[i] = NULL;
+        delete [] remap[i];
+        remap[i] = NULL;
+    }
+}
+
+/*
+ * Nuca::PrintStats
+ *     - Print a row per tile of how many L2 accesses found their
+ *       home in the tile's own slice and how far away the home was
+ *       on average. Then the totals and the page counts.
+ */
+void Nuca::PrintStats(int tabular) {
+
+    ulong i, acc = 0, local = 0, hops = 0, loc = 0, ctoc = 0;
+    const char *name = (PLACEMENT == PLACEPAGE)  ? "page"  :
+                       (PLACEMENT == PLACEFIRST) ? "first" :
+                       (PLACEMENT == PLACERNUCA) ? "rnuca" : "hash";
+
+    if (!tabular)
+        printf("===== L2 placement (%s) ===========================\n", name);
+    printf("%15s%15s%15s%15s%15s%15s%15s\n",
+           "tile", "l2accesses", "homelocal", "localshare",
+           "avghomehops", "locxfer", "ctocxfer");
+
+    for (i=0; i <= NPROCS; i++) {
+        if (i < NPROCS) {
+            printf("%15lu%15u%15lu%15f%15f%15u%15u\n", i,
+                   tiles[i]->l2accesses, tiles[i]->homelocal,
+                   tiles[i]->l2accesses ?
+                       ((float)tiles[i]->homelocal / (float)tiles[i]->l2accesses) : 0.0,
+                   tiles[i]->l2accesses ?
+                       ((float)tiles[i]->homehops / (float)tiles[i]->l2accesses) : 0.0,
+                   tiles[i]->locxfer, tiles[i]->ctocxfer);
+            acc   += tiles[i]->l2accesses;
+            local += tiles[i]->homelocal;
+            hops  += tiles[i]->homehops;
+            loc   += tiles[i]->locxfer;
+            ctoc  += tiles[i]->ctocxfer;
+        } else {
+            printf("%15s%15lu%15lu%15f%15f%15lu%15lu\n", "all", acc, local,
+                   acc ? ((float)local / (float)acc) : 0.0,
+                   acc ? ((float)hops  / (float)acc) : 0.0,
+                   loc, ctoc);
+        }
+    }
+
+    if (tabular) {
+        printf("%15s%15s%15s%15s%15s\n",
+               "placement", "pages", "sharedpages", "pagemoves", "blocksmoved");
+        printf("%15s%15lu%15lu%15lu%15lu\n",
+               name, touched, shared, moves, blocksmoved);
+    } else {
+        printf("Pages touched %lu (%lu by more than one tile), "
+               "pages moved %lu (%lu blocks evicted)\n",
+               touched, shared, moves, blocksmoved);
+    }
+}
+
+/*
+ * Nuca::PrintMigStats
+ *     - Print what hot-block migration bought, the remote (ctoc) L2
+ *       hits and their delay next to the local ones, and what it
+ *       cost: the moves and their network traffic.
+ */
+void Nuca::PrintMigStats(int tabular) {
+
+    ulong i, j, loc = 0, locd = 0, ctoc = 0, ctocd = 0, entries = 0;
+
+    for (i=0; i < NPROCS; i++) {
+        loc   += tiles[i]->locxfer;
+        locd  += tiles[i]->locdelay;
+        ctoc  += tiles[i]->ctocxfer;
+        ctocd += tiles[i]->ctocdelay;
+        for (j=0; remap[i] && j < MIGSETS * MIGWAYS; j++)
+            if (remap[i][j].tile >= 0)
+                entries++;
+    }
+
+    if (tabular) {
+        printf("%15s%15s%15s%15s%15s%15s\n",
+               "locxfer", "avglocdelay", "ctocxfer", "ctocdelay",
+               "avgctocdelay", "remapentries");
+        printf("%15lu%15f%15lu%15lu%15f%15lu\n",
+               loc, loc ? ((float)locd / (float)loc) : 0.0,
+               ctoc, ctocd, ctoc ? ((float)ctocd / (float)ctoc) : 0.0,
+               entries);
+        printf("%15s%15s%15s%15s%15s%15s\n",
+               "migrations", "rehomed", "movebacks", "migmsgs",
+               "migflits", "migcycles");
+        printf("%15lu%15lu%15lu%15lu%15lu%15lu\n",
+               migrations, migrehomes, movebacks, migmsgs, migflits,
+               migcycles);
+    } else {
+        printf("===== Hot-block migration =========================\n");
+        printf("Local L2 hits %lu (avg delay %f), remote %lu "
+               "(delay %lu, avg %f), remap entries in use %lu\n",
+               loc, loc ? ((float)locd / (float)loc) : 0.0,
+               ctoc, ctocd, ctoc ? ((float)ctocd / (float)ctoc) : 0.0,
+               entries);
+        printf("Blocks migrated %lu (%lu back to their place), "
+               "moved back %lu, traffic %lu msgs %lu flits %lu cycles\n",
+               migrations, migrehomes, movebacks, migmsgs, migflits,
+               migcycles);
+    }
+}
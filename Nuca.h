@@ -0,0 +1,101 @@
+/*
+ * Dusty Mabe - 2014
+ * Nuca.h - Header file for the L2 placement policies. The tiles of a
+ *          partition share their L2 slices and the policy picks the
+ *          home slice of each block. The default scatters the blocks
+ *          with ADDRHASH. The others work on pages so that data one
+ *          tile uses can live in that tile's own slice:
+ *
+ *          page  - pages are interleaved across the partition
+ *          first - a page lives in the slice of the first tile of the
+ *                  partition that touches it
+ *          rnuca - like first while only one tile of the partition
+ *                  touches the page (it is private). Once another
+ *                  tile touches it the page is shared and its blocks
+ *                  are interleaved with ADDRHASH. The blocks the
+ *                  first tile's slice holds are evicted so they can
+ *                  move to their new homes.
+ *
+ *          A page table per partition remembers the first tile to
+ *          touch each page and whether another tile touched it too.
+ *          Lookups of pages the partition never touched fall back to
+ *          ADDRHASH (none of its slices can have the block).
+ *
+ *          With migrate=on (under any policy) a block that one tile
+ *          asks its home for far more than the others moves to that
+ *          tile's slice. Each home line has a saturating affinity
+ *          counter. The blocks that moved are found in a small set
+ *          associative remap table per partition that overrides the
+ *          policy. A block whose entry is displaced goes back to
+ *          where the policy puts it.
+ */
+#ifndef NUCA_H
+#define NUCA_H
+
+#include "types.h"
+#include "params.h"
+
+class Tile; // Forward Declaration
+
+// L2 placement policies (selected with place=<policy>)
+enum {
+    PLACEHASH = 0, // Blocks interleaved with ADDRHASH
+    PLACEPAGE,     // Pages interleaved across the partition
+    PLACEFIRST,    // Pages homed at the first tile to touch them
+    PLACERNUCA,    // Private pages at their tile, shared ones hashed
+};
+
+// Page table entries
+#define NUCANONE   0xffff // The partition hasn't touched the page
+#define NUCASHARED 0x8000 // Set once a second tile touches the page
+
+// Remap table entry for a block that migrated (migrate=on)
+struct MigEntry {
+    ulong blk;  // Block address
+    int   tile; // Its home now (-1 if the entry is free)
+    ulong lru;  // Last access, for replacement
+};
+
+class Nuca {
+private:
+    Tile ** tiles;
+    ushort * pages[NPROCS]; // [partition][page] first tile to touch
+                            // the page (NULL until used)
+    MigEntry * remap[NPROCS]; // [partition][set * MIGWAYS + way]
+                              // (NULL until used)
+    ulong miglru;
+
+    ushort * pageTable(int partid);
+    int  placeHome(ulong addr, int partid, int ntiles, int *ptiles);
+    MigEntry * findRemap(ulong addr, int partid);
+    MigEntry * newRemap(ulong addr, int partid, int ntiles, int *ptiles);
+    int  moveBlock(ulong addr, int from, int to);
+
+public:
+    // Counters
+    ulong touched;      // Pages touched (per partition)
+    ulong shared;       // ... that a second tile touched too
+    ulong moves;        // Pages whose blocks moved (rnuca)
+    ulong blocksmoved;  // Blocks evicted from the first tile's slice
+
+    // Hot-block migration counters
+    ulong migrations;   // Blocks moved to a tile that dominates them
+    ulong migrehomes;   // ... of them back to where the policy puts them
+    ulong movebacks;    // Blocks sent back since their entry was displaced
+    ulong migmsgs;      // Network messages and flits the moves took
+    ulong migflits;
+    ulong migcycles;    // Network cycles of the moves (nobody waits)
+
+    Nuca(Tile **t);
+    ~Nuca();
+
+    void touch(ulong addr, int tile, int partid);
+    int  home(ulong addr, int partid, int ntiles, int *ptiles);
+    void access(ulong addr, int tile, int home, int partid,
+                int ntiles, int *ptiles);
+    void clear();
+    void PrintStats(int tabular);
+    void PrintMigStats(int tabular);
+};
+
+#endif
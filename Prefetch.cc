@@ -0,0 +1,266 @@
+/*
+ * Dusty Mabe - 2014
+ * Prefetch.cc - Implementation of the L2 hardware prefetchers.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "Prefetch.h"
+#include "params.h"
+
+// Prefetch policy, degree and distance (defined in simulator.cc)
+extern ulong PREFETCH;
+extern ulong PFDEG;
+extern ulong PFDIST;
+
+Prefetcher::Prefetcher(ulong p, ulong deg, ulong dist) {
+
+    assert(deg >= 1 && deg <= PFMAXDEGREE);
+
+    policy   = p;
+    degree   = deg;
+    distance = dist;
+    seq      = 0;
+
+    memset(stride, 0, sizeof(stride));
+    memset(stream, 0, sizeof(stream));
+
+    triggers = issued = dropped = msgs = flits = 0;
+}
+
+/*
+ * Prefetcher::train
+ *     - Show the prefetcher a trigger (an L2 miss or the first hit
+ *       on a prefetched line) for block blk. The blocks it wants to
+ *       prefetch are put in cands (room for PFMAXDEGREE).
+ *
+ * Returns the number of blocks in cands.
+ */
+int Prefetcher::train(ulong blk, ulong *cands) {
+
+    int i, j, n;
+
+    triggers++;
+    seq++;
+
+    switch (policy) {
+        case PFNEXT:
+            n = nextLine(blk, cands);
+            break;
+        case PFSTRIDE:
+            n = strideTrain(blk, cands);
+            break;
+        case PFSTREAM:
+            n = streamTrain(blk, cands);
+            break;
+        default:
+            return 0;
+    }
+
+    // Drop blocks that fell off either end of memory
+    for (i=0, j=0; i < n; i++)
+        if (cands[i] < NUMBLOCKS)
+            cands[j++] = cands[i];
+
+    return j;
+}
+
+/*
+ * Prefetcher::nextLine
+ *     - Prefetch the degree blocks that start distance blocks
+ *       past the trigger.
+ */
+int Prefetcher::nextLine(ulong blk, ulong *cands) {
+    ulong i;
+    for (i=0; i < degree; i++)
+        cands[i] = blk + distance + i;
+    return degree;
+}
+
+/*
+ * Prefetcher::strideTrain
+ *     - Track the delta between consecutive triggers in the same
+ *       region (page). Once a delta has repeated PFSTRIDECONF times
+ *       prefetch degree blocks along it, starting distance strides
+ *       ahead. No PCs are available in the trace so the region
+ *       stands in for the instruction.
+ */
+int Prefetcher::strideTrain(ulong blk, ulong *cands) {
+
+    ulong i, victim = 0;
+    long delta;
+    StrideEntry *e = NULL;
+    ulong region = blk >> (PAGEBITS - OFFSETBITS);
+
+    for (i=0; i < PFSTRIDEENTRIES; i++) {
+        if (stride[i].seq && stride[i].region == region) {
+            e = &stride[i];
+            break;
+        }
+        if (stride[i].seq < stride[victim].seq)
+            victim = i;
+    }
+
+    // New region. Start tracking it in the LRU entry.
+    if (!e) {
+        e = &stride[victim];
+        e->region = region;
+        e->last   = blk;
+        e->stride = 0;
+        e->conf   = 0;
+        e->seq    = seq;
+        return 0;
+    }
+
+    e->seq = seq;
+    delta  = (long)(blk - e->last);
+    if (delta == 0)
+        return 0;
+
+    if (delta == e->stride) {
+        e->conf = MIN(e->conf + 1, PFSTRIDEMAXCONF);
+    } else {
+        e->stride = delta;
+        e->conf   = 0;
+    }
+    e->last = blk;
+
+    if (e->conf < PFSTRIDECONF)
+        return 0;
+
+    for (i=0; i < degree; i++)
+        cands[i] = blk + e->stride * (long)(distance + i);
+    return degree;
+}
+
+/*
+ * Prefetcher::streamTrain
+ *     - A trigger within PFSTREAMWINDOW blocks of a stream's last
+ *       trigger joins the stream. The second trigger sets the
+ *       direction and from then on the stream's head is kept
+ *       distance + degree - 1 blocks ahead of the latest trigger,
+ *       issuing at most degree new blocks each time. Anything else
+ *       starts a new stream in the LRU buffer.
+ */
+int Prefetcher::streamTrain(ulong blk, ulong *cands) {
+
+    ulong i, victim = 0;
+    long gap, target;
+    int dir, n = 0;
+    StreamEntry *e = NULL;
+
+    for (i=0; i < PFSTREAMS; i++) {
+        gap = (long)(blk - stream[i].last);
+        if (stream[i].seq && gap >= -PFSTREAMWINDOW && gap <= PFSTREAMWINDOW) {
+            e = &stream[i];
+            break;
+        }
+        if (stream[i].seq < stream[victim].seq)
+            victim = i;
+    }
+
+    if (!e) {
+        e = &stream[victim];
+        e->last = blk;
+        e->head = blk;
+        e->dir  = 0;
+        e->seq  = seq;
+        return 0;
+    }
+
+    e->seq = seq;
+    if (blk == e->last)
+        return 0;
+
+    // Learn (or relearn) the direction of the stream
+    dir = (blk > e->last) ? 1 : -1;
+    if (dir != e->dir) {
+        e->dir  = dir;
+        e->head = blk;
+    }
+    e->last = blk;
+
+    // Never prefetch behind the requested distance
+    if ((long)(e->head - blk) * dir < (long)distance - 1)
+        e->head = blk + dir * ((long)distance - 1);
+
+    target = (long)blk + dir * (long)(distance + degree - 1);
+    while ((target - (long)e->head) * dir > 0 && n < (long)degree) {
+        e->head += dir;
+        cands[n++] = e->head;
+    }
+    return n;
+}
+
+/*
+ * Prefetcher::addStats
+ *     - Add the counters in s to sum.
+ */
+void Prefetcher::addStats(PFStats *sum, PFStats *s) {
+    sum->issued     += s->issued;
+    sum->dropped    += s->dropped;
+    sum->msgs       += s->msgs;
+    sum->flits      += s->flits;
+    sum->fills      += s->fills;
+    sum->memfills   += s->memfills;
+    sum->useful     += s->useful;
+    sum->late       += s->late;
+    sum->latecycles += s->latecycles;
+    sum->useless    += s->useless;
+    sum->misses     += s->misses;
+}
+
+/*
+ * Prefetcher::PrintStatsTabular
+ *     - Print a row (or the header) of prefetch stats. A negative
+ *       tile prints the totals row.
+ */
+void Prefetcher::PrintStatsTabular(int printhead, long tile, PFStats *s) {
+
+    if (printhead) {
+        printf("%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s\n",
+               "tile", "pfissued", "pfdropped", "pffills", "pfmemfills",
+               "pfuseful", "pflate", "pfuseless", "accuracy", "coverage",
+               "avglatewait", "pfflits");
+        return;
+    }
+
+    if (tile < 0)
+        printf("%15s", "all");
+    else
+        printf("%15lu", tile);
+
+    printf("%15lu%15lu%15lu%15lu%15lu%15lu%15lu%15f%15f%15f%15lu\n",
+           s->issued, s->dropped, s->fills, s->memfills,
+           s->useful, s->late, s->useless,
+           s->fills ? ((float)s->useful / (float)s->fills) : 0.0,
+           (s->useful + s->misses) ?
+               ((float)s->useful / (float)(s->useful + s->misses)) : 0.0,
+           s->late ? ((float)s->latecycles / (float)s->late) : 0.0,
+           s->flits);
+}
+
+/*
+ * Prefetcher::PrintSummary
+ *     - Print the prefetch settings and the share of all network
+ *       flits the prefetches caused.
+ */
+void Prefetcher::PrintSummary(int tabular, PFStats *s, ulong netflits) {
+
+    const char *name = (PREFETCH == PFNEXT)   ? "next"   :
+                       (PREFETCH == PFSTRIDE) ? "stride" : "stream";
+    float share = netflits ? ((float)s->flits / (float)netflits) : 0.0;
+
+    if (tabular) {
+        printf("%15s%15s%15s%15s%15s\n",
+               "prefetch", "pfdegree", "pfdistance", "pfmsgs", "pfflitshare");
+        printf("%15s%15lu%15lu%15lu%15f\n",
+               name, PFDEG, PFDIST, s->msgs, share);
+    } else {
+        printf("prefetcher:                     %s (degree %lu, distance %lu)\n",
+               name, PFDEG, PFDIST);
+        printf("prefetch messages:              %lu\n", s->msgs);
+        printf("share of network flits:         %f\n", share);
+    }
+}
@@ -0,0 +1,94 @@
+/*
+ * Dusty Mabe - 2014
+ * Prefetch.h - Header file for the L2 hardware prefetchers. Each tile
+ *              has one that watches the tile's L2 misses (and its
+ *              first hits on prefetched lines) and predicts the blocks
+ *              it will want next. The predicted blocks are filled into
+ *              their home L2 slices through the normal directory
+ *              protocol, off the critical path of the demand access.
+ *
+ *              A prefetch is late if a demand access reaches the line
+ *              before its data does. That compares the clocks of two
+ *              tiles, so the late counts only mean much with
+ *              order=time.
+ */
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include "types.h"
+#include "params.h"
+
+// Prefetch policies (selected with prefetch=<policy>)
+enum {
+    PFNONE = 0, // No prefetching
+    PFNEXT,     // Next N lines after every trigger
+    PFSTRIDE,   // Constant address deltas within a region
+    PFSTREAM,   // Stream buffers that run ahead of ascending or
+                // descending runs of misses
+};
+
+// One region of the stride prefetcher's table
+struct StrideEntry {
+    ulong region;  // Block address >> (PAGEBITS - OFFSETBITS)
+    ulong last;    // Last block seen in the region
+    long  stride;  // Last delta seen
+    int   conf;    // Times in a row the delta repeated
+    ulong seq;     // For LRU replacement (0 if unused)
+};
+
+// One stream buffer of the stream prefetcher
+struct StreamEntry {
+    ulong last;    // Last miss that joined the stream
+    ulong head;    // Furthest block prefetched so far
+    int   dir;     // +1 ascending, -1 descending, 0 not known yet
+    ulong seq;     // For LRU replacement (0 if unused)
+};
+
+// Everything the prefetch tables report for one tile (or all tiles).
+// The issue side is counted by the tile's prefetcher and the outcome
+// side by the tile's L2 slice (the home of the prefetched blocks).
+struct PFStats {
+    ulong issued;      // Prefetches sent to a home slice
+    ulong dropped;     // ... that found the block already there
+    ulong msgs;        // Network messages caused by prefetches
+    ulong flits;       // Network flits caused by prefetches
+    ulong fills;       // Lines brought into the slice by a prefetch
+    ulong memfills;    // ... that had to go to memory
+    ulong useful;      // Prefetched lines later hit by a demand access
+    ulong late;        // ... before the fill had arrived
+    ulong latecycles;  // Cycles demand accesses waited on late fills
+    ulong useless;     // Prefetched lines evicted or invalidated unused
+    ulong misses;      // Demand misses left in the slice
+};
+
+class Prefetcher {
+private:
+    ulong policy;
+    ulong degree;      // Blocks prefetched per trigger
+    ulong distance;    // How far ahead of the trigger to start
+    ulong seq;         // LRU counter for the tables
+
+    StrideEntry stride[PFSTRIDEENTRIES];
+    StreamEntry stream[PFSTREAMS];
+
+    int nextLine(ulong blk, ulong *cands);
+    int strideTrain(ulong blk, ulong *cands);
+    int streamTrain(ulong blk, ulong *cands);
+
+public:
+    // Counters
+    ulong triggers;    // Misses and prefetch hits the tables saw
+    ulong issued;
+    ulong dropped;
+    ulong msgs;
+    ulong flits;
+
+    Prefetcher(ulong p, ulong deg, ulong dist);
+
+    int  train(ulong blk, ulong *cands);
+    static void addStats(PFStats *sum, PFStats *s);
+    static void PrintStatsTabular(int printhead, long tile, PFStats *s);
+    static void PrintSummary(int tabular, PFStats *s, ulong netflits);
+};
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ * Dusty Mabe - 2014
+ * Prof.cc - Implementation of the simulator's profile of itself.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include "Prof.h"
+#include "Trace.h"
+#include "Stats.h"
+
+Prof::Prof(int time, ulong secs) {
+
+    trace    = NULL;
+    ahead    = NULL;
+    timing   = time;
+    progress = secs;
+    sampled  = 0;
+    gap      = 1;
+    seed     = 1;
+    dirdepth = 0;
+    accesses = samples = 0;
+    wall     = 0.0;
+    start    = lastprog = mark = dirmark = clockcost = 0.0;
+
+    memset(calls, 0, sizeof(calls));
+    memset(phases, 0, sizeof(phases));
+}
+
+/*
+ * Prof::begin
+ *     - Called just before the first access of trace t. buffered
+ *       (NULL if none) counts the references a scheduler has read
+ *       ahead of the simulation. Measures the cost of a clock read
+ *       and starts the wall clock. The first access is a sample.
+ */
+void Prof::begin(Trace *t, ulong *buffered) {
+    int i;
+
+    trace = t;
+    ahead = buffered;
+    start = now();
+    for (i=0; i < PROFCALIBRATE; i++)
+        now();
+    lastprog  = now();
+    clockcost = (lastprog - start) / (PROFCALIBRATE + 1);
+    start     = lastprog;
+    if (timing)
+        nextSample();
+}
+
+/*
+ * Prof::now
+ *     - Seconds on the monotonic clock.
+ */
+double Prof::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Prof::nextSample
+ *     - The next access is a sample. Pick the gap to the one after
+ *       (1 to 2 * PROFSAMPLE - 1 accesses, PROFSAMPLE on average).
+ */
+void Prof::nextSample() {
+    seed    = seed * 1103515245 + 12345;
+    gap     = 1 + (seed >> 16) % (2 * PROFSAMPLE - 1);
+    sampled = 1;
+    mark    = now();
+}
+
+/*
+ * Prof::showProgress
+ *     - Write a progress line to stderr if it is time for one. The
+ *       ETA assumes the rest of the trace goes as fast as it has so
+ *       far. Of what has been read of the trace only the part that
+ *       was simulated is done.
+ */
+void Prof::showProgress() {
+
+    double t = now();
+    double elapsed = t - start;
+    double done = trace->progress();
+
+    if (ahead && accesses)
+        done *= (double)accesses / (double)(accesses + *ahead);
+
+    if (t - lastprog < progress && done < 1.0)
+        return;
+    lastprog = t;
+
+    fprintf(stderr, "progress: %5.1f%% %lu accesses %.0f acc/s "
+                    "elapsed %.1fs eta %.1fs\n",
+            done * 100.0, accesses, elapsed ? (accesses / elapsed) : 0.0,
+            elapsed, (done > 0.0) ? (elapsed * (1.0 - done) / done) : 0.0);
+}
+
+/*
+ * Prof::finish
+ *     - Called when the trace has run out. Stops the wall clock
+ *       (and writes the last progress line).
+ */
+void Prof::finish() {
+    wall = now() - start;
+    if (progress) {
+        lastprog = 0.0;
+        showProgress();
+    }
+}
+
+/*
+ * Prof::getStats
+ *     - Put the profile in t (one row). The phase times are the
+ *       sampled times scaled up to all accesses.
+ */
+void Prof::getStats(StatTable *t) {
+
+    double scale = samples ? ((double)accesses / (double)samples) : 0.0;
+
+    t->row();
+    t->real("walltime",     wall);
+    t->count("accesses",    accesses);
+    t->real("accpersec",    wall ? (accesses / wall) : 0.0);
+    t->count("samples",     samples);
+    t->real("tracesecs",    phases[PHASETRACE] * scale);
+    t->real("accesssecs",   (phases[PHASEACCESS] - phases[PHASEDIR]) * scale);
+    t->real("dirsecs",      phases[PHASEDIR] * scale);
+    t->real("othersecs",    phases[PHASEOTHER] * scale);
+    t->count("findLine",    calls[PROFFINDLINE]);
+    t->count("getLRU",      calls[PROFGETLRU]);
+    t->count("broadcasts",  calls[PROFBROADCAST]);
+    t->count("invsharers",  calls[PROFINVSHARERS]);
+}
+
+/*
+ * Prof::PrintStats
+ *     - Print the throughput, where the time went and the hot path
+ *       call counts.
+ */
+void Prof::PrintStats(int tabular) {
+
+    double scale = samples ? ((double)accesses / (double)samples) : 0.0;
+    double tr  = phases[PHASETRACE] * scale;
+    double acc = (phases[PHASEACCESS] - phases[PHASEDIR]) * scale;
+    double dr  = phases[PHASEDIR] * scale;
+    double oth = phases[PHASEOTHER] * scale;
+
+    if (!tabular)
+        printf("===== Simulator profile ===========================\n");
+
+    if (tabular) {
+        printf("%15s%15s%15s%15s%15s%15s%15s%15s\n",
+               "walltime", "accesses", "accpersec", "samples",
+               "tracesecs", "accesssecs", "dirsecs", "othersecs");
+        printf("%15f%15lu%15f%15lu%15f%15f%15f%15f\n",
+               wall, accesses, wall ? (accesses / wall) : 0.0, samples,
+               tr, acc, dr, oth);
+        printf("%15s%15s%15s%15s\n",
+               "findLine", "getLRU", "broadcasts", "invsharers");
+        printf("%15lu%15lu%15lu%15lu\n",
+               calls[PROFFINDLINE], calls[PROFGETLRU],
+               calls[PROFBROADCAST], calls[PROFINVSHARERS]);
+    } else {
+        printf("Simulated %lu accesses in %f seconds (%.0f accesses/s)\n",
+               accesses, wall, wall ? (accesses / wall) : 0.0);
+        printf("Trace %fs, Tile::Access %fs, directory %fs, other %fs "
+               "(from %lu timed accesses)\n", tr, acc, dr, oth, samples);
+        printf("Calls: findLine %lu, getLRU %lu, broadcastToPartition %lu, "
+               "invalidateSharers %lu\n",
+               calls[PROFFINDLINE], calls[PROFGETLRU],
+               calls[PROFBROADCAST], calls[PROFINVSHARERS]);
+    }
+}
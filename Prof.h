@@ -0,0 +1,124 @@
+/*
+ * Dusty Mabe - 2014
+ * Prof.h - Header file for the simulator's profile of itself. How
+ *          many times the hot paths (findLine, getLRU,
+ *          broadcastToPartition, invalidateSharers) are called is
+ *          always counted. With profile=on the main loop is also
+ *          timed: the wall time goes to reading the trace (and
+ *          scheduling), Tile::Access less the directory, or the
+ *          directory (Dir::getFromNetwork). At the end the simulated
+ *          accesses per second and the split are printed (and
+ *          exported as table "profile").
+ *
+ *          With progress=<secs> a line of how far through the trace
+ *          the run is, how fast it goes and when it should be done
+ *          is written to stderr every secs seconds.
+ *
+ *          The clock is only read for one access in PROFSAMPLE (and
+ *          the progress every PROGCHECK accesses) and the sampled
+ *          times are scaled up, so both can be left on. The gap to
+ *          the next sample is random so that the samples don't all
+ *          land on the same tile of a round robin trace. What the
+ *          clock reads themselves cost is measured at the start and
+ *          taken off the samples.
+ */
+#ifndef PROF_H
+#define PROF_H
+
+#include "types.h"
+#include "params.h"
+
+class Trace;     // Forward Declaration
+class StatTable; // Forward Declaration
+
+// Hot path call counters
+enum {
+    PROFFINDLINE = 0,
+    PROFGETLRU,
+    PROFBROADCAST,
+    PROFINVSHARERS,
+    PROFNCALLS,
+};
+
+// Phases of the main loop timed with profile=on
+enum {
+    PHASETRACE = 0,  // Trace::next (or Sched::next)
+    PHASEACCESS,     // Tile::Access less the directory
+    PHASEDIR,        // Dir::getFromNetwork
+    PHASEOTHER,      // Adaptation, interval snapshots
+    PROFNPHASES,
+};
+
+class Prof {
+private:
+    Trace * trace;
+    ulong * ahead;      // References read but not simulated yet
+    int    timing;      // profile=on
+    ulong  progress;    // Seconds between progress lines (0 for none)
+    int    sampled;     // Is the current access timed
+    ulong  gap;         // Accesses until the next sample
+    ulong  seed;        // For the gaps
+    int    dirdepth;    // Nested directory calls
+    double mark;        // Clock at the end of the last phase
+    double dirmark;     // Clock when the directory was entered
+    double start;       // Clock at the start of the run
+    double lastprog;    // Clock of the last progress line
+    double clockcost;   // Seconds a clock read takes
+    double phases[PROFNPHASES]; // Sampled seconds in each phase
+
+    double now();
+    void   showProgress();
+    void   nextSample();
+
+public:
+    ulong  calls[PROFNCALLS];
+    ulong  accesses;    // Accesses simulated
+    ulong  samples;     // ... of which were timed
+    double wall;        // Seconds in the main loop
+
+    Prof(int time, ulong secs);
+
+    /*
+     * Prof::phase
+     *     - Called at the end of phase p of an access (the phases go
+     *       PHASETRACE, PHASEACCESS, PHASEOTHER). Only samples are
+     *       timed. The end of PHASEOTHER is the end of the access.
+     */
+    inline void phase(int p) {
+        double t;
+        if (p == PHASEOTHER && (++accesses % PROGCHECK) == 0 && progress)
+            showProgress();
+        if (!sampled) {
+            if (p == PHASEOTHER && timing && --gap == 0)
+                nextSample();
+            return;
+        }
+        t = now();
+        phases[p] += t - mark - clockcost;
+        mark = t;
+        if (p == PHASEOTHER) {
+            sampled = 0;
+            samples++;
+        }
+    }
+
+    inline void dirEnter() {
+        if (sampled && dirdepth++ == 0)
+            dirmark = now();
+    }
+
+    // The access the directory is inside of paid for both reads
+    inline void dirExit() {
+        if (sampled && --dirdepth == 0) {
+            phases[PHASEDIR]    += now() - dirmark - clockcost;
+            phases[PHASEACCESS] -= 2 * clockcost;
+        }
+    }
+
+    void begin(Trace *t, ulong *buffered);
+    void finish();
+    void getStats(StatTable *t);
+    void PrintStats(int tabular);
+};
+
+#endif
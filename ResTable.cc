@@ -0,0 +1,89 @@
+/*
+ * Dusty Mabe - 2014
+ * ResTable.cc - Implementation of a time-bucketed reservation table.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "ResTable.h"
+
+/*
+ * ResTable constructor
+ *     - n       - number of resources
+ *     - bits    - log2 of the number of cycles in a bucket
+ *     - buckets - how many buckets to remember per resource
+ *     - cap     - units of work a resource can do per bucket
+ */
+ResTable::ResTable(ulong n, ulong bits, ulong buckets, ulong cap) {
+
+    nres       = n;
+    bucketbits = bits;
+    nbuckets   = buckets;
+    capacity   = cap;
+
+    epoch = new ulong[nres * nbuckets];
+    used  = new ulong[nres * nbuckets];
+    units = new ulong[nres];
+    assert(epoch && used && units);
+
+    memset(epoch, 0, nres * nbuckets * sizeof(ulong));
+    memset(used,  0, nres * nbuckets * sizeof(ulong));
+    memset(units, 0, nres * sizeof(ulong));
+}
+
+ResTable::~ResTable() {
+    delete [] epoch;
+    delete [] used;
+    delete [] units;
+}
+
+/*
+ * ResTable::reserve
+ *     - Reserve amount units of resource res starting at time.
+ *       If the bucket that time falls in is full then move on
+ *       to the following buckets until one has room.
+ *
+ * Returns the queuing delay (cycles between time and the start of
+ * the bucket the reservation landed in).
+ */
+ulong ResTable::reserve(ulong res, ulong time, ulong amount) {
+
+    ulong i, slot;
+    ulong bucket = time >> bucketbits;
+
+    assert(res < nres);
+
+    // A single request can never need more than a whole bucket
+    if (amount > capacity)
+        amount = capacity;
+
+    for (i=0; i < nbuckets; i++, bucket++) {
+
+        slot = res*nbuckets + (bucket % nbuckets);
+
+        // The slot holds a bucket that is later in time than this
+        // request. Our bucket has already been forgotten so assume
+        // it was free (any sliding so far still counts).
+        if (epoch[slot] > bucket) {
+            units[res] += amount;
+            break;
+        }
+
+        // The slot holds an older bucket. Recycle it.
+        if (epoch[slot] < bucket) {
+            epoch[slot] = bucket;
+            used[slot]  = 0;
+        }
+
+        if (used[slot] + amount <= capacity) {
+            used[slot] += amount;
+            units[res] += amount;
+            break;
+        }
+    }
+
+    // Queuing delay is how far we had to slide
+    if ((bucket << bucketbits) > time)
+        return (bucket << bucketbits) - time;
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * Dusty Mabe - 2014
+ * ResTable.h - Header file for a time-bucketed reservation table.
+ *
+ *              A ResTable tracks how busy a set of resources (network
+ *              links, memory banks, ...) are over time without
+ *              simulating individual events. Time is divided into
+ *              buckets of 2^bucketbits cycles and each resource can
+ *              hand out "capacity" units of work per bucket. A request
+ *              that finds its bucket full slides into the next bucket
+ *              and the slide is reported back as queuing delay.
+ *
+ *              Only a window of nbuckets buckets is remembered per
+ *              resource (a ring). Reservations that fall out of the
+ *              window are forgotten, and a request for a bucket older
+ *              than the window is taken to find it free. So requests
+ *              only queue behind each other if their times are
+ *              close: with order=file the tiles' clocks drift far
+ *              apart and most contention between tiles is missed.
+ *              order=time keeps the clocks together.
+ */
+#ifndef RESTABLE_H
+#define RESTABLE_H
+
+#include "types.h"
+
+class ResTable {
+private:
+    ulong nres;        // Number of resources
+    ulong nbuckets;    // Buckets remembered per resource
+    ulong bucketbits;  // log2(cycles per bucket)
+    ulong capacity;    // Units each resource can take per bucket
+
+    ulong *epoch;      // [nres][nbuckets] bucket held in each slot
+    ulong *used;       // [nres][nbuckets] units reserved in each slot
+
+public:
+    ulong *units;      // [nres] total units reserved (or put in a
+                       // forgotten bucket taken to be free)
+
+    ResTable(ulong n, ulong bits, ulong buckets, ulong cap);
+    ~ResTable();
+
+    ulong reserve(ulong res, ulong time, ulong amount);
+    ulong bucketCycles() { return (1UL << bucketbits); }
+};
+
+#endif
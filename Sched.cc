@@ -0,0 +1,190 @@
+/*
+ * Dusty Mabe - 2014
+ * Sched.cc - Implementation of the time ordered trace scheduler.
+ */
+
+#include <string.h>
+#include <assert.h>
+#include "Sched.h"
+#include "Trace.h"
+#include "Tile.h"
+#include "params.h"
+
+#define SCHEDQINIT 1024 // Initial size of each input queue
+
+Sched::Sched(Trace *t, Tile **tiless) {
+
+    int i;
+
+    trace = t;
+    tiles = tiless;
+    eof   = 0;
+    last  = -1;
+    buffered = maxbuffered = 0;
+
+    queue  = new SchedRec*[NPROCS];
+    qhead  = new ulong[NPROCS];
+    qcount = new ulong[NPROCS];
+    qsize  = new ulong[NPROCS];
+    heap   = new int[NPROCS];
+
+    // Every tile starts out in the heap. They all have the
+    // same cycle so the heap is already in order.
+    for (i=0; i < NPROCS; i++) {
+        queue[i]  = new SchedRec[SCHEDQINIT];
+        qhead[i]  = 0;
+        qcount[i] = 0;
+        qsize[i]  = SCHEDQINIT;
+        heap[i]   = i;
+    }
+    heapsize = NPROCS;
+}
+
+Sched::~Sched() {
+    int i;
+    for (i=0; i < NPROCS; i++)
+        delete [] queue[i];
+    delete [] queue;
+    delete [] qhead;
+    delete [] qcount;
+    delete [] qsize;
+    delete [] heap;
+}
+
+/*
+ * Sched::before
+ *     - Heap ordering. Smallest cycle first, ties broken by
+ *       processor number so runs are repeatable.
+ */
+int Sched::before(int a, int b) {
+    if (tiles[a]->cycle != tiles[b]->cycle)
+        return (tiles[a]->cycle < tiles[b]->cycle);
+    return (a < b);
+}
+
+/*
+ * Sched::siftDown
+ *     - Move the heap entry at i down until the heap is ordered.
+ */
+void Sched::siftDown(int i) {
+
+    int child, tmp;
+
+    while ((child = 2*i + 1) < heapsize) {
+        if (child + 1 < heapsize && before(heap[child + 1], heap[child]))
+            child++;
+        if (!before(heap[child], heap[i]))
+            break;
+        tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
+    }
+}
+
+/*
+ * Sched::push
+ *     - Append a reference to a processor's input queue, growing
+ *       the queue if it is full.
+ */
+void Sched::push(int proc, uint addr, uchar op) {
+
+    ulong i;
+    SchedRec * q;
+
+    if (qcount[proc] == qsize[proc]) {
+        q = new SchedRec[2 * qsize[proc]];
+        for (i=0; i < qcount[proc]; i++)
+            q[i] = queue[proc][(qhead[proc] + i) % qsize[proc]];
+        delete [] queue[proc];
+        queue[proc] = q;
+        qhead[proc] = 0;
+        qsize[proc] *= 2;
+    }
+
+    q = &queue[proc][(qhead[proc] + qcount[proc]) % qsize[proc]];
+    q->addr = addr;
+    q->op   = op;
+    qcount[proc]++;
+
+    buffered++;
+    maxbuffered = MAX(maxbuffered, buffered);
+}
+
+/*
+ * Sched::fill
+ *     - Read the trace until proc has a reference queued, buffering
+ *       the references of other processors along the way.
+ *
+ * Returns 0 if the trace ran out first.
+ */
+int Sched::fill(int proc) {
+
+    int p;
+    uchar op;
+    ulong addr;
+
+    while (qcount[proc] == 0) {
+        if (eof || !trace->next(&p, &op, &addr)) {
+            eof = 1;
+            return 0;
+        }
+        push(p, addr, op);
+    }
+    return 1;
+}
+
+/*
+ * Sched::next
+ *     - Hand back the next reference of the tile with the smallest
+ *       cycle. The tile handed out by the previous call has since
+ *       done its access so it gets moved back into place first.
+ *
+ * Returns 1 if a reference was found, 0 when the trace is done.
+ */
+int Sched::next(int *proc, uchar *op, ulong *addr) {
+
+    int p;
+    SchedRec * q;
+
+    // The previous tile is at the top of the heap and its cycle
+    // has grown.
+    if (last >= 0)
+        siftDown(0);
+
+    while (heapsize > 0) {
+
+        p = heap[0];
+
+        // No more references for this tile. Drop it from the heap.
+        if (qcount[p] == 0 && !fill(p)) {
+            heap[0] = heap[--heapsize];
+            siftDown(0);
+            continue;
+        }
+
+        q = &queue[p][qhead[p]];
+        *proc = p;
+        *op   = q->op;
+        *addr = q->addr;
+        qhead[p] = (qhead[p] + 1) % qsize[p];
+        qcount[p]--;
+        buffered--;
+
+        last = p;
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Sched::reheap
+ *     - Rebuild the heap after the cycles of many tiles changed
+ *       at once (e.g. everyone stalled to repartition).
+ */
+void Sched::reheap() {
+    int i;
+    for (i=heapsize/2 - 1; i >= 0; i--)
+        siftDown(i);
+}
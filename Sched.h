@@ -0,0 +1,65 @@
+/*
+ * Dusty Mabe - 2014
+ * Sched.h - Header file for a scheduler that hands out the references
+ *           of a trace in simulated time order rather than file order.
+ *
+ *           The trace is split into per processor input queues and
+ *           the next reference handed out is always the next one of
+ *           the tile with the smallest local cycle. The tiles are kept
+ *           in a binary min-heap keyed by cycle so picking the next
+ *           tile is O(log NPROCS).
+ */
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "types.h"
+
+class Trace; // Forward Declaration
+class Tile;  // Forward Declaration
+
+// Order in which trace references are simulated (order=<order>)
+enum {
+    ORDERFILE = 0, // Trace file order
+    ORDERTIME,     // Smallest tile cycle first
+};
+
+// One buffered reference in a processor's input queue
+struct SchedRec {
+    uint  addr;
+    uchar op;
+};
+
+class Sched {
+private:
+    Trace * trace;
+    Tile ** tiles;
+    int     eof;      // Has the whole trace been read?
+
+    // Per processor input queues (growable rings)
+    SchedRec ** queue;
+    ulong * qhead;
+    ulong * qcount;
+    ulong * qsize;
+
+    // Min-heap of processors that may still have references
+    int * heap;
+    int   heapsize;
+    int   last;       // Processor handed out by the previous call
+
+    int   before(int a, int b);
+    void  siftDown(int i);
+    void  push(int proc, uint addr, uchar op);
+    int   fill(int proc);
+
+public:
+    ulong maxbuffered; // Most references ever buffered at once
+    ulong buffered;
+
+    Sched(Trace *t, Tile **tiless);
+    ~Sched();
+
+    int next(int *proc, uchar *op, ulong *addr);
+    void reheap();
+};
+
+#endif
@@ -0,0 +1,349 @@
+/*
+ * Dusty Mabe - 2014
+ * Stats.cc - Implementation of the statistics registry.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+#include "Stats.h"
+
+StatTable::StatTable(const char *tname) {
+    snprintf(name, STATNAMELEN, "%s", tname);
+    ncols  = 0;
+    nrows  = 0;
+    cursor = 0;
+}
+
+/*
+ * StatTable::col
+ *     - Find the column named cname, registering it (with type
+ *       type) if this is the first time. The rows set their values
+ *       in the same order so the column after the last one used is
+ *       tried first.
+ *
+ * Returns the column index.
+ */
+int StatTable::col(const char *cname, int type) {
+    int i;
+
+    if (cursor < ncols && strcmp(cols[cursor], cname) == 0)
+        return cursor++;
+
+    for (i=0; i < ncols; i++) {
+        if (strcmp(cols[i], cname) == 0) {
+            cursor = i + 1;
+            return i;
+        }
+    }
+
+    assert(ncols < STATMAXCOLS);
+    snprintf(cols[ncols], STATNAMELEN, "%s", cname);
+    types[ncols] = type;
+    for (i=0; i < STATMAXROWS; i++)
+        vals[i][ncols].u = 0;
+
+    cursor = ncols + 1;
+    return ncols++;
+}
+
+/*
+ * StatTable::row
+ *     - Start a new row. The values set from now on go in it.
+ */
+void StatTable::row() {
+    assert(nrows < STATMAXROWS);
+    nrows++;
+    cursor = 0;
+}
+
+/*
+ * StatTable::count
+ *     - Set the counter cname of the current row to v.
+ */
+void StatTable::count(const char *cname, ulong v) {
+    assert(nrows > 0);
+    vals[nrows - 1][col(cname, STATCOUNT)].u = v;
+}
+
+/*
+ * StatTable::ratio
+ *     - Set the ratio cname of the current row to num / den (0 if
+ *       den is 0).
+ */
+void StatTable::ratio(const char *cname, ulong num, ulong den) {
+    assert(nrows > 0);
+    vals[nrows - 1][col(cname, STATRATIO)].f = statRatio(num, den);
+}
+
+/*
+ * StatTable::real
+ *     - Set the (ratio type) value cname of the current row to v.
+ */
+void StatTable::real(const char *cname, double v) {
+    assert(nrows > 0);
+    vals[nrows - 1][col(cname, STATRATIO)].f = v;
+}
+
+/*
+ * StatTable::PrintTabular
+ *     - Print the table as a header line and a line per row with
+ *       every column 15 characters wide.
+ */
+void StatTable::PrintTabular() {
+    int r, c;
+
+    for (c=0; c < ncols; c++)
+        printf("%15s", cols[c]);
+    printf("\n");
+
+    for (r=0; r < nrows; r++) {
+        for (c=0; c < ncols; c++) {
+            if (types[c] == STATRATIO)
+                printf("%15f", vals[r][c].f);
+            else
+                printf("%15lu", vals[r][c].u);
+        }
+        printf("\n");
+    }
+}
+
+
+Stats::Stats() {
+    ntables = 0;
+    nmeta   = 0;
+}
+
+Stats::~Stats() {
+    int i;
+    for (i=0; i < ntables; i++)
+        delete tables[i];
+}
+
+/*
+ * Stats::table
+ *     - Get the table named tname, creating it the first time.
+ */
+StatTable *Stats::table(const char *tname) {
+    int i;
+
+    for (i=0; i < ntables; i++)
+        if (strcmp(tables[i]->name, tname) == 0)
+            return tables[i];
+
+    assert(ntables < STATMAXTABLES);
+    tables[ntables] = new StatTable(tname);
+    assert(tables[ntables]);
+    return tables[ntables++];
+}
+
+/*
+ * Stats::meta
+ *     - Record a piece of metadata about the run (printf style).
+ *       Setting a key again replaces its value.
+ */
+void Stats::meta(const char *key, const char *fmt, ...) {
+    va_list ap;
+    int i;
+
+    for (i=0; i < nmeta; i++)
+        if (strcmp(metakeys[i], key) == 0)
+            break;
+
+    if (i == nmeta) {
+        assert(nmeta < STATMAXMETA);
+        snprintf(metakeys[nmeta++], STATNAMELEN, "%s", key);
+    }
+
+    va_start(ap, fmt);
+    vsnprintf(metavals[i], STATMETALEN, fmt, ap);
+    va_end(ap);
+}
+
+/*
+ * Stats::Export
+ *     - Write the metadata and every table to fname in format.
+ */
+void Stats::Export(ulong format, const char *fname) {
+
+    FILE *fp = fopen(fname, (format == EXPORTBIN) ? "wb" : "w");
+
+    if (fp == NULL) {
+        printf("Can't open export file %s\n", fname);
+        exit(1);
+    }
+
+    switch (format) {
+        case EXPORTCSV:
+            exportCSV(fp);
+            break;
+        case EXPORTJSON:
+            exportJSON(fp);
+            break;
+        case EXPORTBIN:
+            exportBin(fp);
+            break;
+        default:
+            assert(0); // should not get here
+    }
+
+    fclose(fp);
+}
+
+/*
+ * quoteCSV
+ *     - Print s as a CSV field, quoted if it needs to be.
+ */
+static void quoteCSV(FILE *fp, const char *s) {
+
+    if (strpbrk(s, ",\"\n") == NULL) {
+        fputs(s, fp);
+        return;
+    }
+
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"')
+            fputc('"', fp);
+        fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/*
+ * Stats::exportCSV
+ *     - A line per value: table,row,name,value.
+ */
+void Stats::exportCSV(FILE *fp) {
+    int i, r, c;
+    StatTable *t;
+
+    fprintf(fp, "table,row,name,value\n");
+
+    for (i=0; i < nmeta; i++) {
+        fprintf(fp, "meta,0,%s,", metakeys[i]);
+        quoteCSV(fp, metavals[i]);
+        fprintf(fp, "\n");
+    }
+
+    for (i=0; i < ntables; i++) {
+        t = tables[i];
+        for (r=0; r < t->nrows; r++) {
+            for (c=0; c < t->ncols; c++) {
+                if (t->types[c] == STATRATIO)
+                    fprintf(fp, "%s,%d,%s,%f\n", t->name, r, t->cols[c],
+                            t->vals[r][c].f);
+                else
+                    fprintf(fp, "%s,%d,%s,%lu\n", t->name, r, t->cols[c],
+                            t->vals[r][c].u);
+            }
+        }
+    }
+}
+
+/*
+ * quoteJSON
+ *     - Print s as a JSON string.
+ */
+static void quoteJSON(FILE *fp, const char *s) {
+
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(fp, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(fp, "\\u%04x", *s);
+        else
+            fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/*
+ * Stats::exportJSON
+ *     - An object with the metadata and an array of row objects
+ *       per table.
+ */
+void Stats::exportJSON(FILE *fp) {
+    int i, r, c;
+    StatTable *t;
+
+    fprintf(fp, "{\n  \"meta\": {");
+    for (i=0; i < nmeta; i++) {
+        fprintf(fp, "%s\n    ", i ? "," : "");
+        quoteJSON(fp, metakeys[i]);
+        fprintf(fp, ": ");
+        quoteJSON(fp, metavals[i]);
+    }
+    fprintf(fp, "\n  },\n  \"tables\": {");
+
+    for (i=0; i < ntables; i++) {
+        t = tables[i];
+        fprintf(fp, "%s\n    ", i ? "," : "");
+        quoteJSON(fp, t->name);
+        fprintf(fp, ": [");
+        for (r=0; r < t->nrows; r++) {
+            fprintf(fp, "%s\n      {", r ? "," : "");
+            for (c=0; c < t->ncols; c++) {
+                fprintf(fp, "%s", c ? ", " : "");
+                quoteJSON(fp, t->cols[c]);
+                if (t->types[c] == STATRATIO)
+                    fprintf(fp, ": %f", t->vals[r][c].f);
+                else
+                    fprintf(fp, ": %lu", t->vals[r][c].u);
+            }
+            fprintf(fp, "}");
+        }
+        fprintf(fp, "\n    ]");
+    }
+
+    fprintf(fp, "\n  }\n}\n");
+}
+
+/*
+ * putU32, putStr
+ *     - Binary export helpers.
+ */
+static void putU32(FILE *fp, unsigned int v) {
+    fwrite(&v, sizeof(v), 1, fp);
+}
+
+static void putStr(FILE *fp, const char *s) {
+    putU32(fp, strlen(s));
+    fwrite(s, 1, strlen(s), fp);
+}
+
+/*
+ * Stats::exportBin
+ *     - The compact dump described in Stats.h.
+ */
+void Stats::exportBin(FILE *fp) {
+    int i, r, c;
+    unsigned char type;
+    StatTable *t;
+
+    fwrite("SIMSTAT1", 1, 8, fp);
+
+    putU32(fp, nmeta);
+    for (i=0; i < nmeta; i++) {
+        putStr(fp, metakeys[i]);
+        putStr(fp, metavals[i]);
+    }
+
+    putU32(fp, ntables);
+    for (i=0; i < ntables; i++) {
+        t = tables[i];
+        putStr(fp, t->name);
+        putU32(fp, t->ncols);
+        putU32(fp, t->nrows);
+        for (c=0; c < t->ncols; c++) {
+            putStr(fp, t->cols[c]);
+            type = t->types[c];
+            fwrite(&type, 1, 1, fp);
+        }
+        for (r=0; r < t->nrows; r++)
+            fwrite(t->vals[r], sizeof(StatValue), t->ncols, fp);
+    }
+}
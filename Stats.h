@@ -0,0 +1,106 @@
+/*
+ * Dusty Mabe - 2014
+ * Stats.h - Header file for the statistics registry. The end of run
+ *           counters are put in named tables (a row per tile, say)
+ *           whose columns are registered by name the first time a
+ *           value is set. A table prints as the usual %15 tabular
+ *           text and the whole registry, along with metadata about
+ *           the run (options, trace, wall time), can be exported
+ *           with export=csv|json|bin to exportfile=<file>:
+ *
+ *           csv  - a row per value: table,row,name,value. The
+ *                  metadata comes first as table "meta". Files of
+ *                  many runs can simply be concatenated.
+ *           json - {"meta": {...}, "tables": {"<table>": [{...}]}}
+ *           bin  - "SIMSTAT1", then (all numbers are 32 bit and all
+ *                  strings a 32 bit length and the bytes):
+ *                  nmeta, {key, value}..., ntables, {name, ncols,
+ *                  nrows, {column name, 8 bit type}..., nrows x
+ *                  ncols 64 bit values (ulong or double by type,
+ *                  host byte order)}...
+ *
+ *           A ratio whose denominator is 0 is 0 rather than nan.
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include "types.h"
+#include "params.h"
+
+// Export formats (selected with export=<format>)
+enum {
+    EXPORTNONE = 0,
+    EXPORTCSV,
+    EXPORTJSON,
+    EXPORTBIN,
+};
+
+// Types of the values in a column
+enum {
+    STATCOUNT = 0, // ulong, printed %lu
+    STATRATIO,     // double, printed %f
+};
+
+#define STATMAXTABLES  8
+#define STATMAXCOLS    64
+#define STATMAXROWS    (NPROCS + 1)
+#define STATMAXMETA    16
+#define STATNAMELEN    32
+#define STATMETALEN    512
+
+// num / den that is 0 (not nan) when there is nothing to divide by
+static inline float statRatio(ulong num, ulong den) {
+    return den ? ((float)num / (float)den) : 0.0;
+}
+
+union StatValue {
+    ulong  u;
+    double f;
+};
+
+class StatTable {
+private:
+    int  cursor;  // Column the next value most likely goes in
+
+    int  col(const char *cname, int type);
+
+public:
+    char name[STATNAMELEN];
+    int  ncols;
+    int  nrows;
+    char cols[STATMAXCOLS][STATNAMELEN];
+    int  types[STATMAXCOLS];
+    StatValue vals[STATMAXROWS][STATMAXCOLS];
+
+    StatTable(const char *tname);
+
+    void row();
+    void count(const char *cname, ulong v);
+    void ratio(const char *cname, ulong num, ulong den);
+    void real(const char *cname, double v);
+    void PrintTabular();
+};
+
+class Stats {
+private:
+    int  ntables;
+    StatTable * tables[STATMAXTABLES];
+    int  nmeta;
+    char metakeys[STATMAXMETA][STATNAMELEN];
+    char metavals[STATMAXMETA][STATMETALEN];
+
+    void exportCSV(FILE *fp);
+    void exportJSON(FILE *fp);
+    void exportBin(FILE *fp);
+
+public:
+    Stats();
+    ~Stats();
+
+    StatTable * table(const char *tname);
+    void meta(const char *key, const char *fmt, ...);
+    void Export(ulong format, const char *fname);
+};
+
+#endif
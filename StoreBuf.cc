@@ -0,0 +1,194 @@
+/*
+ * Dusty Mabe - 2014
+ * StoreBuf.cc - Implementation of a coalescing store buffer.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "StoreBuf.h"
+#include "params.h"
+
+StoreBuf::StoreBuf(ulong n) {
+
+    size  = n;
+    used  = 0;
+    blk   = new ulong[size];
+    addr  = new ulong[size];
+    alloc = new ulong[size];
+    done  = new ulong[size];
+    assert(blk && addr && alloc && done);
+
+    laststart = 0;
+
+    stores = merges = drains = occupancy = 0;
+    fullstalls = stallcycles = rawstalls = rawcycles = 0;
+}
+
+StoreBuf::~StoreBuf() {
+    delete [] blk;
+    delete [] addr;
+    delete [] alloc;
+    delete [] done;
+}
+
+/*
+ * StoreBuf::lookup
+ *     - Find the entry for blockaddr. If waiting is set only an
+ *       entry that hasn't started draining counts (a store can
+ *       still merge into it).
+ *
+ * Returns the entry index or -1 if there is none.
+ */
+int StoreBuf::lookup(ulong blockaddr, int waiting) {
+    ulong i;
+    for (i=0; i < used; i++)
+        if (blk[i] == blockaddr && (!waiting || !done[i]))
+            return i;
+    return -1;
+}
+
+/*
+ * StoreBuf::oldestWaiting
+ *     - Entries drain in the order they were allocated. Find the
+ *       next one to go.
+ *
+ * Returns the entry index or -1 if every entry has started draining.
+ */
+int StoreBuf::oldestWaiting() {
+    ulong i;
+    for (i=0; i < used; i++)
+        if (!done[i])
+            return i;
+    return -1;
+}
+
+/*
+ * StoreBuf::full
+ *     - Is every entry holding a store?
+ */
+int StoreBuf::full() {
+    return (used == size);
+}
+
+/*
+ * StoreBuf::insert
+ *     - Put a store to a (so far unbuffered) block in a new entry.
+ */
+void StoreBuf::insert(ulong a, ulong blockaddr, ulong now) {
+
+    assert(!full());
+
+    occupancy += used;
+
+    blk[used]   = blockaddr;
+    addr[used]  = a;
+    alloc[used] = now;
+    done[used]  = 0;
+    used++;
+}
+
+/*
+ * StoreBuf::readyTime
+ *     - Time at which entry i can start draining. Normally once it
+ *       has waited SBHOLDTIME cycles for more stores; if force is
+ *       set (someone is waiting on it) as soon as possible. Never
+ *       before the previous entry started.
+ */
+ulong StoreBuf::readyTime(int i, ulong now, int force) {
+    ulong t = force ? now : alloc[i] + SBHOLDTIME;
+    return MAX(t, laststart);
+}
+
+/*
+ * StoreBuf::drained
+ *     - Entry i started draining at start and its L2 write takes
+ *       latency cycles.
+ */
+void StoreBuf::drained(int i, ulong start, ulong latency) {
+    assert(!done[i]);
+    done[i]   = start + latency;
+    laststart = start;
+    drains++;
+}
+
+/*
+ * StoreBuf::retire
+ *     - Free the entries whose L2 writes are complete by now. The
+ *       rest keep their order.
+ */
+void StoreBuf::retire(ulong now) {
+    ulong i, j;
+    for (i=0, j=0; i < used; i++) {
+        if (done[i] && done[i] <= now)
+            continue;
+        blk[j]   = blk[i];
+        addr[j]  = addr[i];
+        alloc[j] = alloc[i];
+        done[j]  = done[i];
+        j++;
+    }
+    used = j;
+}
+
+/*
+ * StoreBuf::firstDone
+ *     - Time at which the first draining entry completes (0 if
+ *       none are draining).
+ */
+ulong StoreBuf::firstDone() {
+    ulong i, first = 0;
+    for (i=0; i < used; i++)
+        if (done[i] && (!first || done[i] < first))
+            first = done[i];
+    return first;
+}
+
+/*
+ * StoreBuf::lastDone
+ *     - Time at which the last draining entry completes.
+ */
+ulong StoreBuf::lastDone() {
+    ulong i, last = 0;
+    for (i=0; i < used; i++)
+        last = MAX(last, done[i]);
+    return last;
+}
+
+/*
+ * StoreBuf::add
+ *     - Add the counters of s to ours (for the totals row).
+ */
+void StoreBuf::add(StoreBuf *s) {
+    stores      += s->stores;
+    merges      += s->merges;
+    drains      += s->drains;
+    occupancy   += s->occupancy;
+    fullstalls  += s->fullstalls;
+    stallcycles += s->stallcycles;
+    rawstalls   += s->rawstalls;
+    rawcycles   += s->rawcycles;
+}
+
+/*
+ * StoreBuf::PrintStatsTabular
+ *     - Print the store buffer counters as columns. Every merged
+ *       store is an L2 write message that was never sent.
+ */
+void StoreBuf::PrintStatsTabular(int printhead) {
+
+    if (printhead) {
+        printf("%15s%15s%15s%15s%15s%15s%15s%15s%15s",
+               "sbstores", "sbdrains", "l2wrsaved", "mergeratio",
+               "avgoccupancy", "fullstalls", "stallcycles",
+               "rawstalls", "rawcycles");
+        return;
+    }
+
+    printf("%15lu%15lu%15lu%15f%15f%15lu%15lu%15lu%15lu",
+           stores, drains, merges,
+           stores ? ((float)merges / (float)stores) : 0.0,
+           (stores - merges) ?
+               ((float)occupancy / (float)(stores - merges)) : 0.0,
+           fullstalls, stallcycles, rawstalls, rawcycles);
+}
@@ -0,0 +1,59 @@
+/*
+ * Dusty Mabe - 2014
+ * StoreBuf.h - Header file for a coalescing store buffer. With a
+ *              write-through L1 each tile can put its stores in one
+ *              instead of sending every store to the home L2 slice
+ *              right away. A store to a block that already has an
+ *              entry waiting in the buffer merges into it. Entries
+ *              wait SBHOLDTIME cycles for more stores and then drain
+ *              to the L2 in order, in the background. The processor
+ *              only waits when the buffer is full or when it misses
+ *              on a block the buffer hasn't written yet.
+ */
+#ifndef STOREBUF_H
+#define STOREBUF_H
+
+#include "types.h"
+
+class StoreBuf {
+private:
+    ulong size;      // Number of entries
+    ulong used;      // Entries holding a store (waiting or draining)
+    ulong *blk;      // Block address of each entry
+    ulong *addr;     // Address of the first store to the block
+    ulong *alloc;    // Time each entry was allocated
+    ulong *done;     // Time each entry's L2 write completes (0 if
+                     // it hasn't drained yet)
+    ulong laststart; // Time the last drain started
+
+public:
+    // Counters
+    ulong stores;      // Stores put in the buffer
+    ulong merges;      // ... that merged into a waiting entry
+    ulong drains;      // Entries written to the L2
+    ulong occupancy;   // Sum of used entries seen at each insert
+    ulong fullstalls;  // Times a store found every entry in use
+    ulong stallcycles; // Cycles spent waiting for a free entry
+    ulong rawstalls;   // Misses that waited for a buffered store
+    ulong rawcycles;   // Cycles spent waiting for those
+
+    StoreBuf(ulong n);
+    ~StoreBuf();
+
+    int   lookup(ulong blockaddr, int waiting);
+    int   oldestWaiting();
+    int   full();
+    void  insert(ulong a, ulong blockaddr, ulong now);
+    ulong readyTime(int i, ulong now, int force);
+    void  drained(int i, ulong start, ulong latency);
+    void  retire(ulong now);
+    ulong firstDone();
+    ulong lastDone();
+    ulong getAddr(int i)  { return addr[i];  }
+    ulong getDone(int i)  { return done[i];  }
+
+    void  add(StoreBuf *s);
+    void  PrintStatsTabular(int printhead);
+};
+
+#endif
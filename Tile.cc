@@ -12,22 +12,73 @@
 #include "CCSM.h"
 #include "BitVector.h"
 #include "Net.h"
+#include "MSHR.h"
+#include "StoreBuf.h"
+#include "Prefetch.h"
+#include "Nuca.h"
+#include "Coop.h"
+#include "Stats.h"
+#include "Prof.h"
 #include "params.h"
+#include "Delay.h"
 
 
 // Global NETWORK is defined in simulator.cc
 extern Net *NETWORK;
 
-// Global delay counter for the current outstanding memory request.
-extern int CURRENTDELAY;
-extern int CURRENTMEMDELAY;
+// Global L2 placement policy state is defined in simulator.cc
+extern Nuca *NUCA;
 
+// Global cooperative spilling state is defined in simulator.cc
+extern Coop *COOP;
 
-Tile::Tile(int number, int partspertile, int partition) {
+// Global simulator profile is defined in simulator.cc
+extern Prof *PROF;
+
+// The tile (and its cycle) whose access is currently being simulated
+extern ulong CURRENTTILE;
+extern ulong CURRENTCYCLE;
+
+// Number of MSHRs per tile (0 means accesses are blocking)
+extern ulong NUMMSHRS;
+
+// Store buffer entries per tile (0 means no store buffer)
+extern ulong STOREBUF;
+
+// L2 prefetch policy, degree and distance
+extern ulong PREFETCH;
+extern ulong PFDEG;
+extern ulong PFDIST;
+
+// Set when the current L2 access is the first hit on a prefetched line
+extern ulong CURRENTPFHIT;
+
+// How the L1s and L2s relate (HIERINCL, HIERNINE or HIEREXCL)
+extern ulong HIERARCHY;
+
+// L1 write policy (L1WRTHRU or L1WRBACK)
+extern ulong L1WRITE;
+
+// How L1 copies are invalidated (L1INVBCAST or L1INVMASK)
+extern ulong L1INVMODE;
+
+// Whether L2 evictions are reported to the directory (0 or 1)
+extern ulong EVICTNOTIFY;
+
+// Keep clean L1 victims as replicas in the local L2 slice (0 or 1)
+extern ulong REPLICATE;
+
+// Move hot blocks to the slice of the tile that uses them (0 or 1)
+extern ulong MIGRATE;
+
+// Width of the tile grid
+extern ulong TOPOWIDTH;
+
+Tile::Tile(int number, int partition, int ntiles, int *tiles) {
 
     index  = number;
-    xindex = index / SQRTNPROCS;  
-    yindex = index % SQRTNPROCS;  
+    xindex = index / TOPOWIDTH;
+    yindex = index % TOPOWIDTH;
     cycle    = 0;      // Keep count of cycles (measure of performance)
     locxfer  = 0;      // How many times did we get data from our own L2?
     locdelay = 0;      // Delay for local xfers. Should be same for each access.
@@ -40,6 +91,17 @@ Tile::Tile(int number, int partspertile, int partition) {
     l2accesses = 0;    // How many L2 operations were there for this tile? 
     memcycles = 0;     // Keep up with cycles spent waiting for mem access
     memhopscycles = 0; // Keep up with hop cycles when memory is accessed
+    hopcycles = 0;     // Keep up with cycles not spent waiting for mem
+    pendxfer  = XFERNONE;
+    penddelay = pendmem = 0;
+
+    backinvs = backinvsaved = 0;
+    l1invmsgs = l1invcycles = l1invsaved = orphaninvs = 0;
+    exvictims = 0;
+    l2writes = l1wrabsorbed = l1wbacks = 0;
+    recalls = recallcycles = 0;
+    staleinvs = staleints = putsmsgs = putmmsgs = silentevicts = 0;
+    homelocal = homehops = 0;
 
     l1cache = new Cache(this, L1, L1SIZE, L1ASSOC, BLKSIZE);
     assert(l1cache);
@@ -47,9 +109,21 @@ Tile::Tile(int number, int partspertile, int partition) {
     l2cache = new Cache(this, L2, L2SIZE, L2ASSOC, BLKSIZE);
     assert(l2cache);
 
-    partscheme = partspertile;
+    partid     = partition;
+    partscheme = ntiles;
+    parttiles  = tiles;
+
+    mshr = NULL;
+    if (NUMMSHRS)
+        mshr = new MSHR(NUMMSHRS);
 
-    part = new BitVector(partition);
+    storebuf = NULL;
+    if (STOREBUF)
+        storebuf = new StoreBuf(STOREBUF);
+
+    prefetcher = NULL;
+    if (PREFETCH != PFNONE)
+        prefetcher = new Prefetcher(PREFETCH, PFDEG, PFDIST);
 }
 
 
@@ -59,7 +133,11 @@ Tile::Tile(int number, int partspertile, int partition) {
  *       is to be read/written by the proc in this tile.
  */
 void Tile::Access(ulong addr, uchar op) {
+    CacheLine * line;
     int state;
+    int owned = 0;
+    int l2access = 0;
+    ulong start = cycle;
 
     // Bump accesses counter
     accesses++;
@@ -68,22 +146,308 @@ void Tile::Access(ulong addr, uchar op) {
     CURRENTDELAY = 0;
     CURRENTMEMDELAY = 0;
 
+    // Let the rest of the system know who is accessing and when
+    CURRENTTILE  = index;
+    CURRENTCYCLE = cycle;
+
+    // Send on the buffered stores whose time has come
+    if (storebuf) {
+        drainStores(cycle, -1);
+        storebuf->retire(cycle);
+    }
+
+    // Tell the placement policy about the page first. Under rnuca
+    // that can move the page's blocks (and take them out of our L1).
+    NUCA->touch(addr, index, partid);
+
+    // A write-back L1 that already owns the block (has it dirty)
+    // can take the write by itself
+    if (L1WRITE == L1WRBACK && op == 'w') {
+        line  = l1cache->findLine(addr);
+        owned = (line && line->getFlags() == DIRTY);
+    }
+
+    // A load that misses can't go to the L2 ahead of a buffered
+    // store to the block
+    if (storebuf && op == 'r' && !l1cache->findLine(addr))
+        waitForStore(addr);
+
     // L1: Check L1 to see if hit
-    state = l1cache->Access(addr, op);
+    if (storebuf && op == 'w')
+        state = l1cache->bufferedWrite(addr);
+    else
+        state = l1cache->Access(addr, op);
+
+    // With a store buffer every store (hit or miss) goes into the
+    // buffer and reaches the L2 later
+    if (storebuf && op == 'w') {
+        bufferStore(addr);
 
     // If a hit then we are done (almost). Must make any write
-    // hits in the L1 access the L2 as well (WRITETHROUGH).
-    if (state == HIT && op == 'w')
-        L2Access(addr, op); // Aggregate L2 access
+    // hits in the L1 access the L2 as well (WRITETHROUGH), unless
+    // the L1 is write-back and owns the block. Otherwise the L2
+    // access gets us ownership.
+    } else if (state == HIT && op == 'w') {
+        if (owned) {
+            l1wrabsorbed++;
+        } else {
+            L2Access(addr, op, 1); // Aggregate L2 access
+            l2access = 1;
+        }
 
     // L2: If the L1 Missed then access the aggregate L2
-    if (state == MISS)
-        L2Access(addr, op);
+    } else if (state == MISS) {
+        L2Access(addr, op, 0);
+        l2access = 1;
+    }
 
-    // All accesses are done so add the accumulated delay
+    // If we have MSHRs then the access can overlap with others.
+    // Otherwise all accesses are done so add the accumulated delay
     // to the cycle counter.
-    cycle += CURRENTDELAY;
-    cycle += CURRENTMEMDELAY;
+    if (mshr) {
+        issueToMSHR(addr, l2access);
+    } else {
+        cycle += CURRENTDELAY;
+        cycle += CURRENTMEMDELAY;
+    }
+
+    chargeXfer(cycle - start, CURRENTDELAY + CURRENTMEMDELAY);
+}
+
+/*
+ * Tile::chargeXfer
+ *     - Charge the latency of the access that just finished to the
+ *       per-transfer delay counters. The tile waited exposed cycles
+ *       for an access that took latency cycles; with MSHRs (or a
+ *       store buffer) it waits for less than all of it. Each counter
+ *       only gets its share of what was waited for, so the counters
+ *       add up to the cycle count. Anything waited for that wasn't
+ *       memory goes to hopcycles.
+ */
+void Tile::chargeXfer(ulong exposed, ulong latency) {
+
+    ulong waited = MIN(exposed, latency);
+    ulong mem = 0;
+
+// The part of x (out of latency) that was waited for
+#define EXPOSED(x) (latency ? ((x) * waited / latency) : 0)
+
+    switch (pendxfer) {
+        case XFERLOC:
+            locdelay += EXPOSED(penddelay);
+            break;
+        case XFERCTOC:
+            ctocdelay += EXPOSED(penddelay);
+            break;
+        case XFERPTOP:
+            ptopdelay += EXPOSED(penddelay);
+            break;
+        case XFERMEM:
+            mem            = EXPOSED(pendmem);
+            memcycles     += mem;
+            memhopscycles += EXPOSED(pendmem + penddelay);
+            break;
+    }
+
+#undef EXPOSED
+
+    hopcycles += exposed - mem;
+    pendxfer   = XFERNONE;
+}
+
+/*
+ * Tile::issueToMSHR
+ *     - Account for the time of an access when the tile can keep
+ *       several misses outstanding. The processor only waits for
+ *       the L1 lookup; an access that went to the L2 holds an MSHR
+ *       until its accumulated delay has passed. An access to a
+ *       block that already has a miss outstanding merges into it.
+ *       If all MSHRs are busy the processor stalls until one frees.
+ */
+void Tile::issueToMSHR(ulong addr, int l2access) {
+
+    ulong latency = CURRENTDELAY + CURRENTMEMDELAY;
+
+    // Merge with an outstanding miss to the same block
+    if (mshr->lookup(BLKADDR(addr), cycle) >= 0) {
+        mshr->merges++;
+        cycle += L1ATIME;
+        return;
+    }
+
+    // Plain L1 hit
+    if (!l2access) {
+        cycle += latency;
+        return;
+    }
+
+    cycle = mshr->allocate(BLKADDR(addr), cycle, latency) + L1ATIME;
+}
+
+/*
+ * Tile::bufferStore
+ *     - Put a store in the store buffer. It merges into an entry
+ *       for its block that hasn't started draining; otherwise it
+ *       needs an entry of its own. If the buffer is full the
+ *       processor stalls until the first draining entry completes
+ *       (starting the oldest entry early if none are draining).
+ */
+void Tile::bufferStore(ulong addr) {
+
+    ulong blk = BLKADDR(addr);
+    ulong first;
+
+    storebuf->stores++;
+    if (storebuf->lookup(blk, 1) >= 0) {
+        storebuf->merges++;
+        return;
+    }
+
+    if (storebuf->full()) {
+        if (!storebuf->firstDone())
+            drainStores(cycle, storebuf->oldestWaiting());
+        first = storebuf->firstDone();
+        storebuf->fullstalls++;
+        storebuf->stallcycles += first - cycle;
+        cycle = first;
+        CURRENTCYCLE = cycle;
+        storebuf->retire(cycle);
+    }
+
+    storebuf->insert(addr, blk, cycle);
+}
+
+/*
+ * Tile::drainStores
+ *     - Send the buffered stores that are ready to drain by now to
+ *       their home L2 slices, oldest first. Entries up to (and
+ *       including) upto go right away because someone is waiting
+ *       on them.
+ */
+void Tile::drainStores(ulong now, int upto) {
+
+    int i;
+    ulong start;
+
+    while ((i = storebuf->oldestWaiting()) >= 0) {
+        start = storebuf->readyTime(i, now, i <= upto);
+        if (i > upto && start > now)
+            break;
+        sendStore(i, start);
+    }
+}
+
+/*
+ * Tile::sendStore
+ *     - Drain entry i of the store buffer. The L2 write starts at
+ *       start and nobody waits for it, so the delay counters are
+ *       put back afterwards. Whether it is a write-through of a
+ *       block our L1 holds depends on the L1 now, not when the
+ *       store was buffered.
+ */
+void Tile::sendStore(int i, ulong start) {
+
+    ulong addr;
+    DelayScope saved;
+    ulong origTile     = CURRENTTILE;
+    ulong origCycle    = CURRENTCYCLE;
+
+    CURRENTDELAY    = 0;
+    CURRENTMEMDELAY = 0;
+    CURRENTTILE     = index;
+    CURRENTCYCLE    = start;
+
+    addr = storebuf->getAddr(i);
+    L2Access(addr, 'w', l1cache->findLine(addr) != NULL);
+    storebuf->drained(i, start, CURRENTDELAY + CURRENTMEMDELAY);
+
+    // Nobody waits for a buffered store (the loads that have to
+    // wait for one count it as they go)
+    chargeXfer(0, CURRENTDELAY + CURRENTMEMDELAY);
+
+    CURRENTTILE     = origTile;
+    CURRENTCYCLE    = origCycle;
+}
+
+/*
+ * Tile::waitForStore
+ *     - If the store buffer has a store to the block containing
+ *       addr, drain the buffer up to that store and wait for it to
+ *       complete.
+ */
+void Tile::waitForStore(ulong addr) {
+
+    int i = storebuf->lookup(BLKADDR(addr), 0);
+
+    if (i < 0)
+        return;
+
+    if (!storebuf->getDone(i))
+        drainStores(cycle, i);
+
+    storebuf->rawstalls++;
+    storebuf->rawcycles += storebuf->getDone(i) - cycle;
+    cycle = storebuf->getDone(i);
+    CURRENTCYCLE = cycle;
+    storebuf->retire(cycle);
+}
+
+/*
+ * Tile::drain
+ *     - Wait for all outstanding misses (and buffered stores) to
+ *       complete. Called at the end of the trace so cycle covers
+ *       all of the work.
+ */
+void Tile::drain() {
+    int i;
+
+    if (mshr)
+        cycle = MAX(cycle, mshr->lastDone());
+
+    if (storebuf) {
+        while ((i = storebuf->oldestWaiting()) >= 0)
+            sendStore(i, storebuf->readyTime(i, 0, 0));
+        cycle = MAX(cycle, storebuf->lastDone());
+    }
+}
+
+/*
+ * Tile::setPartition
+ *     - Move the tile into a new partition (after repartitioning).
+ */
+void Tile::setPartition(int partition, int ntiles, int *tiles) {
+    partid     = partition;
+    partscheme = ntiles;
+    parttiles  = tiles;
+}
+
+/*
+ * Tile::flush
+ *     - Empty the tile's L2 slice (and with it the L1s that have
+ *       copies of its lines).
+ */
+void Tile::flush(Dir *dir, ulong *valid, ulong *dirty) {
+    l2cache->flush(dir, valid, dirty);
+}
+
+/*
+ * Tile::flushL1
+ *     - Unless the hierarchy is inclusive our L1 may have blocks
+ *       that no L2 slice has (and that the L2 flushes didn't reach).
+ *       Called once every slice is flushed so that any dirty
+ *       write-back L1 lines have been recalled.
+ */
+void Tile::flushL1() {
+    if (HIERARCHY != HIERINCL)
+        l1cache->invalidateAll();
+}
+
+/*
+ * Tile::countL2Lines
+ *     - Count the valid and dirty lines in the tile's L2 slice.
+ */
+void Tile::countL2Lines(ulong *valid, ulong *dirty) {
+    l2cache->countLines(valid, dirty);
 }
 
 /*
@@ -93,10 +457,40 @@ void Tile::Access(ulong addr, uchar op) {
  *       then L2 returns quickly. If MISS, the L2 will contact the
  *       Memory controller (directory) and retrieve the value.
  */
-void Tile::L2Access(ulong addr, uchar op) {
+void Tile::L2Access(ulong addr, uchar op, int l1hit) {
 
     int tileid = mapAddrToTile(addr);
     int msg    = (op == 'w') ? L2WR : L2RD;
+
+    // With victim replication a read miss may find a replica of a
+    // remote block in our own slice. Our replica of a block we
+    // write goes stale so it is dropped.
+    if (REPLICATE && tileid != (int)index) {
+        if (op == 'w') {
+            l2cache->dropReplica(addr);
+        } else if (!l1hit && l2cache->replicaHit(addr)) {
+            l2accesses++;
+            locxfer++;
+            pendxfer  = XFERLOC;
+            penddelay = CURRENTDELAY;
+            return;
+        }
+    }
+
+    // How far away the placement put the home slice
+    if (tileid == (int)index)
+        homelocal++;
+    homehops += NETWORK->calcTileToTileHops(index, tileid);
+
+    // With an exclusive hierarchy the L2 may have given the block
+    // to our L1, so a write-through has to be able to bring it back
+    if (op == 'w' && l1hit && HIERARCHY == HIEREXCL)
+        msg = L2WT;
+
+    if (op == 'w')
+        l2writes++;
+
+    CURRENTPFHIT = 0;
     int state = NETWORK->sendReqTileToTile(msg, addr, index, tileid);
 
     // Bump accesses counter
@@ -104,12 +498,12 @@ void Tile::L2Access(ulong addr, uchar op) {
 
     // If it was a hit and it was a remote cache then bump counter
     if (state == HIT) {
-        if (tileid == index) {
+        if (tileid == (int)index) {
             locxfer++;
-            locdelay += CURRENTDELAY;
+            pendxfer = XFERLOC;
         } else {
             ctocxfer++;
-            ctocdelay += CURRENTDELAY;
+            pendxfer = XFERCTOC;
         }
     }
 
@@ -118,36 +512,286 @@ void Tile::L2Access(ulong addr, uchar op) {
     if (state == MISS) {
         if (CURRENTMEMDELAY != 0) {
             memxfer++;
-            memcycles     += CURRENTMEMDELAY;
-            memhopscycles += (CURRENTMEMDELAY + CURRENTDELAY);
+            pendxfer = XFERMEM;
         } else {
             ptopxfer++;
-            ptopdelay += CURRENTDELAY;
+            pendxfer = XFERPTOP;
         }
     }
+
+    // The delays are charged when it is known how much of them
+    // the tile waits for (see chargeXfer)
+    penddelay = CURRENTDELAY;
+    pendmem   = CURRENTMEMDELAY;
+
+    // Hot-block migration: the request counts toward the block's
+    // affinity at its home, which may move the home to our slice
+    if (MIGRATE)
+        NUCA->access(addr, index, tileid, partid, partscheme, parttiles);
+
+    // Misses and first hits on prefetched lines train the prefetcher
+    if (prefetcher && (state == MISS || CURRENTPFHIT))
+        issuePrefetches(addr);
 }
 
 /*
- * Tile::mapAddrToTile
- *     - Given an address map it to a specific tile 
- *       within the partition.
+ * Tile::issuePrefetches
+ *     - Train the prefetcher on addr and send the blocks it picks
+ *       to their home slices. The prefetches leave when the demand
+ *       access is done but nobody waits for them, so the delay
+ *       counters are put back afterwards. Each prefetch starts
+ *       over from the demand's finish time.
  */
-int Tile::mapAddrToTile(ulong addr) {
+void Tile::issuePrefetches(ulong addr) {
+
+    int i, n;
+    ulong cands[PFMAXDEGREE];
+    ulong pfaddr, msgs, flits;
+    DelayScope saved;
+
+    n = prefetcher->train(BLKADDR(addr), cands);
+
+    for (i=0; i < n; i++) {
+        pfaddr = cands[i] << OFFSETBITS;
+        CURRENTDELAY    = saved.delay + saved.memdelay;
+        CURRENTMEMDELAY = 0;
+        msgs  = NETWORK->totalmsgs;
+        flits = NETWORK->totalflits;
+
+        prefetcher->issued++;
+        NUCA->touch(pfaddr, index, partid);
+        if (NETWORK->sendReqTileToTile(L2PF, pfaddr, index,
+                                       mapAddrToTile(pfaddr)) == HIT)
+            prefetcher->dropped++;
+
+        prefetcher->msgs  += NETWORK->totalmsgs  - msgs;
+        prefetcher->flits += NETWORK->totalflits - flits;
+    }
+}
+
+/*
+ * Tile::l1Victim
+ *     - Exclusive hierarchy: send a block our L1 is evicting back
+ *       to its home L2 slice. Nobody waits for it.
+ */
+void Tile::l1Victim(ulong addr) {
+
+    DelayScope saved;
+
+    exvictims++;
+    NETWORK->sendDataTileToTile(L2VICT, addr, index, mapAddrToTile(addr));
+}
+
+/*
+ * Tile::l1WriteBack
+ *     - Write-back L1: send a dirty block our L1 is evicting to
+ *       its home L2 slice. Nobody waits for it.
+ */
+void Tile::l1WriteBack(ulong addr) {
+
+    DelayScope saved;
+
+    l1wbacks++;
+    NETWORK->sendDataTileToTile(L1WB, addr, index, mapAddrToTile(addr));
+}
+
+/*
+ * Tile::l1Replicate
+ *     - Victim replication: our L1 is evicting a clean block. If
+ *       its home is another slice keep a replica in our own. The
+ *       home's L1 sharer mask still has us, so an L1INV for the
+ *       block reaches the replica. Nobody waits for this.
+ */
+void Tile::l1Replicate(ulong addr) {
+
+    DelayScope saved;
+
+    if (mapAddrToTile(addr) != (int)index)
+        l2cache->replicate(addr);
+}
+
+/*
+ * Tile::spillVictim
+ *     - Cooperative spilling: our L2 slice is filling a line and
+ *       line is the victim. The fill counts toward our partition's
+ *       utilization. A victim of our own (not a replica or a block
+ *       spilled to us) may move to a lightly loaded neighbour
+ *       partition; then line is left invalid.
+ */
+void Tile::spillVictim(CacheLine *line) {
+
+    ulong addr;
+    int to;
+
+    COOP->fill(partid);
+
+    if (!line->isValid() || line->isReplica() || line->isSpilled() ||
+        !line->ccsm->isValid())
+        return;
+
+    addr = l2cache->getBaseAddr(line->getTag(), line->getIndex());
+    if ((to = COOP->target(addr, partid)) < 0)
+        return;
+
+    // An L1 that owns the block hands its dirty data back first
+    if (line->getL1Owner() >= 0)
+        recallL1(line, addr, 0);
+
+    COOP->spill(addr, index, to, line->getFlags(), line->ccsm->state);
+    line->ccsm->spill();
+}
+
+/*
+ * Tile::affinity
+ *     - Hot-block migration: count a request by tile for the block
+ *       containing addr, whose home is our L2 slice.
+ *
+ * Returns the tile the block should move to or -1.
+ */
+int Tile::affinity(ulong addr, int tile) {
+    return l2cache->affinity(addr, tile);
+}
+
+/*
+ * Tile::moveL2Line
+ *     - Hot-block migration: move the block containing addr from
+ *       our L2 slice to the slice of tile to, its new home.
+ *
+ * Returns 1 if we had the block.
+ */
+int Tile::moveL2Line(ulong addr, Tile *to) {
+    return l2cache->moveLine(addr, to->l2cache);
+}
+
+/*
+ * Tile::spillRoom
+ *     - Cooperative spilling: could our L2 slice take the block
+ *       containing addr from another partition without evicting
+ *       one of our own?
+ */
+int Tile::spillRoom(ulong addr) {
+    return l2cache->spillRoom(addr);
+}
+
+/*
+ * Tile::spillIn
+ *     - Cooperative spilling: take a block another partition's L2
+ *       evicted into our L2 slice (with the line flags and CCSM
+ *       state it had there).
+ */
+void Tile::spillIn(ulong addr, ulong flags, int state) {
+    l2cache->spillIn(addr, flags, state);
+}
+
+/*
+ * Tile::recallL1
+ *     - Get the dirty data of the block in line (of our L2 slice)
+ *       back from the write-back L1 that owns it. The owner keeps a
+ *       clean copy. If wait is set the access being simulated waits
+ *       for the data; otherwise (an eviction) it doesn't.
+ */
+void Tile::recallL1(CacheLine *line, ulong addr, int wait) {
+
+    DelayScope saved;
+    int owner = line->getL1Owner();
 
-    // Get the number of tiles within the partition
-    int numtiles = part->getNumSetBits();
+    assert(owner >= 0);
 
-    // Since the tiles logically share L2 the blocks are
-    // interleaved among the tiles. Find the tile offset
-    // within the partition.
-    int tileoffset = ADDRHASH(addr) % numtiles;
+    NETWORK->sendReqTileToTile(L1RECALL, addr, index, owner);
+    NETWORK->fakeDataTileToTile(owner, index);
+    line->setL1Owner(-1);
+    recalls++;
 
-    // Find the actual tile id of the tile. Note: add
-    // 1 because even if offset is 0 we want to find 1st
-    // set bit.
-    int tileid = part->getNthSetBit(tileoffset + 1);
+    if (wait) {
+        recallcycles += CURRENTDELAY - saved.delay;
+        saved.keep();
+    }
+}
+
+/*
+ * Tile::recallOther
+ *     - Before our L2 slice serves fromtile, recall the block from
+ *       any other L1 that has it dirty.
+ */
+void Tile::recallOther(ulong addr, ulong fromtile) {
+    CacheLine *line = l2cache->findLine(addr);
+    if (line && line->getL1Owner() >= 0 && line->getL1Owner() != (int)fromtile)
+        recallL1(line, addr, 1);
+}
+
+/*
+ * Tile::grantL1Owner
+ *     - A write from fromtile is done in our L2 slice. A write-back
+ *       L1 now owns the block.
+ */
+void Tile::grantL1Owner(ulong addr, ulong fromtile) {
+    if (L1WRITE == L1WRBACK)
+        l2cache->findLine(addr)->setL1Owner(fromtile);
+}
+
+/*
+ * Tile::evictNotice
+ *     - Our L2 slice is evicting the block in line. Tell the
+ *       directory (PUTS, or PUTM if the block is dirty) so that it
+ *       stops sending INV/INT here for it. Nobody waits for the
+ *       notice. Unless the hierarchy is inclusive the L1s may still
+ *       have copies, so then only a line with an empty L1 sharer
+ *       mask is reported and the rest stay silent.
+ */
+void Tile::evictNotice(CacheLine *line, ulong addr) {
+
+    DelayScope saved;
+
+    if (HIERARCHY != HIERINCL && line->getL1Sharers()->getNumSetBits()) {
+        silentevicts++;
+        return;
+    }
+
+    if (line->getFlags() == DIRTY) {
+        NETWORK->sendReqTileToDir(PUTM, addr, index);
+        putmmsgs++;
+    } else {
+        NETWORK->sendReqTileToDir(PUTS, addr, index);
+        putsmsgs++;
+    }
+}
+
+/*
+ * Tile::evictPage
+ *     - The page is no longer private to us (rnuca placement) so
+ *       its blocks are going to their interleaved homes. Evict the
+ *       ones our L2 slice holds that now belong to another slice.
+ *       Nobody waits for this.
+ *
+ * Returns the number of blocks evicted.
+ */
+ulong Tile::evictPage(ulong page) {
+
+    ulong a, n = 0;
+    DelayScope saved;
+
+    for (a = page << PAGEBITS; a < ((page + 1) << PAGEBITS); a += BLKSIZE)
+        if (mapAddrToTile(a) != (int)index && l2cache->evictLine(a))
+            n++;
+
+    return n;
+}
+
+/*
+ * Tile::hasL2Line
+ *     - Does our L2 slice hold the block containing addr?
+ */
+int Tile::hasL2Line(ulong addr) {
+    return (l2cache->findLine(addr) != NULL);
+}
 
-    return tileid;
+/*
+ * Tile::mapAddrToTile
+ *     - Given an address map it to a specific tile 
+ *       within the partition.
+ */
+int Tile::mapAddrToTile(ulong addr) {
+    return NUCA->home(addr, partid, partscheme, parttiles);
 }
 
 /*
@@ -163,10 +807,10 @@ void Tile::PrintStats() {
     printf("04. part to part xfer  (outside partition)      %lu\n",  ptopxfer);
     printf("05. number of accesses                          %lu\n",  accesses);
     printf("06. memory cycles                               %lu\n",  memcycles);
-    printf("07. average total access time (cycles)          %f\n" ,  ((float)cycle / (float)accesses));
-    printf("08. average interconnect hop cycles             %f\n" ,  ((float)(cycle - memcycles) / (float)accesses));
-    printf("09. average mem access cycles (excludes hops)   %f\n" ,  ((float)memcycles / (float)accesses));
-    printf("10. average mem access cycles (includes hops)   %f\n" ,  ((float)(memcycles + memhopscycles)  / (float)accesses));
+    printf("07. average total access time (cycles)          %f\n" ,  statRatio(cycle, accesses));
+    printf("08. average interconnect hop cycles             %f\n" ,  statRatio(hopcycles, accesses));
+    printf("09. average mem access cycles (excludes hops)   %f\n" ,  statRatio(memcycles, accesses));
+    printf("10. average mem access cycles (includes hops)   %f\n" ,  statRatio(memcycles + memhopscycles, accesses));
     printf("===== Simulation results (Cache %d L1) =============\n", index);
     l1cache->PrintStats();
     printf("===== Simulation results (Cache %d L2) =============\n", index);
@@ -174,141 +818,353 @@ void Tile::PrintStats() {
 }
 
 /*
- * Tile::PrintStatsTabular()
- *     - Print a header and then query the L1 and L2 to print
- *       stats about hit/miss rates. etc.
+ * Tile::getStats()
+ *     - Add a row to the tile table t with our counters and then
+ *       the L1's and the L2's (the hit/miss rates etc.).
  */
-void Tile::PrintStatsTabular(int printhead) {
-
-    char buftemp[100]  = { 0 };
-    char bufhead[2048] = { 0 };
-    char bufbody[2048] = { 0 };
-
-
-    sprintf(buftemp, "%15s", "tile");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", index);
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "partscheme");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", partscheme);
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "cycle");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", cycle);
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "accesses");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", accesses);
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "L2accesses");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", l2accesses);
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "locxfer");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", locxfer);
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "ctocxfer");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", ctocxfer);
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "ptopxfer");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", ptopxfer);
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "memxfer");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", memxfer);
-    strcat(bufbody, buftemp);
-
-////sprintf(buftemp, "%15s", "locdelay");
-////strcat(bufhead, buftemp);
-////sprintf(buftemp, "%15lu", locdelay);
-////strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "locAAT");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15f", ((float)locdelay / (float)locxfer));
-    strcat(bufbody, buftemp);
-
-////sprintf(buftemp, "%15s", "ctocdelay");
-////strcat(bufhead, buftemp);
-////sprintf(buftemp, "%15lu", ctocdelay);
-////strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "ctocAAT");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15f", ((float)ctocdelay / (float)ctocxfer));
-    strcat(bufbody, buftemp);
-
-////sprintf(buftemp, "%15s", "ptopdelay");
-////strcat(bufhead, buftemp);
-////sprintf(buftemp, "%15lu", ptopdelay);
-////strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "ptopAAT");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15f", ((float)ptopdelay / (float)ptopxfer));
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "memAAT");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15f", ((float)(memcycles + memhopscycles) / (float)memxfer));
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "totalAAT");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15f", ((float)cycle / (float)accesses));
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "memcycles");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15lu", memcycles);
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "ahopcycles");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15f", ((float)(cycle - memcycles) / (float)accesses));
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "amemnohops");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15f", ((float)memcycles / (float)accesses));
-    strcat(bufbody, buftemp);
-
-    sprintf(buftemp, "%15s", "amemwithhops");
-    strcat(bufhead, buftemp);
-    sprintf(buftemp, "%15f", ((float)(memcycles + memhopscycles)  / (float)accesses));
-    strcat(bufbody, buftemp);
-
-    if (printhead) {
-        // Print the head
-        printf("%s", bufhead);
-        // Print the head from L1
-        l1cache->PrintStatsTabular(1);
-        // Print the head from L2
-        l2cache->PrintStatsTabular(1);
+void Tile::getStats(StatTable *t) {
+
+    t->row();
+    t->count("tile",       index);
+    t->count("partscheme", partscheme);
+    t->count("cycle",      cycle);
+    t->count("accesses",   accesses);
+    t->count("L2accesses", l2accesses);
+    t->count("locxfer",    locxfer);
+    t->count("ctocxfer",   ctocxfer);
+    t->count("ptopxfer",   ptopxfer);
+    t->count("memxfer",    memxfer);
+
+    t->ratio("locAAT",       locdelay, locxfer);
+    t->ratio("ctocAAT",      ctocdelay, ctocxfer);
+    t->ratio("ptopAAT",      ptopdelay, ptopxfer);
+    t->ratio("memAAT",       memcycles + memhopscycles, memxfer);
+    t->ratio("totalAAT",     cycle, accesses);
+    t->count("memcycles",    memcycles);
+    t->ratio("ahopcycles",   hopcycles, accesses);
+    t->ratio("amemnohops",   memcycles, accesses);
+    t->ratio("amemwithhops", memcycles + memhopscycles, accesses);
+
+    l1cache->getStats(t);
+    l2cache->getStats(t);
+}
+
+
+/*
+ * Tile::PrintMSHRStats
+ *     - Print a row (or the header) of MSHR stats for this tile.
+ */
+void Tile::PrintMSHRStats(int printhead) {
+
+    if (!mshr)
+        return;
+
+    if (printhead)
+        printf("%15s", "tile");
+    else
+        printf("%15u", index);
+
+    mshr->PrintStatsTabular(printhead);
+    printf("\n");
+}
+
+/*
+ * Tile::PrintStoreBufStats
+ *     - Print a row per tile of store buffer stats and then the
+ *       totals.
+ */
+void Tile::PrintStoreBufStats(Tile **tiles, int tabular) {
+
+    ulong i;
+    StoreBuf sum(1);
+
+    if (!tabular)
+        printf("===== Store buffers ===============================\n");
+    printf("%15s", "tile");
+    sum.PrintStatsTabular(1);
+    printf("\n");
+
+    for (i=0; i < NPROCS; i++) {
+        printf("%15lu", i);
+        tiles[i]->storebuf->PrintStatsTabular(0);
         printf("\n");
+        sum.add(tiles[i]->storebuf);
+    }
+
+    printf("%15s", "all");
+    sum.PrintStatsTabular(0);
+    printf("\n");
+}
+
+/*
+ * Tile::PrintHierStats
+ *     - Print a row per tile of L1/L2 hierarchy stats: how many
+ *       blocks the L2 slice and the L1 (beyond what its home slices
+ *       hold) have at the end, and what keeping inclusion (or not)
+ *       cost in L1INV messages. Then the totals and how much more
+ *       the hierarchy holds than the L2s alone.
+ */
+void Tile::PrintHierStats(Tile **tiles, int tabular) {
+
+    ulong i, j, valid, dirty;
+    ulong sum[11] = { 0 };
+    ulong row[11];
+    const char *name = (HIERARCHY == HIERNINE) ? "nine" :
+                       (HIERARCHY == HIEREXCL) ? "exclusive" : "inclusive";
+
+    if (!tabular)
+        printf("===== L1/L2 hierarchy (%s) ====================\n", name);
+    printf("%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s\n",
+           "tile", "l2lines", "l1only", "backinvs", "backinvsaved",
+           "l1invmsgs", "l1invcycles", "l1invsaved", "orphaninvs",
+           "exdrops", "exvictims", "exreinserts");
+
+    for (i=0; i <= NPROCS; i++) {
+        if (i < NPROCS) {
+            tiles[i]->countL2Lines(&valid, &dirty);
+            row[0] = valid;
+            row[1] = tiles[i]->l1cache->countL1Only(tiles);
+            row[2] = tiles[i]->backinvs;
+            row[3] = tiles[i]->backinvsaved;
+            row[4] = tiles[i]->l1invmsgs;
+            row[5] = tiles[i]->l1invcycles;
+            row[6] = tiles[i]->l1invsaved;
+            row[7] = tiles[i]->orphaninvs;
+            row[8] = tiles[i]->l2cache->exDrops;
+            row[9] = tiles[i]->exvictims;
+            row[10] = tiles[i]->l2cache->exReinserts;
+            printf("%15lu", i);
+        } else {
+            memcpy(row, sum, sizeof(row));
+            printf("%15s", "all");
+        }
+        printf("%15lu%15lu%15lu%15lu%15lu%15lu%15lu%15lu%15lu%15lu%15lu\n",
+               row[0], row[1], row[2], row[3], row[4], row[5],
+               row[6], row[7], row[8], row[9], row[10]);
+        if (i < NPROCS)
+            for (j=0; j < 11; j++)
+                sum[j] += row[j];
+    }
+
+    if (tabular) {
+        printf("%15s%15s%15s\n", "hierarchy", "blocksheld", "capgain");
+        printf("%15s%15lu%15f\n", name, sum[0] + sum[1],
+               sum[0] ? ((float)sum[1] / (float)sum[0]) : 0.0);
     } else {
-        // Print the bodies
-        printf("%s", bufbody);
-        // Print the head from L1
-        l1cache->PrintStatsTabular(0);
-        // Print the head from L2
-        l2cache->PrintStatsTabular(0);
-        printf("\n");
+        printf("Blocks held on chip %lu (%f more than the L2s alone)\n",
+               sum[0] + sum[1], sum[0] ? ((float)sum[1] / (float)sum[0]) : 0.0);
     }
 }
 
+/*
+ * Tile::PrintL1WriteStats
+ *     - Print a row per tile of what the L1 write policy cost: the
+ *       writes that went on to the L2 (or stayed in a write-back
+ *       L1), the dirty L1 victims and recalls and the remote L2
+ *       traffic. Then the totals and all of the network traffic.
+ */
+void Tile::PrintL1WriteStats(Tile **tiles, int tabular) {
+
+    ulong i, j;
+    ulong sum[7] = { 0 };
+    ulong row[7];
+    const char *name = (L1WRITE == L1WRBACK) ? "back" : "through";
+
+    if (!tabular)
+        printf("===== L1 write policy (%s) =======================\n", name);
+    printf("%15s%15s%15s%15s%15s%15s%15s%15s\n",
+           "tile", "l2writes", "l1wrabsorbed", "l1wbacks", "recalls",
+           "recallcycles", "ctocxfer", "ctocdelay");
+
+    for (i=0; i <= NPROCS; i++) {
+        if (i < NPROCS) {
+            row[0] = tiles[i]->l2writes;
+            row[1] = tiles[i]->l1wrabsorbed;
+            row[2] = tiles[i]->l1wbacks;
+            row[3] = tiles[i]->recalls;
+            row[4] = tiles[i]->recallcycles;
+            row[5] = tiles[i]->ctocxfer;
+            row[6] = tiles[i]->ctocdelay;
+            printf("%15lu", i);
+        } else {
+            memcpy(row, sum, sizeof(row));
+            printf("%15s", "all");
+        }
+        printf("%15lu%15lu%15lu%15lu%15lu%15lu%15lu\n",
+               row[0], row[1], row[2], row[3], row[4], row[5], row[6]);
+        if (i < NPROCS)
+            for (j=0; j < 7; j++)
+                sum[j] += row[j];
+    }
+
+    if (tabular) {
+        printf("%15s%15s%15s\n", "l1write", "netmsgs", "netflits");
+        printf("%15s%15lu%15lu\n", name, NETWORK->totalmsgs, NETWORK->totalflits);
+    } else {
+        printf("Network messages %lu (%lu flits)\n",
+               NETWORK->totalmsgs, NETWORK->totalflits);
+    }
+}
+
+/*
+ * Tile::PrintNoticeStats
+ *     - Print a row per tile of the INV/INT messages that found the
+ *       block already gone from our L2 slice (stale directory
+ *       sharers) and of the eviction notices that keep the sharers
+ *       precise. Then the totals so the two can be weighed against
+ *       each other.
+ */
+void Tile::PrintNoticeStats(Tile **tiles, int tabular) {
+
+    ulong i, j;
+    ulong sum[7] = { 0 };
+    ulong row[7];
+    const char *name = EVICTNOTIFY ? "on" : "off";
+
+    if (!tabular)
+        printf("===== Eviction notices (%s) =======================\n", name);
+    printf("%15s%15s%15s%15s%15s%15s%15s%15s\n",
+           "tile", "staleinvs", "staleints", "staleflits", "putsmsgs",
+           "putmmsgs", "putflits", "silentevicts");
+
+    for (i=0; i <= NPROCS; i++) {
+        if (i < NPROCS) {
+            row[0] = tiles[i]->staleinvs;
+            row[1] = tiles[i]->staleints;
+            row[2] = (row[0] + row[1]) * REQFLITS;
+            row[3] = tiles[i]->putsmsgs;
+            row[4] = tiles[i]->putmmsgs;
+            row[5] = (row[3] + row[4]) * REQFLITS;
+            row[6] = tiles[i]->silentevicts;
+            printf("%15lu", i);
+        } else {
+            memcpy(row, sum, sizeof(row));
+            printf("%15s", "all");
+        }
+        printf("%15lu%15lu%15lu%15lu%15lu%15lu%15lu\n",
+               row[0], row[1], row[2], row[3], row[4], row[5], row[6]);
+        if (i < NPROCS)
+            for (j=0; j < 7; j++)
+                sum[j] += row[j];
+    }
+
+    if (tabular) {
+        printf("%15s%15s%15s%15s\n", "evictnotify", "stalemsgs",
+               "putmsgs", "netflits");
+        printf("%15s%15lu%15lu%15lu\n", name, sum[0] + sum[1],
+               sum[3] + sum[4], NETWORK->totalflits);
+    } else {
+        printf("Stale INV/INT messages %lu (%lu flits), eviction notices "
+               "%lu (%lu flits)\n", sum[0] + sum[1], sum[2],
+               sum[3] + sum[4], sum[5]);
+    }
+}
+
+/*
+ * Tile::PrintReplStats
+ *     - Print a row per tile of how victim replication did: the
+ *       replicas made (or not, for want of room), how often L1
+ *       misses found one, how many went stale or were pushed out,
+ *       the home lines they pushed out and how many are left. Then
+ *       the totals, the hit rate and the share of the L2 capacity
+ *       the replicas take up at the end.
+ */
+void Tile::PrintReplStats(Tile **tiles, int tabular) {
+
+    ulong i, j;
+    ulong sum[9] = { 0 };
+    ulong row[9];
+    ulong lines = NPROCS * (L2SIZE / BLKSIZE);
+    Cache *c;
+
+    if (!tabular)
+        printf("===== Victim replication ==========================\n");
+    printf("%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s%15s\n",
+           "tile", "replfills", "replskipped", "replhits", "replmisses",
+           "replhitrate", "replinvs", "replevicts", "displaced",
+           "replicas", "replshare");
+
+    for (i=0; i <= NPROCS; i++) {
+        if (i < NPROCS) {
+            c = tiles[i]->l2cache;
+            row[0] = c->replFills;
+            row[1] = c->replSkipped;
+            row[2] = c->replHits;
+            row[3] = c->replMisses;
+            row[4] = c->replInvs;
+            row[5] = c->replEvicts;
+            row[6] = c->replDisplaced;
+            row[7] = c->countReplicas();
+            row[8] = L2SIZE / BLKSIZE;
+            printf("%15lu", i);
+        } else {
+            memcpy(row, sum, sizeof(row));
+            printf("%15s", "all");
+        }
+        printf("%15lu%15lu%15lu%15lu%15f%15lu%15lu%15lu%15lu%15f\n",
+               row[0], row[1], row[2], row[3],
+               (row[2] + row[3]) ? ((float)row[2] / (float)(row[2] + row[3])) : 0.0,
+               row[4], row[5], row[6], row[7],
+               (float)row[7] / (float)row[8]);
+        if (i < NPROCS)
+            for (j=0; j < 9; j++)
+                sum[j] += row[j];
+    }
+
+    if (tabular) {
+        printf("%15s%15s%15s%15s\n", "replicate", "replhitrate",
+               "replshare", "netflits");
+        printf("%15s%15f%15f%15lu\n", "on",
+               (sum[2] + sum[3]) ? ((float)sum[2] / (float)(sum[2] + sum[3])) : 0.0,
+               (float)sum[7] / (float)lines, NETWORK->totalflits);
+    } else {
+        printf("Replica hits %lu of %lu L1 misses to remote blocks, "
+               "replicas hold %lu of %lu L2 lines\n",
+               sum[2], sum[2] + sum[3], sum[7], lines);
+    }
+}
+
+/*
+ * Tile::getPrefetchStats
+ *     - Fill in s with this tile's prefetch counters. The issue
+ *       side comes from the tile's prefetcher and the outcomes from
+ *       its L2 slice (where the prefetched blocks live).
+ */
+void Tile::getPrefetchStats(PFStats *s) {
+
+    memset(s, 0, sizeof(PFStats));
+    if (!prefetcher)
+        return;
+
+    s->issued     = prefetcher->issued;
+    s->dropped    = prefetcher->dropped;
+    s->msgs       = prefetcher->msgs;
+    s->flits      = prefetcher->flits;
+    s->fills      = l2cache->getPFFills();
+    s->memfills   = l2cache->getPFMemFills();
+    s->useful     = l2cache->getPFUseful();
+    s->late       = l2cache->getPFLate();
+    s->latecycles = l2cache->getPFLateCycles();
+    s->useless    = l2cache->getPFUseless();
+    s->misses     = l2cache->getRM() + l2cache->getWM();
+}
+
+/*
+ * Tile::getIntervalStats
+ *     - Fill in s with this tile's counters for a per-interval
+ *       snapshot.
+ */
+void Tile::getIntervalStats(IntervalStats *s) {
+    s->cycle      = cycle;
+    s->accesses   = accesses;
+    s->l2accesses = l2accesses;
+    s->locxfer    = locxfer;
+    s->ctocxfer   = ctocxfer;
+    s->ptopxfer   = ptopxfer;
+    s->memxfer    = memxfer;
+    s->l1misses   = l1cache->getRM() + l1cache->getWM();
+    s->l2misses   = l2cache->getRM() + l2cache->getWM();
+}
 
 /*
  * Tile::getFromNetwork
@@ -324,6 +1180,14 @@ int Tile::getFromNetwork(ulong msg, ulong addr, ulong fromtile) {
     // Handle L1 messages first
     if (msg == L1INV) {
         l1cache->invalidateLineIfExists(addr);
+        if (REPLICATE)
+            l2cache->dropReplica(addr);
+        CURRENTDELAY += L1ATIME;
+        return -1;
+    }
+
+    if (msg == L1RECALL) {
+        l1cache->recall(addr);
         CURRENTDELAY += L1ATIME;
         return -1;
     }
@@ -332,6 +1196,12 @@ int Tile::getFromNetwork(ulong msg, ulong addr, ulong fromtile) {
     // Now handle L2 messages
     switch (msg) {
 
+        case PROBE:
+            // Does our L2 slice still have the block?
+            line = l2cache->findLine(addr);
+            CURRENTDELAY += L2ATIME;
+            return (line && line->ccsm->isValid());
+
         case INV:
         case INT:
 
@@ -340,26 +1210,84 @@ int Tile::getFromNetwork(ulong msg, ulong addr, ulong fromtile) {
             CURRENTDELAY += L2ATIME;
 
             // If the line has been evicted already then 
-            // nothing to do.
-            if (!line)
+            // nothing to do. Unless the hierarchy isn't inclusive;
+            // then the L1s may still have copies to invalidate.
+            if (!line) {
+                if (msg == INV)
+                    staleinvs++;
+                else
+                    staleints++;
+                if (msg == INV && HIERARCHY != HIERINCL) {
+                    orphaninvs++;
+                    broadcastToPartition(L1INV, addr);
+                }
                 return -1;
+            }
 
-            // Pass the message on to the CCSM
-            line->ccsm->getFromNetwork(msg);
-            return -1;
+            // A line that is being refilled for our own request has
+            // no copy yet; the directory only thinks we kept one
+            if (!line->ccsm->isValid())
+                staleints++;
+
+            // The newest data may be in a write-back L1
+            if (line->getL1Owner() >= 0)
+                recallL1(line, addr, 1);
+
+            // Pass the message on to the CCSM (which tells the
+            // directory if it had dirty data)
+            return line->ccsm->getFromNetwork(msg);
 
         case L2RD:
+            recallOther(addr, fromtile);
             state = l2cache->Access(addr, 'r');
+            addL1Sharer(addr, fromtile);
             // Fake sending back data to the requesting tile
             NETWORK->fakeDataTileToTile(index, fromtile);
+            // In an exclusive hierarchy the block now lives in the L1
+            if (HIERARCHY == HIEREXCL)
+                l2cache->dropClean(addr);
             return state;
 
         case L2WR:
+            recallOther(addr, fromtile);
+            state = l2cache->Access(addr, 'w');
+            addL1Sharer(addr, fromtile);
+            grantL1Owner(addr, fromtile);
+            // Fake sending back data to the requesting tile
+            NETWORK->fakeDataTileToTile(index, fromtile);
+            return state;
+
+        case L2WT:
+            // The writer's L1 has the block. If we gave it up then
+            // it comes back with the write.
+            if (!l2cache->findLine(addr)) {
+                NETWORK->fakeDataTileToTile(fromtile, index);
+                l2cache->reinsert(addr);
+            }
+            recallOther(addr, fromtile);
             state = l2cache->Access(addr, 'w');
+            addL1Sharer(addr, fromtile);
+            grantL1Owner(addr, fromtile);
             // Fake sending back data to the requesting tile
             NETWORK->fakeDataTileToTile(index, fromtile);
             return state;
 
+        case L2VICT:
+            l2cache->reinsert(addr);
+            return -1;
+
+        case L1WB:
+            // The block stays dirty here, it just has no owner now
+            line = l2cache->findLine(addr);
+            assert(line && line->getL1Owner() == (int)fromtile);
+            CURRENTDELAY += L2ATIME;
+            line->setL1Owner(-1);
+            return -1;
+
+        case L2PF:
+            // The data stays here, nothing goes back
+            return l2cache->prefetch(addr);
+
         default:
             assert(0); // Should not get here
     }
@@ -376,22 +1304,86 @@ int Tile::getFromNetwork(ulong msg, ulong addr, ulong fromtile) {
 void Tile::broadcastToPartition(ulong msg, ulong addr) {
 
     int i;
-    int max = 0;
+    ulong max = 0;
+
+    PROF->calls[PROFBROADCAST]++;
 
     // Lets play a game with CURRENTDELAY. Since this stuff is
     // done in parallel we will save off the original value and
-    // then find the max delay of all parallel requests. 
+    // then find the max delay of all parallel requests. Each
+    // request starts from the original value so that the network
+    // sees them all leave at the same time.
     ulong origDelay = CURRENTDELAY;
-    CURRENTDELAY  = 0;
 
-    for(i=0; i < part->size; i++) {
-        if (part->getBit(i)) {
-            NETWORK->sendReqTileToTile(msg, addr, index, i);
-            max = MAX(max, CURRENTDELAY);
-            CURRENTDELAY = 0; // Reset for next iter
-        }
+    for(i=0; i < (int)partscheme; i++) {
+        CURRENTDELAY = origDelay;
+        NETWORK->sendReqTileToTile(msg, addr, index, parttiles[i]);
+        max = MAX(max, CURRENTDELAY - origDelay);
     }
 
     // Add the max to the original delay
     CURRENTDELAY = origDelay + max;
+
+    if (msg == L1INV) {
+        l1invmsgs   += partscheme;
+        l1invcycles += max;
+    }
+}
+
+/*
+ * Tile::invalidateL1s
+ *     - The block in line (of our L2 slice) is leaving and the L1
+ *       copies have to go too. Either broadcast L1INV to the
+ *       partition or send it only to the tiles in the line's L1
+ *       sharer mask. Those are sent in parallel as well.
+ */
+void Tile::invalidateL1s(CacheLine *line, ulong addr) {
+
+    int i, n = 0;
+    ulong max = 0;
+    ulong origDelay = CURRENTDELAY;
+    BitVector *sharers = line->getL1Sharers();
+
+    if (L1INVMODE == L1INVBCAST) {
+        broadcastToPartition(L1INV, addr);
+        return;
+    }
+
+    for (i=0; i < NPROCS; i++) {
+        if (!sharers->getBit(i))
+            continue;
+        CURRENTDELAY = origDelay;
+        NETWORK->sendReqTileToTile(L1INV, addr, index, i);
+        max = MAX(max, CURRENTDELAY - origDelay);
+        n++;
+    }
+
+    CURRENTDELAY = origDelay + max;
+
+    l1invmsgs   += n;
+    l1invcycles += max;
+    l1invsaved  += partscheme - n;
+}
+
+/*
+ * Tile::addL1Sharer
+ *     - Our L2 slice just gave fromtile's L1 a copy of the block
+ *       containing addr. L1 evictions are silent so the bit stays
+ *       until the block leaves the L2.
+ */
+void Tile::addL1Sharer(ulong addr, ulong fromtile) {
+    CacheLine *line = l2cache->findLine(addr);
+    if (line)
+        line->getL1Sharers()->setBit(fromtile);
+}
+
+/*
+ * Tile::allL1Sharers
+ *     - We don't know which L1s have copies of the block in line,
+ *       so assume they all do.
+ */
+void Tile::allL1Sharers(CacheLine *line) {
+    int i;
+    for (i=0; i < (int)partscheme; i++)
+        line->getL1Sharers()->setBit(parttiles[i]);
 }
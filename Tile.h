@@ -6,22 +6,49 @@
 #define TILE_H
 
 #include "types.h"
+#include "Prefetch.h"
+#include "Interval.h"
 
 class Cache;     // Forward Declaration
 class BitVector; // Forward Declaration
+class MSHR;      // Forward Declaration
+class Dir;       // Forward Declaration
+class Prefetcher;// Forward Declaration
+class CacheLine; // Forward Declaration
+class StoreBuf;  // Forward Declaration
+class StatTable; // Forward Declaration
 
+// Where the data of the L2 access in flight came from (for charging
+// its latency once it is known how much of it the tile waited for)
+enum {
+    XFERNONE = 0,
+    XFERLOC,
+    XFERCTOC,
+    XFERPTOP,
+    XFERMEM,
+};
 
 class Tile {
 protected:
 
     Cache * l1cache;
     Cache * l2cache;
-    BitVector * part;
+    int * parttiles; // Tiles in our partition (in increasing order)
+    MSHR * mshr;     // Outstanding misses (NULL if accesses block)
+    StoreBuf * storebuf; // Coalescing store buffer (NULL if none)
+    Prefetcher * prefetcher; // L2 prefetcher (NULL if not prefetching)
+
+    // The L2 access in flight and its latency (not charged yet)
+    int   pendxfer;
+    ulong penddelay;
+    ulong pendmem;
 
+    void chargeXfer(ulong exposed, ulong latency);
    
 public:
     unsigned int index;
-    unsigned int partscheme;
+    unsigned int partid;
+    unsigned int partscheme; // # of tiles in our partition
     unsigned int xindex;
     unsigned int yindex;
     unsigned int cycle;
@@ -36,15 +63,80 @@ public:
     unsigned int l2accesses;
     unsigned int memcycles;
     unsigned int memhopscycles;
+    ulong hopcycles;    // Cycles waited on anything but memory
+
+    // L1/L2 hierarchy counters
+    ulong backinvs;     // L2 evictions that invalidated the L1 copies
+    ulong backinvsaved; // L2 evictions that left the L1 copies alone
+    ulong l1invmsgs;    // L1INV messages sent (one per partition tile)
+    ulong l1invcycles;  // Cycles added to accesses by L1INV broadcasts
+    ulong l1invsaved;   // L1INV messages the sharer masks avoided
+    ulong orphaninvs;   // INVs for blocks only the L1s might have
+    ulong exvictims;    // L1 victims sent back to the L2 (exclusive)
+
+    // L1 write policy counters
+    ulong l2writes;     // Writes sent on to the L2
+    ulong l1wrabsorbed; // Write hits on blocks the (write-back) L1 owned
+    ulong l1wbacks;     // Dirty L1 victims sent to their home slice
+    ulong recalls;      // Dirty L1 blocks this slice took back
+    ulong recallcycles; // Cycles accesses waited for recalls
+
+    // Eviction notice counters
+    ulong staleinvs;    // INVs that found no line in our L2 slice
+    ulong staleints;    // INTs that found no line in our L2 slice
+    ulong putsmsgs;     // Clean evictions reported to the directory
+    ulong putmmsgs;     // Dirty evictions reported to the directory
+    ulong silentevicts; // Evictions kept quiet since the L1s may have
+                        // the block
+
+    // L2 placement counters
+    ulong homelocal;    // L2 accesses whose home was our own slice
+    ulong homehops;     // Hops to the home slices of all L2 accesses
 
-    Tile(int number, int partspertile, int partition);
+    Tile(int number, int partition, int ntiles, int *tiles);
     ~Tile() {delete l1cache; delete l2cache; };
     void Access(ulong addr, uchar op);
-    void L2Access(ulong addr, uchar op);
+    void L2Access(ulong addr, uchar op, int l1hit);
+    void l1Victim(ulong addr);
+    void l1WriteBack(ulong addr);
+    void l1Replicate(ulong addr);
+    void spillVictim(CacheLine *line);
+    int  spillRoom(ulong addr);
+    int  affinity(ulong addr, int tile);
+    int  moveL2Line(ulong addr, Tile *to);
+    void spillIn(ulong addr, ulong flags, int state);
+    void recallL1(CacheLine *line, ulong addr, int wait);
+    void recallOther(ulong addr, ulong fromtile);
+    void grantL1Owner(ulong addr, ulong fromtile);
+    void evictNotice(CacheLine *line, ulong addr);
+    ulong evictPage(ulong page);
+    int  hasL2Line(ulong addr);
+    void issueToMSHR(ulong addr, int l2access);
+    void bufferStore(ulong addr);
+    void drainStores(ulong now, int upto);
+    void sendStore(int i, ulong start);
+    void waitForStore(ulong addr);
+    void issuePrefetches(ulong addr);
+    void drain();
+    void setPartition(int partition, int ntiles, int *tiles);
+    void flush(Dir *dir, ulong *valid, ulong *dirty);
+    void flushL1();
+    void countL2Lines(ulong *valid, ulong *dirty);
     void PrintStats();
-    void PrintStatsTabular(int printhead);
+    void getStats(StatTable *t);
+    void PrintMSHRStats(int printhead);
+    static void PrintStoreBufStats(Tile **tiles, int tabular);
+    void getPrefetchStats(PFStats *s);
+    void getIntervalStats(IntervalStats *s);
+    static void PrintHierStats(Tile **tiles, int tabular);
+    static void PrintL1WriteStats(Tile **tiles, int tabular);
+    static void PrintNoticeStats(Tile **tiles, int tabular);
+    static void PrintReplStats(Tile **tiles, int tabular);
 
     void broadcastToPartition(ulong msg, ulong addr);
+    void invalidateL1s(CacheLine *line, ulong addr);
+    void addL1Sharer(ulong addr, ulong fromtile);
+    void allL1Sharers(CacheLine *line);
     int getFromNetwork(ulong msg, ulong addr, ulong fromtile);
     int mapAddrToTile(ulong addr);
 };
@@ -0,0 +1,181 @@
+/*
+ * Dusty Mabe - 2014
+ * Trace.cc - Implementation of the Trace class.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Trace.h"
+#include "params.h"
+
+/*
+ * Trace constructor
+ *     - Open the trace named fname. If fname starts with "shm:"
+ *       then the rest of the name is a POSIX shared memory segment
+ *       holding a decoded trace. Otherwise fname is a file which
+ *       is either a decoded trace (starts with TRACEMAGIC) or the
+ *       original text trace. Decoded traces are mapped read-only.
+ */
+Trace::Trace(char *fname) {
+
+    struct stat sb;
+    TraceHdr hdr;
+    int fd;
+
+    fp     = NULL;
+    map    = NULL;
+    maplen = 0;
+    recs   = NULL;
+    count  = 0;
+    pos    = 0;
+    size   = 0;
+
+    // Open the shared memory segment or the file
+    if (strncmp(fname, TRACESHMPREFIX, strlen(TRACESHMPREFIX)) == 0)
+        fd = shm_open(fname + strlen(TRACESHMPREFIX), O_RDONLY, 0);
+    else
+        fd = open(fname, O_RDONLY);
+
+    if (fd < 0) {
+        printf("Trace file problem\n");
+        exit(1);
+    }
+
+    // If it doesn't start with the magic number then it
+    // is a text trace. Read it with stdio.
+    if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) || hdr.magic != TRACEMAGIC) {
+        fstat(fd, &sb);
+        size = sb.st_size;
+        close(fd);
+        fp = fopen(fname, "r");
+        if (fp == 0) {
+            printf("Trace file problem\n");
+            exit(1);
+        }
+        return;
+    }
+
+    // The processor numbers were only checked against the NPROCS
+    // of the build that decoded the trace
+    if (hdr.nprocs != NPROCS) {
+        printf("Trace was decoded for %lu processors, not %d\n",
+               hdr.nprocs, NPROCS);
+        exit(1);
+    }
+
+    // Binary trace. Map the whole thing read-only.
+    fstat(fd, &sb);
+    maplen = sb.st_size;
+    assert(maplen >= sizeof(TraceHdr) + hdr.count * sizeof(TraceRec));
+
+    map = mmap(NULL, maplen, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("Trace file problem\n");
+        exit(1);
+    }
+
+    count = hdr.count;
+    recs  = (TraceRec *)((char *)map + sizeof(TraceHdr));
+}
+
+/*
+ * Trace destructor
+ *     - Close the file or drop the mapping.
+ */
+Trace::~Trace() {
+    if (fp)
+        fclose(fp);
+    if (map)
+        munmap(map, maplen);
+}
+
+/*
+ * Trace::next
+ *     - Hand back the next memory reference from the trace.
+ *       Each line in a text trace is of the form:
+ *       processor(0-7) operation(r,w) address(8 hexa chars)
+ *
+ *      0 r 7fc61248
+ *      0 w 7fc62c08
+ *      0 r 7fc63738
+ *
+ * Returns 1 if a reference was read, 0 at the end of the trace.
+ */
+int Trace::next(int *proc, uchar *op, ulong *addr) {
+
+    char buf[256];
+    char * token;
+    char delimit[4] = " \t\n"; // tokenize based on "space", "tab", eol
+
+    // Binary traces are already decoded
+    if (map) {
+        if (pos == count)
+            return 0;
+        *proc = recs[pos].proc;
+        assert(*proc < NPROCS);
+        *op   = recs[pos].op;
+        *addr = recs[pos].addr;
+        pos++;
+        return 1;
+    }
+
+    if (!fgets(buf, sizeof(buf), fp))
+        return 0;
+
+    // The proc # is the first item on the line
+    token = strtok(buf, delimit);
+    assert(token != NULL);
+    *proc = atoi(token);
+    assert(*proc < NPROCS);
+
+    // The "operation" is next
+    // NOTE: passing NULL to strtok here because
+    //       we want to operate on same string
+    token = strtok(NULL, delimit);
+    assert(token != NULL);
+    *op = token[0];
+
+    // The mem addr is last
+    token = strtok(NULL, delimit);
+    assert(token != NULL);
+    *addr = strtoul(token, NULL, 16);
+
+    pos++;
+    return 1;
+}
+
+/*
+ * Trace::progress
+ *     - How far through the trace we are (0 to 1). For a text trace
+ *       this goes by the bytes read.
+ */
+double Trace::progress() {
+    if (map)
+        return count ? ((double)pos / (double)count) : 1.0;
+    return size ? ((double)ftell(fp) / (double)size) : 1.0;
+}
+
+/*
+ * Trace::countRecords
+ *     - Count the memory references in the trace named fname
+ *       without decoding them.
+ */
+ulong Trace::countRecords(char *fname) {
+
+    char buf[256];
+    ulong n = 0;
+
+    Trace t(fname);
+    if (t.isBinary())
+        return t.count;
+
+    while (fgets(buf, sizeof(buf), t.fp))
+        n++;
+    return n;
+}
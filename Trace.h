@@ -0,0 +1,56 @@
+/*
+ * Dusty Mabe - 2014
+ * Trace.h - Header file for the Trace class. A Trace hands back the
+ *           memory references of a trace one at a time. The trace can
+ *           either be the original text file or a decoded binary trace
+ *           that lives in a file or in a POSIX shared memory segment.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include "types.h"
+
+// Magic number at the start of every decoded binary trace ("706TRACE")
+#define TRACEMAGIC 0x4543415254363037UL
+
+// Prefix of a trace name that refers to a POSIX shared memory segment
+#define TRACESHMPREFIX "shm:"
+
+// Header of a decoded binary trace.
+struct TraceHdr {
+    ulong magic;
+    ulong count;  // Number of TraceRec records that follow
+    ulong nprocs; // NPROCS of the build that decoded it
+};
+
+// One decoded memory reference. 8 bytes so the records pack tightly.
+struct TraceRec {
+    uint   addr;
+    ushort proc;
+    uchar  op;
+    uchar  pad;
+};
+
+class Trace {
+private:
+    FILE * fp;        // Text trace (NULL if binary)
+    void * map;       // Mapping of a binary trace (NULL if text)
+    ulong  maplen;
+    TraceRec * recs;
+    ulong  count;     // Number of records in a binary trace
+    ulong  pos;       // Next record to hand back
+    ulong  size;      // Bytes in a text trace
+
+public:
+    Trace(char *fname);
+    ~Trace();
+
+    int next(int *proc, uchar *op, ulong *addr);
+    int isBinary()    { return (map != NULL); }
+    double progress();
+
+    static ulong countRecords(char *fname);
+};
+
+#endif
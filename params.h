@@ -17,25 +17,137 @@
 #define BLKSIZE 64   // 64 bytes
 #define INDEXBITS  9   // log2(L2SIZE/BLKSIZE/L2ASSOC)
 #define OFFSETBITS 6 // 6 bits (64 = 2^6)
+#define NUMBLOCKS (1UL << (32 - OFFSETBITS)) // Blocks in a 32 bit address space
+// The number of tiles can be changed at build time (make NPROCS=64).
+// By default the tiles are laid out in a SQRTNPROCSxSQRTNPROCS mesh;
+// other layouts are picked at run time with topo=<topology>.
+#ifndef NPROCS
 #define NPROCS  16   // 16 procs
+#endif
+#ifndef SQRTNPROCS
 #define SQRTNPROCS  4 // Tiles will be in SQRTNPROCSxSQRTNPROCS matrix
+#endif
 
 // Access time / hop delay macros
 #define HOPTIME    4  //   4 cycles per interconnect hop
 #define L1ATIME    3  //   3 cycles
 #define L2ATIME   10  //  10 cycles
+#define L2TAGTIME  3  //   3 cycles to find a block isn't in a slice
 #define MEMATIME 150  // 150 cycles
 
 #define DATAHOPDELAY(x) (x*HOPTIME + 3) // Latency for data block
 #define HOPDELAY(x)     (x*HOPTIME)     // Latency for request
 
+// Mesh contention model (net=mesh). A hop is a router traversal
+// followed by a link traversal. Zero load latency matches HOPTIME.
+#define ROUTERTIME 3  //   3 cycles through a router
+#define LINKTIME   1  //   1 cycle across a link
+#define FLITBYTES 16  //  16 byte links (1 flit per cycle)
+#define REQFLITS   1  //   Requests are a single flit
+#define DATAFLITS (BLKSIZE/FLITBYTES) // Data replies carry a block
+#define NETBUCKETBITS 4  // Link reservations in 16 cycle buckets
+#define NETBUCKETS 1024  // Remember 1024 buckets (16K cycles) per link
+
+// Memory controllers. How many there are (ctrls=), where they
+// attach (ctrlplace=) and how blocks are spread across them
+// (interleave=) are picked at run time.
+#define MAXMEMCTRLS   64  // At most 64 memory controllers
+#define PAGEBITS      12  // 4 KiB pages for page interleaving
+#define XORFOLDBITS    8  // XOR interleaving folds 8 bit chunks
+
+// DRAM model (mem=dram). An access to a closed row costs about
+// MEMATIME: MEMCTRLTIME + TRCD + TCAS + TBURST. Row hits skip TRCD
+// and row conflicts add TRP.
+#define MEMBANKS       8  //   8 banks per controller
+#define MEMROWBYTES 2048  //   2 KiB DRAM rows
+#define MEMCTRLTIME   30  //  30 cycles through the controller
+#define TRCD          40  //  40 cycles to open (activate) a row
+#define TCAS          40  //  40 cycles to read an open row
+#define TRP           40  //  40 cycles to close (precharge) a row
+#define TBURST        16  //  16 cycles of data bus time per block
+#define MEMBANKBITS    7  // Bank reservations in 128 cycle buckets
+#define MEMBUSBITS     6  // Bus reservations in 64 cycle buckets
+#define MEMBUCKETS  1024  // Remember 1024 buckets per bank/bus
+
+// Directory timing model (dir=timed). Every request pays a lookup
+// at its controller's directory and a controller can only do one
+// lookup at a time.
+#define DIRATIME       6  //   6 cycles per directory lookup
+#define DIRBUCKETBITS  4  // Lookup reservations in 16 cycle buckets
+#define DIRBUCKETS  1024  // Remember 1024 buckets per controller
+#define DIRHOTBLOCKS  10  // Report the 10 most serialized blocks
+#define DIRTABLEBITS  10  // Entry hash tables start with 1024 buckets
+
+// Coarse directory (dirregion=<bytes>). A region keeps one bit per
+// block in a word, so it holds at most 64 blocks.
+#define DIRREGIONMIN (2 * BLKSIZE)  // 128 bytes
+#define DIRREGIONMAX (64 * BLKSIZE) //   4 KiB
+
+// Adaptive repartitioning (adapt=<policy>). At the end of every
+// epoch the policy may pick a new partition size; switching flushes
+// every L2 slice.
+#define EPOCHACCESSES 100000 // Default epoch length in accesses
+#define REPARTTIME     1000  // Cycles to quiesce a tile and switch
+#define FLUSHLINETIME     1  // Cycles per valid line walked in a flush
+#define ADAPTHORIZON      4  // Epochs a new partition size must pay off in
+#define ADAPTHOLD         4  // Epochs hill climbing waits between probes
+#define ADAPTMAXSCHEMES  16  // Partition sizes tracked (1 .. 2^15 tiles)
+
+// L2 prefetchers (prefetch=<policy>). Each tile trains on its own L2
+// misses and fills the home slices of the blocks it predicts.
+#define PFDEGREE         2  // Default blocks prefetched per trigger
+#define PFDISTANCE       1  // Default blocks ahead of the trigger
+#define PFMAXDEGREE     16  // At most 16 blocks per trigger
+#define PFSTRIDEENTRIES 16  // Regions tracked by the stride prefetcher
+#define PFSTRIDECONF     1  // Repeats of a delta before it is trusted
+#define PFSTRIDEMAXCONF  3  // Saturation point of the confidence counter
+#define PFSTREAMS        8  // Streams tracked by the stream prefetcher
+#define PFSTREAMWINDOW  16  // Misses within 16 blocks join a stream
+
+// Store buffers (storebuf=<entries>). Each entry waits this long
+// for more stores to its block before it drains to the L2.
+#define SBHOLDTIME      32  // Cycles an entry waits to coalesce
+
+// Cooperative spilling (spill=on). Partition utilization counters
+// are halved every SPILLWINDOW L2 fills. A neighbour with under
+// 1/SPILLRATIO of the spiller's fills per tile takes its victims.
+#define SPILLWINDOW   4096  // L2 fills between halvings
+#define SPILLRATIO       2  // How much less loaded a neighbour must be
+
+// Hot-block migration (migrate=on). A home L2 line counts which tile
+// dominates its requests with a saturating counter and the block
+// moves to that tile's slice when it saturates. A remap table of
+// MIGSETS x MIGWAYS entries per partition finds the moved blocks.
+#define MIGCOUNTMAX      3  // Affinity counter saturates here (2 bits)
+#define MIGSETS        256  // Remap table sets
+#define MIGWAYS          4  // Remap table ways
+
+// Per-interval statistics (interval=<n>) are written through a
+// buffer of this size so the rows cost little.
+#define INTBUFBYTES (64 * ONEKBYTE)
+
+// The self profile (profile=on) times one access in PROFSAMPLE and
+// the progress (progress=<secs>) is looked at every PROGCHECK
+// accesses.
+#define PROFSAMPLE  16
+#define PROGCHECK   4096
+
+// Clock reads timed to find what one costs
+#define PROFCALIBRATE 1000
+
 // Use the following to randomize address interleaving. 
 #define ADDRHASH(x) ((x >> OFFSETBITS + INDEXBITS) ^ (x >> OFFSETBITS))
 
+// Bucket of key in a hash table of 2^bits buckets (Fibonacci hashing)
+#define DIRHASH(key, bits) (((key) * 0x9e3779b97f4a7c15UL) >> (64 - (bits)))
+
 // Use the following to calculate the block address
 #define BLKADDR(addr) (addr >> OFFSETBITS)
 
 // Macro to find max of two numbers
 #define MAX(x,y) ((x > y) ? x : y);
 
+// Macro to find min of two numbers
+#define MIN(x,y) ((x < y) ? x : y)
+
 #endif
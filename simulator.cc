@@ -6,45 +6,578 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <sys/time.h>
 #include <fstream>
 #include "BitVector.h"
 #include "Cache.h"
 #include "Dir.h"
 #include "Tile.h"
 #include "Net.h"
+#include "MemCtrl.h"
+#include "Trace.h"
+#include "Sched.h"
+#include "Adapt.h"
+#include "Prefetch.h"
+#include "Nuca.h"
+#include "Coop.h"
+#include "Interval.h"
+#include "Stats.h"
+#include "Prof.h"
+#include "CCSM.h"
 #include "params.h"
+#include "Delay.h"
 
 Net *NETWORK;
+Nuca *NUCA;
+Coop *COOP;
+Prof *PROF;
 
 ulong CURRENTDELAY    = 0;
 ulong CURRENTMEMDELAY = 0;
 
 ulong PARTSHARING     = 0;
 
+// The tile (and its cycle) whose access is currently being simulated
+ulong CURRENTTILE     = 0;
+ulong CURRENTCYCLE    = 0;
+
+// Optional models. Selected with <name>=<value> arguments.
+ulong NETMODEL        = NETFIXED;
+ulong MEMMODEL        = MEMFIXED;
+ulong ROWPOLICY       = ROWOPEN;
+ulong NUMMSHRS        = 0;
+ulong ORDER           = ORDERFILE;
+ulong DIRMODEL        = DIRINSTANT;
+
+// Bytes per coarse directory region (0 tracks every block on its own)
+ulong DIRREGION       = 0;
+
+// Topology of the chip. Defaults to a SQRTNPROCS wide mesh.
+ulong TOPOLOGY        = TOPOMESH;
+ulong TOPOWIDTH       = SQRTNPROCS;
+ulong TOPOHEIGHT      = NPROCS / SQRTNPROCS;
+ulong TOPOCONC        = 1;
+
+// Memory controllers. Four on the corners with blocks interleaved.
+ulong NUMMEMCTRLS     = 4;
+ulong CTRLPLACE       = CTRLCORNERS;
+ulong CTRLTILES[MAXMEMCTRLS];
+ulong INTERLEAVE      = ILVBLOCK;
+
+// How the tiles are split into partitions
+ulong PARTLAYOUT      = LAYOUTRECT;
+char *PARTFILE        = NULL;
+
+// Adaptive repartitioning policy and epoch length (in accesses)
+ulong ADAPT           = ADAPTOFF;
+ulong EPOCHLEN        = EPOCHACCESSES;
+
+// L2 prefetch policy, degree and distance (in blocks)
+ulong PREFETCH        = PFNONE;
+ulong PFDEG           = PFDEGREE;
+ulong PFDIST          = PFDISTANCE;
+
+// Coherence protocol
+ulong PROTOCOL        = PROTOMESI;
+
+// How the L1s and L2s relate
+ulong HIERARCHY       = HIERINCL;
+
+// How L1 copies are invalidated
+ulong L1INVMODE       = L1INVBCAST;
+
+// L1 write policy
+ulong L1WRITE         = L1WRTHRU;
+
+// Store buffer entries per tile (0 means no store buffer)
+ulong STOREBUF        = 0;
+
+// Report L2 evictions to the directory (PUTS/PUTM)
+ulong EVICTNOTIFY     = 0;
+
+// How blocks are placed in the L2 slices of a partition
+ulong PLACEMENT       = PLACEHASH;
+
+// Keep clean L1 victims as replicas in the local L2 slice
+ulong REPLICATE       = 0;
+
+// Spill L2 victims into lightly loaded neighbour partitions
+ulong SPILL           = 0;
+
+// Move hot blocks to the slice of the tile that uses them
+ulong MIGRATE         = 0;
+
+// Per-interval statistics: interval length, its unit and the file
+// the rows go to (0 and NULL if not asked for)
+ulong INTERVALLEN     = 0;
+ulong INTERVALBY      = INTACCESSES;
+char *STATSFILE       = NULL;
+
+// Export of the end of run stats: format and file (EXPORTNONE and
+// NULL if not asked for)
+ulong EXPORTFMT       = EXPORTNONE;
+char *EXPORTFILE      = NULL;
+
+// Time the simulator itself and write a progress line every
+// PROGRESS seconds (0 for none)
+ulong PROFILE         = 0;
+ulong PROGRESS        = 0;
+
+// Set when the current L2 access is the first hit on a prefetched line
+ulong CURRENTPFHIT    = 0;
+
+/*
+ * usage
+ *     - Print the command line format and exit.
+ */
+static void usage() {
+    printf("input format: ");
+    printf("./sim <partitions> <partsharing> <trace_file> <tabular> [options]\n");
+    printf("options:\n");
+    printf("    net=fixed|mesh       network model (default fixed). The mesh\n");
+    printf("                         (like mem=dram and dir=timed) only sees\n");
+    printf("                         all contention between tiles with\n");
+    printf("                         order=time; with order=file it is\n");
+    printf("                         approximate\n");
+    printf("    mem=fixed|dram       memory model (default fixed)\n");
+    printf("    rowpolicy=open|closed  DRAM row buffer policy (default open)\n");
+    printf("    mshrs=<n>            outstanding misses per tile (default 0, blocking)\n");
+    printf("    order=file|time      simulate in trace file order or in order of\n");
+    printf("                         tile cycle (default file)\n");
+    printf("    dir=instant|timed    directory timing model (default instant)\n");
+    printf("    dirregion=<bytes>    track private regions of this many bytes\n");
+    printf("                         with one directory entry, %d to %d\n", DIRREGIONMIN, DIRREGIONMAX);
+    printf("                         (default 0, every block on its own)\n");
+    printf("    topo=mesh:WxH|torus:WxH|ring:N|cmesh:WxH[:C]\n");
+    printf("                         chip topology, C tiles per router for\n");
+    printf("                         cmesh (2 or 4, default 4) (default mesh)\n");
+    printf("    ctrls=<n>            number of memory controllers (default 4)\n");
+    printf("    ctrlplace=corners|edges|<t0>,<t1>,...\n");
+    printf("                         tiles the controllers attach to (default\n");
+    printf("                         corners)\n");
+    printf("    interleave=block|page|xor\n");
+    printf("                         block to controller mapping (default block)\n");
+    printf("    layout=rect|linear|<file>\n");
+    printf("                         partition shapes: rectangles, runs of tile\n");
+    printf("                         ids (last may be short) or a partition map\n");
+    printf("                         file; <partitions> is ignored for a file\n");
+    printf("                         (default rect)\n");
+    printf("    adapt=off|model|hill regroup the tiles into partitions of a new\n");
+    printf("                         size between epochs (default off)\n");
+    printf("    epoch=<n>            accesses per epoch (default %d)\n", EPOCHACCESSES);
+    printf("    protocol=mesi|moesi|mesif\n");
+    printf("                         coherence protocol (default mesi)\n");
+    printf("    hierarchy=inclusive|nine|exclusive\n");
+    printf("                         L1/L2 inclusion policy (default inclusive)\n");
+    printf("    l1inv=broadcast|mask invalidate L1 copies in every tile of the\n");
+    printf("                         partition or only in the tiles the L2 line\n");
+    printf("                         tracks (default broadcast)\n");
+    printf("    l1write=through|back L1 write policy (default through)\n");
+    printf("    storebuf=<n>         coalescing store buffer entries per tile\n");
+    printf("                         for a write-through L1 (default 0, none)\n");
+    printf("    place=hash|page|first|rnuca\n");
+    printf("                         home L2 slice of each block: hashed, pages\n");
+    printf("                         interleaved, pages at the first tile to\n");
+    printf("                         touch them or private pages at their tile\n");
+    printf("                         and shared ones hashed (default hash)\n");
+    printf("    replicate=off|on     keep clean L1 victims of remote blocks as\n");
+    printf("                         replicas in the tile's own L2 slice\n");
+    printf("                         (default off)\n");
+    printf("    migrate=off|on       move blocks one tile uses far more than\n");
+    printf("                         the others to that tile's L2 slice\n");
+    printf("                         (default off)\n");
+    printf("    spill=off|on         move L2 victims that are the last copy on\n");
+    printf("                         the chip into a lightly loaded neighbour\n");
+    printf("                         partition (default off)\n");
+    printf("    evictnotify=off|on   tell the directory about L2 evictions so\n");
+    printf("                         it stops tracking those sharers (default off)\n");
+    printf("    prefetch=off|next|stride|stream\n");
+    printf("                         L2 prefetcher (default off)\n");
+    printf("    pfdegree=<n>         blocks prefetched per trigger, 1 to %d\n", PFMAXDEGREE);
+    printf("                         (default %d)\n", PFDEGREE);
+    printf("    pfdistance=<n>       blocks ahead of the trigger to start\n");
+    printf("                         prefetching (default %d)\n", PFDISTANCE);
+    printf("    interval=<n>         write a snapshot of the counters every n\n");
+    printf("                         accesses or cycles to the stats file\n");
+    printf("    intervalby=accesses|cycles\n");
+    printf("                         unit of interval (default accesses)\n");
+    printf("    statsfile=<file>     file the interval snapshots go to\n");
+    printf("    export=csv|json|bin  also write the stats and the run metadata\n");
+    printf("                         to the export file in this format\n");
+    printf("    exportfile=<file>    file the stats are exported to\n");
+    printf("    profile=off|on       time where the simulator spends its time\n");
+    printf("                         and print it at the end (default off)\n");
+    printf("    progress=<secs>      write how far through the trace the run is\n");
+    printf("                         and an ETA to stderr every secs seconds\n");
+    exit(1);
+}
+
+/*
+ * parseTopology
+ *     - Parse the value of a topo=<topology> argument. The tile
+ *       grid has to hold exactly NPROCS tiles.
+ */
+static void parseTopology(char *value) {
+
+    ulong w = 0, h = 0, c = 4;
+
+    if (strncmp(value, "mesh:", 5) == 0 && sscanf(value + 5, "%lux%lu", &w, &h) == 2) {
+        TOPOLOGY = TOPOMESH;
+    } else if (strncmp(value, "torus:", 6) == 0 && sscanf(value + 6, "%lux%lu", &w, &h) == 2) {
+        TOPOLOGY = TOPOTORUS;
+    } else if (strncmp(value, "ring:", 5) == 0 && sscanf(value + 5, "%lu", &w) == 1) {
+        TOPOLOGY = TOPORING;
+        h = 1;
+    } else if (strncmp(value, "cmesh:", 6) == 0 &&
+               sscanf(value + 6, "%lux%lu:%lu", &w, &h, &c) >= 2) {
+        TOPOLOGY = TOPOCMESH;
+    } else {
+        usage();
+    }
+
+    if (w * h != NPROCS) {
+        printf("Topology %s does not have %d tiles\n", value, NPROCS);
+        exit(1);
+    }
+    if (TOPOLOGY == TOPOCMESH) {
+        if ((c != 2 && c != 4) || (w % 2) || (c == 4 && (h % 2))) {
+            printf("Concentration %lu does not fit a %lux%lu grid\n", c, w, h);
+            exit(1);
+        }
+    }
+
+    TOPOWIDTH  = w;
+    TOPOHEIGHT = h;
+    TOPOCONC   = (TOPOLOGY == TOPOCMESH) ? c : 1;
+}
+
+/*
+ * parseCtrlPlace
+ *     - Parse the value of a ctrlplace=<placement> argument. A list
+ *       of tiles also sets the number of controllers.
+ */
+static void parseCtrlPlace(char *value) {
+
+    char *tok;
+
+    if (strcmp(value, "corners") == 0) {
+        CTRLPLACE = CTRLCORNERS;
+    } else if (strcmp(value, "edges") == 0) {
+        CTRLPLACE = CTRLEDGES;
+    } else {
+        CTRLPLACE = CTRLLIST;
+        NUMMEMCTRLS = 0;
+        for (tok = strtok(value, ","); tok; tok = strtok(NULL, ",")) {
+            if (NUMMEMCTRLS == MAXMEMCTRLS ||
+                sscanf(tok, "%lu", &CTRLTILES[NUMMEMCTRLS]) != 1)
+                usage();
+            NUMMEMCTRLS++;
+        }
+        if (NUMMEMCTRLS == 0)
+            usage();
+    }
+}
+
+/*
+ * parseOption
+ *     - Parse one optional <name>=<value> argument and set
+ *       the corresponding global.
+ */
+static void parseOption(char *arg) {
+
+    char *value = strchr(arg, '=');
+    *value++ = '\0';
+
+    if (strcmp(arg, "net") == 0) {
+        if (strcmp(value, "fixed") == 0)
+            NETMODEL = NETFIXED;
+        else if (strcmp(value, "mesh") == 0)
+            NETMODEL = NETMESH;
+        else
+            usage();
+    } else if (strcmp(arg, "mem") == 0) {
+        if (strcmp(value, "fixed") == 0)
+            MEMMODEL = MEMFIXED;
+        else if (strcmp(value, "dram") == 0)
+            MEMMODEL = MEMDRAM;
+        else
+            usage();
+    } else if (strcmp(arg, "rowpolicy") == 0) {
+        if (strcmp(value, "open") == 0)
+            ROWPOLICY = ROWOPEN;
+        else if (strcmp(value, "closed") == 0)
+            ROWPOLICY = ROWCLOSED;
+        else
+            usage();
+    } else if (strcmp(arg, "mshrs") == 0) {
+        sscanf(value, "%lu", &NUMMSHRS);
+    } else if (strcmp(arg, "order") == 0) {
+        if (strcmp(value, "file") == 0)
+            ORDER = ORDERFILE;
+        else if (strcmp(value, "time") == 0)
+            ORDER = ORDERTIME;
+        else
+            usage();
+    } else if (strcmp(arg, "dir") == 0) {
+        if (strcmp(value, "instant") == 0)
+            DIRMODEL = DIRINSTANT;
+        else if (strcmp(value, "timed") == 0)
+            DIRMODEL = DIRTIMED;
+        else
+            usage();
+    } else if (strcmp(arg, "dirregion") == 0) {
+        sscanf(value, "%lu", &DIRREGION);
+    } else if (strcmp(arg, "topo") == 0) {
+        parseTopology(value);
+    } else if (strcmp(arg, "ctrls") == 0) {
+        sscanf(value, "%lu", &NUMMEMCTRLS);
+        if (NUMMEMCTRLS < 1 || NUMMEMCTRLS > MAXMEMCTRLS) {
+            printf("Need 1 to %d memory controllers\n", MAXMEMCTRLS);
+            exit(1);
+        }
+    } else if (strcmp(arg, "layout") == 0) {
+        if (strcmp(value, "rect") == 0) {
+            PARTLAYOUT = LAYOUTRECT;
+        } else if (strcmp(value, "linear") == 0) {
+            PARTLAYOUT = LAYOUTLINEAR;
+        } else {
+            PARTLAYOUT = LAYOUTFILE;
+            PARTFILE   = value;
+        }
+    } else if (strcmp(arg, "adapt") == 0) {
+        if (strcmp(value, "off") == 0)
+            ADAPT = ADAPTOFF;
+        else if (strcmp(value, "model") == 0)
+            ADAPT = ADAPTMODEL;
+        else if (strcmp(value, "hill") == 0)
+            ADAPT = ADAPTHILL;
+        else
+            usage();
+    } else if (strcmp(arg, "epoch") == 0) {
+        sscanf(value, "%lu", &EPOCHLEN);
+        if (EPOCHLEN == 0)
+            usage();
+    } else if (strcmp(arg, "protocol") == 0) {
+        if (strcmp(value, "mesi") == 0)
+            PROTOCOL = PROTOMESI;
+        else if (strcmp(value, "moesi") == 0)
+            PROTOCOL = PROTOMOESI;
+        else if (strcmp(value, "mesif") == 0)
+            PROTOCOL = PROTOMESIF;
+        else
+            usage();
+    } else if (strcmp(arg, "hierarchy") == 0) {
+        if (strcmp(value, "inclusive") == 0)
+            HIERARCHY = HIERINCL;
+        else if (strcmp(value, "nine") == 0)
+            HIERARCHY = HIERNINE;
+        else if (strcmp(value, "exclusive") == 0)
+            HIERARCHY = HIEREXCL;
+        else
+            usage();
+    } else if (strcmp(arg, "l1inv") == 0) {
+        if (strcmp(value, "broadcast") == 0)
+            L1INVMODE = L1INVBCAST;
+        else if (strcmp(value, "mask") == 0)
+            L1INVMODE = L1INVMASK;
+        else
+            usage();
+    } else if (strcmp(arg, "l1write") == 0) {
+        if (strcmp(value, "through") == 0)
+            L1WRITE = L1WRTHRU;
+        else if (strcmp(value, "back") == 0)
+            L1WRITE = L1WRBACK;
+        else
+            usage();
+    } else if (strcmp(arg, "storebuf") == 0) {
+        sscanf(value, "%lu", &STOREBUF);
+    } else if (strcmp(arg, "place") == 0) {
+        if (strcmp(value, "hash") == 0)
+            PLACEMENT = PLACEHASH;
+        else if (strcmp(value, "page") == 0)
+            PLACEMENT = PLACEPAGE;
+        else if (strcmp(value, "first") == 0)
+            PLACEMENT = PLACEFIRST;
+        else if (strcmp(value, "rnuca") == 0)
+            PLACEMENT = PLACERNUCA;
+        else
+            usage();
+    } else if (strcmp(arg, "replicate") == 0) {
+        if (strcmp(value, "off") == 0)
+            REPLICATE = 0;
+        else if (strcmp(value, "on") == 0)
+            REPLICATE = 1;
+        else
+            usage();
+    } else if (strcmp(arg, "migrate") == 0) {
+        if (strcmp(value, "off") == 0)
+            MIGRATE = 0;
+        else if (strcmp(value, "on") == 0)
+            MIGRATE = 1;
+        else
+            usage();
+    } else if (strcmp(arg, "spill") == 0) {
+        if (strcmp(value, "off") == 0)
+            SPILL = 0;
+        else if (strcmp(value, "on") == 0)
+            SPILL = 1;
+        else
+            usage();
+    } else if (strcmp(arg, "evictnotify") == 0) {
+        if (strcmp(value, "off") == 0)
+            EVICTNOTIFY = 0;
+        else if (strcmp(value, "on") == 0)
+            EVICTNOTIFY = 1;
+        else
+            usage();
+    } else if (strcmp(arg, "prefetch") == 0) {
+        if (strcmp(value, "off") == 0)
+            PREFETCH = PFNONE;
+        else if (strcmp(value, "next") == 0)
+            PREFETCH = PFNEXT;
+        else if (strcmp(value, "stride") == 0)
+            PREFETCH = PFSTRIDE;
+        else if (strcmp(value, "stream") == 0)
+            PREFETCH = PFSTREAM;
+        else
+            usage();
+    } else if (strcmp(arg, "pfdegree") == 0) {
+        sscanf(value, "%lu", &PFDEG);
+        if (PFDEG < 1 || PFDEG > PFMAXDEGREE)
+            usage();
+    } else if (strcmp(arg, "pfdistance") == 0) {
+        sscanf(value, "%lu", &PFDIST);
+        if (PFDIST < 1)
+            usage();
+    } else if (strcmp(arg, "interval") == 0) {
+        sscanf(value, "%lu", &INTERVALLEN);
+        if (INTERVALLEN == 0)
+            usage();
+    } else if (strcmp(arg, "intervalby") == 0) {
+        if (strcmp(value, "accesses") == 0)
+            INTERVALBY = INTACCESSES;
+        else if (strcmp(value, "cycles") == 0)
+            INTERVALBY = INTCYCLES;
+        else
+            usage();
+    } else if (strcmp(arg, "statsfile") == 0) {
+        STATSFILE = value;
+    } else if (strcmp(arg, "export") == 0) {
+        if (strcmp(value, "csv") == 0)
+            EXPORTFMT = EXPORTCSV;
+        else if (strcmp(value, "json") == 0)
+            EXPORTFMT = EXPORTJSON;
+        else if (strcmp(value, "bin") == 0)
+            EXPORTFMT = EXPORTBIN;
+        else
+            usage();
+    } else if (strcmp(arg, "exportfile") == 0) {
+        EXPORTFILE = value;
+    } else if (strcmp(arg, "profile") == 0) {
+        if (strcmp(value, "off") == 0)
+            PROFILE = 0;
+        else if (strcmp(value, "on") == 0)
+            PROFILE = 1;
+        else
+            usage();
+    } else if (strcmp(arg, "progress") == 0) {
+        sscanf(value, "%lu", &PROGRESS);
+        if (PROGRESS == 0)
+            usage();
+    } else if (strcmp(arg, "ctrlplace") == 0) {
+        parseCtrlPlace(value);
+    } else if (strcmp(arg, "interleave") == 0) {
+        if (strcmp(value, "block") == 0)
+            INTERLEAVE = ILVBLOCK;
+        else if (strcmp(value, "page") == 0)
+            INTERLEAVE = ILVPAGE;
+        else if (strcmp(value, "xor") == 0)
+            INTERLEAVE = ILVXOR;
+        else
+            usage();
+    } else {
+        printf("Unknown option: %s\n", arg);
+        usage();
+    }
+}
+
+
+/*
+ * exportStats
+ *     - Put the run metadata (options, trace, wall time) and a
+ *       summary of the whole chip in the stats registry next to the
+ *       tile table.
+ */
+static void exportStats(Stats *stats, char *trace, char *args, int partscheme,
+                        Tile **tiles, Dir *dir, struct timeval *start) {
+
+    struct timeval end;
+    char when[64];
+    time_t now = start->tv_sec;
+    ulong acc = 0, cyc = 0, maxcyc = 0;
+    double aat = 0.0;
+    StatTable *t;
+    int i;
+
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    gettimeofday(&end, NULL);
+
+    stats->meta("trace",      "%s", basename(trace));
+    stats->meta("partitions", "%d", partscheme);
+    stats->meta("sharing",    "%lu", PARTSHARING);
+    stats->meta("tiles",      "%d", NPROCS);
+    stats->meta("options",    "%s", args);
+    stats->meta("started",    "%s", when);
+    stats->meta("walltime",   "%f", (end.tv_sec - start->tv_sec) +
+                                    (end.tv_usec - start->tv_usec) / 1e6);
+
+    for (i=0; i < NPROCS; i++) {
+        acc    += tiles[i]->accesses;
+        cyc    += tiles[i]->cycle;
+        maxcyc  = MAX(maxcyc, tiles[i]->cycle);
+        aat    += statRatio(tiles[i]->cycle, tiles[i]->accesses);
+    }
+
+    t = stats->table("summary");
+    t->row();
+    t->count("accesses",   acc);
+    t->count("maxcycle",   maxcyc);
+    t->real("avgAAT",      aat / NPROCS);
+    t->ratio("AAT",        cyc, acc);
+    t->count("rdreqs",     dir->reqs[0]);
+    t->count("rdxreqs",    dir->reqs[1]);
+    t->count("upgrreqs",   dir->reqs[2]);
+    t->count("memreads",   dir->memreads);
+    t->count("memflushes", dir->memflushes);
+    t->count("memwbacks",  dir->memwbacks);
+    t->count("c2cxfers",   dir->c2cxfers);
+    t->count("ownerxfers", dir->ownerxfers);
+    t->count("netmsgs",    NETWORK->totalmsgs);
+    t->count("netflits",   NETWORK->totalflits);
+}
+
 
 int main(int argc, char *argv[]) {
     
     int i;
-    FILE * fp;
-    char buf[256];
-    char * token;
-    char * op;
+    uchar op;
     int   proc;
     int   partscheme;
     int   partid;
     int   tabular = 0;
     ulong addr;
     Cache ** cacheArray;
-    char delimit[4] = " \t\n"; // tokenize based on "space", "tab", eol
     char strHeader[2048];
     char strStats[2048];
 
+    // Wall clock time of the run (for the exported stats)
+    struct timeval start;
+    gettimeofday(&start, NULL);
+
     // Check input
-    if (argv[1] == NULL) {
-        printf("input format: ");
-        printf("./sim <partitions> <partsharing> <trace_file> <tabular>\n");
-        exit(1);
-    }
+    if (argc < 4)
+        usage();
 
     //Convert the arguments to integer values
     sscanf(argv[1], "%u", &partscheme);
@@ -56,8 +589,25 @@ int main(int argc, char *argv[]) {
     char *fname =  (char *)malloc(100);
     fname = argv[3];
 
-    if (argv[4] != NULL)
-        tabular = 1;
+    // Keep the options as given for the exported stats (parsing
+    // them splits them up)
+    char args[STATMETALEN] = { 0 };
+    for (i=4; i < argc; i++) {
+        if (strlen(args) + strlen(argv[i]) + 2 >= sizeof(args))
+            break;
+        if (i > 4)
+            strcat(args, " ");
+        strcat(args, argv[i]);
+    }
+
+    // Anything after the trace file is either a <name>=<value>
+    // option or the tabular flag
+    for (i=4; i < argc; i++) {
+        if (strchr(argv[i], '='))
+            parseOption(argv[i]);
+        else
+            tabular = 1;
+    }
 
 
     // Print out the simulator configuration (if not tabular)
@@ -69,23 +619,139 @@ int main(int argc, char *argv[]) {
         printf("L2_ASSOC:                       %d\n", L2ASSOC);
         printf("BLOCKSIZE:                      %d\n", BLKSIZE);
         printf("NUMBER OF PROCESSORS:           %d\n", NPROCS);
-        printf("COHERENCE PROTOCOL:             %s\n", "MESI");
-        printf("TILES PER PARTITION:            %d\n", partscheme);
+        printf("COHERENCE PROTOCOL:             %s\n",
+               (PROTOCOL == PROTOMOESI) ? "MOESI" :
+               (PROTOCOL == PROTOMESIF) ? "MESIF" : "MESI");
+        if (PARTLAYOUT == LAYOUTFILE)
+            printf("PARTITION MAP:                  %s\n", basename(PARTFILE));
+        else
+            printf("TILES PER PARTITION:            %d%s\n", partscheme,
+                   (PARTLAYOUT == LAYOUTLINEAR) ? " (linear)" : "");
         printf("ALLOW PARITION SHARING:         %d\n", PARTSHARING);
         printf("TRACE FILE:                     %s\n", basename(fname));
+        printf("NETWORK MODEL:                  %s\n",
+               (NETMODEL == NETMESH) ? "mesh" : "fixed");
+        printf("MEMORY MODEL:                   %s\n",
+               (MEMMODEL == MEMDRAM) ?
+               ((ROWPOLICY == ROWOPEN) ? "dram (open row)" : "dram (closed row)") :
+               "fixed");
+        printf("MSHRS PER TILE:                 %lu\n", NUMMSHRS);
+        printf("SIMULATION ORDER:               %s\n",
+               (ORDER == ORDERTIME) ? "time" : "file");
+        printf("DIRECTORY MODEL:                %s\n",
+               (DIRMODEL == DIRTIMED) ? "timed" : "instant");
+        if (DIRREGION)
+            printf("DIRECTORY REGIONS:              %lu bytes\n", DIRREGION);
+        printf("TOPOLOGY:                       %s %lux%lu",
+               (TOPOLOGY == TOPOTORUS) ? "torus" :
+               (TOPOLOGY == TOPORING)  ? "ring"  :
+               (TOPOLOGY == TOPOCMESH) ? "cmesh" : "mesh",
+               TOPOWIDTH, TOPOHEIGHT);
+        if (TOPOLOGY == TOPOCMESH)
+            printf(" (%lu tiles per router)", TOPOCONC);
+        printf("\n");
+        printf("MEMORY CONTROLLERS:             %lu (%s, %s interleaved)\n",
+               NUMMEMCTRLS,
+               (CTRLPLACE == CTRLEDGES) ? "edges" :
+               (CTRLPLACE == CTRLLIST)  ? "listed tiles" : "corners",
+               (INTERLEAVE == ILVPAGE) ? "page" :
+               (INTERLEAVE == ILVXOR)  ? "xor"  : "block");
+        printf("L1/L2 HIERARCHY:                %s\n",
+               (HIERARCHY == HIERNINE) ? "non-inclusive" :
+               (HIERARCHY == HIEREXCL) ? "exclusive" : "inclusive");
+        printf("L1 INVALIDATION:                %s\n",
+               (L1INVMODE == L1INVMASK) ? "sharer mask" : "broadcast");
+        printf("L1 WRITE POLICY:                %s\n",
+               (L1WRITE == L1WRBACK) ? "write-back" : "write-through");
+        if (STOREBUF)
+            printf("STORE BUFFER ENTRIES:           %lu\n", STOREBUF);
+        printf("EVICTION NOTICES:               %s\n", EVICTNOTIFY ? "on" : "off");
+        printf("L2 PLACEMENT:                   %s\n",
+               (PLACEMENT == PLACEPAGE)  ? "page interleaved" :
+               (PLACEMENT == PLACEFIRST) ? "first touch" :
+               (PLACEMENT == PLACERNUCA) ? "R-NUCA" : "hashed");
+        if (REPLICATE)
+            printf("VICTIM REPLICATION:             on\n");
+        if (MIGRATE)
+            printf("HOT-BLOCK MIGRATION:            on\n");
+        if (SPILL)
+            printf("COOPERATIVE SPILLING:           on\n");
+        if (ADAPT != ADAPTOFF)
+            printf("ADAPTIVE REPARTITIONING:        %s (epochs of %lu accesses)\n",
+                   (ADAPT == ADAPTMODEL) ? "model" : "hill", EPOCHLEN);
+        if (PREFETCH != PFNONE)
+            printf("L2 PREFETCHER:                  %s (degree %lu, distance %lu)\n",
+                   (PREFETCH == PFNEXT)   ? "next"   :
+                   (PREFETCH == PFSTRIDE) ? "stride" : "stream",
+                   PFDEG, PFDIST);
+        if (INTERVALLEN)
+            printf("INTERVAL STATS:                 every %lu %s to %s\n",
+                   INTERVALLEN,
+                   (INTERVALBY == INTCYCLES) ? "cycles" : "accesses",
+                   STATSFILE);
+        if (EXPORTFMT != EXPORTNONE)
+            printf("STATS EXPORT:                   %s to %s\n",
+                   (EXPORTFMT == EXPORTCSV)  ? "csv"  :
+                   (EXPORTFMT == EXPORTJSON) ? "json" : "bin", EXPORTFILE);
+        if (PROFILE)
+            printf("SIMULATOR PROFILE:              on\n");
     } 
 
+    // A region keeps one bit per block in a word
+    if (DIRREGION && (DIRREGION < DIRREGIONMIN || DIRREGION > DIRREGIONMAX ||
+                      (DIRREGION & (DIRREGION - 1)))) {
+        printf("dirregion must be a power of two from %d to %d bytes\n",
+               DIRREGIONMIN, DIRREGIONMAX);
+        exit(1);
+    }
+
+    // Stores only need buffering if the L1 writes them through
+    if (STOREBUF && L1WRITE == L1WRBACK) {
+        printf("A store buffer needs l1write=through\n");
+        exit(1);
+    }
+
+    // Exclusive L1 victims already go back to their home slice
+    if (REPLICATE && HIERARCHY == HIEREXCL) {
+        printf("Victim replication needs hierarchy=inclusive or hierarchy=nine\n");
+        exit(1);
+    }
+
+    // The contention models forget reservations more than a window
+    // back, so with tile clocks far apart (file order) most of the
+    // contention between tiles is never seen
+    if (ORDER == ORDERFILE &&
+        (NETMODEL == NETMESH || MEMMODEL == MEMDRAM || DIRMODEL == DIRTIMED))
+        fprintf(stderr, "warning: contention is approximate with order=file "
+                        "(the tiles' clocks drift apart); use order=time\n");
+
+    // Interval snapshots need somewhere to go (and vice versa)
+    if ((INTERVALLEN != 0) != (STATSFILE != NULL)) {
+        printf("interval=<n> and statsfile=<file> go together\n");
+        exit(1);
+    }
+    if ((EXPORTFMT != EXPORTNONE) != (EXPORTFILE != NULL)) {
+        printf("export=<format> and exportfile=<file> go together\n");
+        exit(1);
+    }
+
+    // Create the global simulator profile (the hot path calls are
+    // counted from the start)
+    PROF = new Prof(PROFILE, PROGRESS);
+    assert(PROF);
+
     // Create a new directory. Rather than have 4 directories (one 
     // each corner tile) I am just going to use 1 directory and adjust
     // the math accordingly.
     Dir *dir = new Dir(partscheme);
     assert(dir);
 
-    // Create a 4x4 array of Tiles here
+    // Create the array of Tiles here
     Tile * tiles[NPROCS];
     for (i=0; i < NPROCS; i++) {
         partid = dir->mapTileToPart(i);
-        tiles[i] = new Tile(i, partscheme, dir->parttable[partid]->getVector());
+        tiles[i] = new Tile(i, partid, dir->partsize[partid],
+                            dir->parttiles[partid]);
         assert(tiles[i]);
     }
 
@@ -93,66 +759,181 @@ int main(int argc, char *argv[]) {
     NETWORK = new Net(dir, tiles);
     assert(NETWORK);
 
-    // Open the trace file
-    fp = fopen(fname,"r");
-    if (fp == 0) {   
-        printf("Trace file problem\n");
-        exit(0);
-    }
-
-    // Read each line of trace file and call Access() for each entry.
-    // Each line in the tracefile is of the form:
-    //       processor(0-7) operation(r,w) address(8 hexa chars)
-    //
-    //      0 r 7fc61248
-    //      0 w 7fc62c08
-    //      0 r 7fc63738
-    //
-    //
-    while (fgets(buf, 1024, fp)) {
-
-        // The proc # is the first item on the line
-        token = strtok(buf, delimit);
-        assert(token != NULL);
-        proc = atoi(token);
-        assert(proc < NPROCS);
-        //printf("processor is %d\n", proc);
-
-        // The "operation" is next
-        // NOTE: passing NULL to strtok here because
-        //       we want to operate on same string
-        token = strtok(NULL, delimit);
-        assert(token != NULL);
-        op = token;
-        //printf("operation is: %s\n", op);
-
-        // The mem addr is last
-        // NOTE: passing NULL to strtok here because
-        //       we want to operate on same string
-        token = strtok(NULL, delimit);
-        assert(token != NULL);
-        addr = strtoul(token, NULL, 16);
-        //printf("address is: %x\n", (uint) addr);
-
-        tiles[proc]->Access(addr, op[0]);
-
-    }
-    fclose(fp);
+    // Create the global L2 placement state
+    NUCA = new Nuca(tiles);
+    assert(NUCA);
+
+    // Create the global cooperative spilling state
+    COOP = new Coop(dir, tiles);
+    assert(COOP);
+
+    // Regroup the tiles between epochs if asked to
+    Adapt *adapt = NULL;
+    if (ADAPT != ADAPTOFF) {
+        if (PARTLAYOUT == LAYOUTFILE) {
+            printf("Adaptive repartitioning needs layout=rect or layout=linear\n");
+            exit(1);
+        }
+        adapt = new Adapt(dir, tiles, partscheme);
+        assert(adapt);
+    }
+
+    // Write snapshots of the counters as we go if asked to
+    Interval *intervals = NULL;
+    if (INTERVALLEN) {
+        intervals = new Interval(dir, tiles, STATSFILE, INTERVALBY, INTERVALLEN);
+        assert(intervals);
+    }
 
+    // Open the trace. It can be a text trace or a binary trace
+    // decoded by sweep (in a file or a shared memory segment).
+    Trace *trace = new Trace(fname);
+    assert(trace);
+
+    // Read each reference in the trace file and call Access() for
+    // each entry. Either straight from the file or in the order
+    // given by the scheduler.
+    if (ORDER == ORDERTIME) {
+        Sched *sched = new Sched(trace, tiles);
+        assert(sched);
+        PROF->begin(trace, &sched->buffered);
+        while (sched->next(&proc, &op, &addr)) {
+            PROF->phase(PHASETRACE);
+            tiles[proc]->Access(addr, op);
+            PROF->phase(PHASEACCESS);
+            if (adapt && adapt->access())
+                sched->reheap();
+            if (intervals)
+                intervals->access(tiles[proc]->cycle);
+            PROF->phase(PHASEOTHER);
+        }
+        delete sched;
+    } else {
+        PROF->begin(trace, NULL);
+        while (trace->next(&proc, &op, &addr)) {
+            PROF->phase(PHASETRACE);
+            tiles[proc]->Access(addr, op);
+            PROF->phase(PHASEACCESS);
+            if (adapt)
+                adapt->access();
+            if (intervals)
+                intervals->access(tiles[proc]->cycle);
+            PROF->phase(PHASEOTHER);
+        }
+    }
+    PROF->finish();
+
+    delete trace;
+
+    // Wait for any misses that are still outstanding
+    for (i=0; i < NPROCS; i++)
+        tiles[i]->drain();
+
+    // The last (partial) epoch
+    if (adapt)
+        adapt->finish();
+
+    // The last (partial) interval
+    if (intervals) {
+        intervals->finish();
+        delete intervals;
+    }
+
+
+    // Gather the tile counters in the stats registry
+    Stats *stats = new Stats();
+    assert(stats);
+    StatTable *tilestats = stats->table("tiles");
+    for (i=0; i < NPROCS; i++)
+        tiles[i]->getStats(tilestats);
 
     // Print the output. Either tabular or normal
     if (tabular) {
-    
-        // Print the header first
-        tiles[0]->PrintStatsTabular(1);
-
-        // Now print all the bodies
-        for (i=0; i < NPROCS; i++)
-            tiles[i]->PrintStatsTabular(0);
+        tilestats->PrintTabular();
     } else {
 
         // Print it all out
         for (i=0; i < NPROCS; i++)
             tiles[i]->PrintStats();
     }
+
+    // MSHR stats (only if accesses don't block)
+    if (NUMMSHRS) {
+        if (!tabular)
+            printf("===== MSHRs =======================================\n");
+        tiles[0]->PrintMSHRStats(1);
+        for (i=0; i < NPROCS; i++)
+            tiles[i]->PrintMSHRStats(0);
+    }
+
+    // Store buffer stats (only if stores are buffered)
+    if (STOREBUF)
+        Tile::PrintStoreBufStats(tiles, tabular);
+
+    // L1/L2 hierarchy stats (only if not inclusive)
+    if (HIERARCHY != HIERINCL)
+        Tile::PrintHierStats(tiles, tabular);
+
+    // L1 write policy stats (only if the L1s are write-back)
+    if (L1WRITE == L1WRBACK)
+        Tile::PrintL1WriteStats(tiles, tabular);
+
+    // Stale directory sharers and eviction notice stats (only if notifying)
+    if (EVICTNOTIFY)
+        Tile::PrintNoticeStats(tiles, tabular);
+
+    // L2 placement stats (only if not hashed)
+    if (PLACEMENT != PLACEHASH)
+        NUCA->PrintStats(tabular);
+
+    // Hot-block migration stats (only if migrating)
+    if (MIGRATE)
+        NUCA->PrintMigStats(tabular);
+
+    // Victim replication stats (only if replicating)
+    if (REPLICATE)
+        Tile::PrintReplStats(tiles, tabular);
+
+    // Cooperative spilling stats (only if spilling)
+    if (SPILL)
+        COOP->PrintStats(tabular);
+
+    // Prefetch stats (only if prefetching)
+    if (PREFETCH != PFNONE) {
+        PFStats pfs, pfall;
+        memset(&pfall, 0, sizeof(PFStats));
+        if (!tabular)
+            printf("===== L2 Prefetchers ==============================\n");
+        Prefetcher::PrintStatsTabular(1, 0, NULL);
+        for (i=0; i < NPROCS; i++) {
+            tiles[i]->getPrefetchStats(&pfs);
+            Prefetcher::PrintStatsTabular(0, i, &pfs);
+            Prefetcher::addStats(&pfall, &pfs);
+        }
+        Prefetcher::PrintStatsTabular(0, -1, &pfall);
+        Prefetcher::PrintSummary(tabular, &pfall, NETWORK->totalflits);
+    }
+
+    // Adaptive repartitioning stats
+    if (adapt)
+        adapt->PrintStats(tabular);
+
+    // Network stats (only for the contention model)
+    NETWORK->PrintStats(tabular);
+
+    // Directory and memory controller stats (only for the timed
+    // directory and DRAM models)
+    dir->PrintStats(tabular);
+
+    // Where the simulator spent its time (only if profiling)
+    if (PROFILE)
+        PROF->PrintStats(tabular);
+
+    // Export the stats with what the run was if asked to
+    if (EXPORTFMT != EXPORTNONE) {
+        exportStats(stats, fname, args, partscheme, tiles, dir, &start);
+        PROF->getStats(stats->table("profile"));
+        stats->Export(EXPORTFMT, EXPORTFILE);
+    }
+    delete stats;
 }
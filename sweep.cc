@@ -0,0 +1,419 @@
+/*
+ * Dusty Mabe - 2014
+ * sweep.cc - Driver that runs a full sweep of sim configurations
+ *            (partition scheme x partition sharing) over one trace.
+ *
+ *            The trace is decoded once into a POSIX shared memory
+ *            segment and every configuration is run by a separate
+ *            forked sim process that maps the segment read-only. A
+ *            crash or assert in one configuration only loses that
+ *            configuration. The tabular output of each run is written
+ *            using the experiments/ naming scheme:
+ *
+ *                <outdir>/<trace>_part<p>_share<s>_tab.txt
+ *
+ *            Every adaptive repartitioning policy is run as well
+ *            (<outdir>/<trace>_adapt<policy>_share<s>_tab.txt) and
+ *            compared against the best static partition scheme.
+ *
+ *            Each run also exports its stats as CSV next to the text
+ *            output (same name ending in .csv) and these are read
+ *            back for the comparison and gathered, with a run column
+ *            added, into <outdir>/<trace>_sweep.csv.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <libgen.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "Trace.h"
+#include "params.h"
+
+#define MAXJOBS 64
+
+struct Job {
+    int    part;
+    int    sharing;
+    const char * adapt; // Adaptive policy (NULL for a static run)
+    double aat;         // Average totalAAT of the tiles (-1 if unknown)
+    double cost;       // Estimated cost (used for scheduling)
+    pid_t  pid;
+    int    status;
+    char   outfile[512];
+    char   statfile[512]; // Exported CSV stats
+    char   label[64];  // Name of the job for progress messages
+    char   run[64];    // Name of the job in the sweep CSV
+};
+
+// The sweep performed (same as experiments/script.sh). Every
+// power of 2 partition size up to NPROCS is run.
+static int SHARING[] = { 0, 1 };
+#define NSHARING ((int)(sizeof(SHARING) / sizeof(SHARING[0])))
+static const char *ADAPTPOLICIES[] = { "model", "hill" };
+#define NADAPTPOLICIES ((int)(sizeof(ADAPTPOLICIES) / sizeof(ADAPTPOLICIES[0])))
+
+// Name of the shared memory segment holding the trace (for the
+// signal handler)
+static char SHMNAME[64];
+
+/*
+ * cleanup
+ *     - Signal handler. Remove the shared memory segment so an
+ *       interrupted sweep doesn't leave it behind, then die of the
+ *       signal as we would have.
+ */
+static void cleanup(int sig) {
+    shm_unlink(SHMNAME);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/*
+ * estimateCost
+ *     - Estimate the relative run time of a configuration. Every
+ *       configuration walks the whole trace, but larger partitions
+ *       pay for more L1 invalidation broadcasts per L2 eviction and
+ *       partition sharing adds a closest sharer search per request.
+ */
+static double estimateCost(ulong nrecs, int part, int sharing, int adapt) {
+    return (double)nrecs * (1.0 + 0.05*part + 0.1*sharing + 0.2*adapt);
+}
+
+/*
+ * compareCost
+ *     - qsort() helper that orders jobs by decreasing cost so the
+ *       longest jobs get started first (LPT scheduling).
+ */
+static int compareCost(const void *a, const void *b) {
+    double ca = ((Job *)a)->cost;
+    double cb = ((Job *)b)->cost;
+    return (ca < cb) ? 1 : ((ca > cb) ? -1 : 0);
+}
+
+/*
+ * decodeToShm
+ *     - Decode the text trace fname into a new shared memory
+ *       segment named shmname. Returns the number of records.
+ */
+static ulong decodeToShm(char *fname, char *shmname) {
+
+    int proc;
+    uchar op;
+    ulong addr;
+    ulong i, nrecs, len;
+    TraceHdr * hdr;
+    TraceRec * recs;
+
+    // First pass just counts so that we can size the segment
+    nrecs = Trace::countRecords(fname);
+    len   = sizeof(TraceHdr) + nrecs * sizeof(TraceRec);
+
+    int fd = shm_open(shmname, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, len) != 0) {
+        printf("Could not create shared memory segment %s\n", shmname);
+        exit(1);
+    }
+
+    hdr = (TraceHdr *)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (hdr == MAP_FAILED) {
+        printf("Could not map shared memory segment %s\n", shmname);
+        shm_unlink(shmname);
+        exit(1);
+    }
+    recs = (TraceRec *)(hdr + 1);
+
+    // Second pass decodes
+    Trace t(fname);
+    for (i=0; i < nrecs && t.next(&proc, &op, &addr); i++) {
+        recs[i].addr = addr;
+        recs[i].proc = proc;
+        recs[i].op   = op;
+        recs[i].pad  = 0;
+    }
+    assert(i == nrecs);
+
+    // Write the header last so a partial segment is never valid
+    hdr->count  = nrecs;
+    hdr->nprocs = NPROCS;
+    hdr->magic  = TRACEMAGIC;
+
+    munmap(hdr, len);
+    return nrecs;
+}
+
+/*
+ * startJob
+ *     - Fork a sim worker for job with stdout sent to the
+ *       job's output file.
+ */
+static void startJob(Job *job, char *simpath, char *tracename,
+                     int nopts, char **opts) {
+
+    char part[16], sharing[16], adapt[32], exportfile[600];
+    char *args[64];
+    int i, n = 0;
+
+    sprintf(part, "%d", job->part);
+    sprintf(sharing, "%d", job->sharing);
+
+    args[n++] = simpath;
+    args[n++] = part;
+    args[n++] = sharing;
+    args[n++] = tracename;
+    args[n++] = (char *)"_tab";
+    if (job->adapt) {
+        sprintf(adapt, "adapt=%s", job->adapt);
+        args[n++] = adapt;
+    }
+    for (i=0; i < nopts && n < 61; i++)
+        args[n++] = opts[i];
+    sprintf(exportfile, "exportfile=%s", job->statfile);
+    args[n++] = (char *)"export=csv";
+    args[n++] = exportfile;
+    args[n] = NULL;
+
+    job->pid = fork();
+    assert(job->pid >= 0);
+
+    if (job->pid == 0) {
+        int fd = open(job->outfile, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        if (fd < 0) {
+            printf("Could not open %s\n", job->outfile);
+            _exit(1);
+        }
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+        execv(simpath, args);
+        _exit(127); // exec failed
+    }
+}
+
+/*
+ * readAAT
+ *     - Read the average of the tiles' totalAAT (avgAAT of the
+ *       summary table) from the exported stats of a finished job.
+ *       Returns -1 if it can't.
+ */
+static double readAAT(char *statfile) {
+
+    char line[1024];
+    double aat = -1.0;
+    FILE *f = fopen(statfile, "r");
+
+    if (f == NULL)
+        return -1.0;
+
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "summary,0,avgAAT,%lf", &aat) == 1)
+            break;
+    fclose(f);
+
+    return aat;
+}
+
+/*
+ * writeSweep
+ *     - Gather the exported stats of every finished job into one
+ *       CSV with the run as the first column.
+ */
+static void writeSweep(Job *jobs, int njobs, char *fname) {
+
+    char line[1024];
+    FILE *in, *out;
+    int i;
+
+    out = fopen(fname, "w");
+    if (out == NULL) {
+        printf("Could not open %s\n", fname);
+        return;
+    }
+
+    fprintf(out, "run,table,row,name,value\n");
+    for (i=0; i < njobs; i++) {
+        if (jobs[i].aat < 0 || (in = fopen(jobs[i].statfile, "r")) == NULL)
+            continue;
+        fgets(line, sizeof(line), in); // Skip the header
+        while (fgets(line, sizeof(line), in))
+            fprintf(out, "%s,%s", jobs[i].run, line);
+        fclose(in);
+    }
+    fclose(out);
+}
+
+/*
+ * printComparison
+ *     - For each sharing setting print the best static partition
+ *       scheme and how every adaptive policy did against it.
+ */
+static void printComparison(Job *jobs, int njobs) {
+
+    int i, j, best;
+
+    printf("%15s%15s%15s%15s%15s%15s\n", "sharing", "bestpart",
+           "bestAAT", "adapt", "adaptAAT", "vsbest");
+
+    for (j=0; j < NSHARING; j++) {
+
+        best = -1;
+        for (i=0; i < njobs; i++)
+            if (!jobs[i].adapt && jobs[i].sharing == SHARING[j] &&
+                jobs[i].aat >= 0 && (best < 0 || jobs[i].aat < jobs[best].aat))
+                best = i;
+        if (best < 0)
+            continue;
+
+        for (i=0; i < njobs; i++) {
+            if (!jobs[i].adapt || jobs[i].sharing != SHARING[j] || jobs[i].aat < 0)
+                continue;
+            printf("%15d%15d%15f%15s%15f%15f\n", SHARING[j],
+                   jobs[best].part, jobs[best].aat, jobs[i].adapt,
+                   jobs[i].aat, jobs[i].aat / jobs[best].aat);
+        }
+    }
+}
+
+
+int main(int argc, char *argv[]) {
+
+    Job   jobs[MAXJOBS];
+    int   njobs = 0;
+    int   running = 0;
+    int   next = 0;
+    int   failed = 0;
+    int   nworkers;
+    int   i, j, status;
+    ulong nrecs;
+    pid_t pid;
+    char  tracename[128];
+    char  simpath[512];
+    char  sweepfile[512];
+
+    // Check input
+    if (argc < 3) {
+        printf("input format: ");
+        printf("./sweep <trace_file> <outdir> [workers] [sim options]\n");
+        exit(1);
+    }
+
+    char *fname  = argv[1];
+    char *outdir = argv[2];
+
+    // Default to one worker per online core
+    nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 3)
+        sscanf(argv[3], "%d", &nworkers);
+    if (nworkers < 1)
+        nworkers = 1;
+
+    // The sim binary lives next to the sweep binary
+    snprintf(simpath, sizeof(simpath), "%s/sim", dirname(strdup(argv[0])));
+
+    // Decode the trace once into shared memory
+    sprintf(SHMNAME, "/sim706.%d", getpid());
+    signal(SIGINT, cleanup);
+    signal(SIGTERM, cleanup);
+    sprintf(tracename, "%s%s", TRACESHMPREFIX, SHMNAME);
+    nrecs = decodeToShm(fname, SHMNAME);
+    fprintf(stderr, "decoded %lu records into %s\n", nrecs, SHMNAME);
+
+    // Build the job list
+    for (i=1; i <= NPROCS; i*=2) {
+        for (j=0; j < NSHARING; j++) {
+            Job *job = &jobs[njobs++];
+            job->part    = i;
+            job->sharing = SHARING[j];
+            job->adapt   = NULL;
+            job->aat     = -1.0;
+            job->cost    = estimateCost(nrecs, job->part, job->sharing, 0);
+            job->pid     = 0;
+            job->status  = 0;
+            snprintf(job->outfile, sizeof(job->outfile),
+                     "%s/%s_part%d_share%d_tab.txt",
+                     outdir, basename(strdup(fname)), job->part, job->sharing);
+            snprintf(job->statfile, sizeof(job->statfile),
+                     "%s/%s_part%d_share%d.csv",
+                     outdir, basename(strdup(fname)), job->part, job->sharing);
+            sprintf(job->label, "part%d share%d", job->part, job->sharing);
+            sprintf(job->run, "part%d_share%d", job->part, job->sharing);
+        }
+    }
+
+    // The adaptive runs start from SQRTNPROCS tiles per partition
+    for (i=0; i < NADAPTPOLICIES; i++) {
+        for (j=0; j < NSHARING; j++) {
+            Job *job = &jobs[njobs++];
+            job->part    = SQRTNPROCS;
+            job->sharing = SHARING[j];
+            job->adapt   = ADAPTPOLICIES[i];
+            job->aat     = -1.0;
+            job->cost    = estimateCost(nrecs, job->part, job->sharing, 1);
+            job->pid     = 0;
+            job->status  = 0;
+            snprintf(job->outfile, sizeof(job->outfile),
+                     "%s/%s_adapt%s_share%d_tab.txt",
+                     outdir, basename(strdup(fname)), job->adapt, job->sharing);
+            snprintf(job->statfile, sizeof(job->statfile),
+                     "%s/%s_adapt%s_share%d.csv",
+                     outdir, basename(strdup(fname)), job->adapt, job->sharing);
+            sprintf(job->label, "adapt%s share%d", job->adapt, job->sharing);
+            sprintf(job->run, "adapt%s_share%d", job->adapt, job->sharing);
+        }
+    }
+
+    // Longest estimated jobs first
+    qsort(jobs, njobs, sizeof(Job), compareCost);
+
+    // Keep nworkers sim processes busy until all jobs are done
+    while (next < njobs || running > 0) {
+
+        if (next < njobs && running < nworkers) {
+            startJob(&jobs[next], simpath, tracename, argc - 4, argv + 4);
+            fprintf(stderr, "started %s (pid %d)\n",
+                    jobs[next].label, jobs[next].pid);
+            next++;
+            running++;
+            continue;
+        }
+
+        pid = wait(&status);
+        if (pid < 0)
+            break;
+
+        for (i=0; i < next; i++) {
+            if (jobs[i].pid != pid)
+                continue;
+            jobs[i].status = status;
+            running--;
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                jobs[i].aat = readAAT(jobs[i].statfile);
+                fprintf(stderr, "finished %s -> %s\n",
+                        jobs[i].label, jobs[i].outfile);
+            } else {
+                failed++;
+                if (WIFSIGNALED(status))
+                    fprintf(stderr, "FAILED %s (signal %d)\n",
+                            jobs[i].label, WTERMSIG(status));
+                else
+                    fprintf(stderr, "FAILED %s (exit %d)\n",
+                            jobs[i].label, WEXITSTATUS(status));
+            }
+        }
+    }
+
+    shm_unlink(SHMNAME);
+
+    printComparison(jobs, njobs);
+
+    snprintf(sweepfile, sizeof(sweepfile), "%s/%s_sweep.csv",
+             outdir, basename(strdup(fname)));
+    writeSweep(jobs, njobs, sweepfile);
+
+    fprintf(stderr, "%d of %d configurations completed\n", njobs - failed, njobs);
+    return (failed ? 1 : 0);
+}
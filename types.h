@@ -8,5 +8,6 @@
 typedef unsigned long ulong;
 typedef unsigned char uchar;
 typedef unsigned int uint;
+typedef unsigned short ushort;
 
 #endif